@@ -0,0 +1,32 @@
+#version 140
+
+in vec2 fragmentUV;
+flat in int slot;
+flat in float opacity;
+flat in float dim;
+
+uniform sampler2D windows[15];
+
+// Sampler arrays can only be indexed with constants
+#define SLOT(n) case n: gl_FragColor = textureLod(windows[n], uv, 0.0); break;
+
+void main() {
+    vec2 uv = fragmentUV;
+    switch(slot) {
+        SLOT(0) SLOT(1) SLOT(2) SLOT(3) SLOT(4)
+        SLOT(5) SLOT(6) SLOT(7) SLOT(8) SLOT(9)
+        SLOT(10) SLOT(11) SLOT(12) SLOT(13) SLOT(14)
+        default: gl_FragColor = vec4(0.0);
+    }
+
+    vec3 contrib = gl_FragColor.rgb * vec3(0.2627, 0.6780, 0.0593);
+    float luma = contrib.r + contrib.g + contrib.b;
+    gl_FragColor.rgb += (1.0 - dim) * (vec3(luma) - gl_FragColor.rgb);
+
+    gl_FragColor.rgb *= .2 * dim + .8;
+
+    gl_FragColor *= opacity;
+
+    if(gl_FragColor.a == 0)
+        discard;
+}
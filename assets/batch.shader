@@ -0,0 +1,12 @@
+#version 1
+
+type batch
+vertex batch.vs
+fragment batch.fs
+attrib 0 vertex
+attrib 1 uv
+
+uniform view ignored
+uniform instances sampler
+uniform windows samplers 15
+uniform first int 0
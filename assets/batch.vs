@@ -0,0 +1,26 @@
+#version 140
+in vec3 vertex;
+in vec2 uv;
+out vec2 fragmentUV;
+flat out int slot;
+flat out float opacity;
+flat out float dim;
+
+uniform mat4 view;
+uniform samplerBuffer instances;
+uniform int first = 0;
+
+void main() {
+    // Every instance is 3 texels. The position and texture slot, the size and
+    // finally the opacity, dim and flip.
+    int base = (first + gl_InstanceID) * 3;
+    vec4 place = texelFetch(instances, base);
+    vec4 size = texelFetch(instances, base + 1);
+    vec4 params = texelFetch(instances, base + 2);
+
+    slot = int(place.w);
+    opacity = params.x;
+    dim = params.y;
+    fragmentUV = params.z != 0.0 ? vec2(uv.x, 1 - uv.y) : uv;
+    gl_Position = view * vec4(vertex.xy * size.xy + place.xy, vertex.z + place.z, 1.0);
+}
@@ -7,6 +7,7 @@ attrib 0 vertex
 attrib 1 uv
 
 uniform mvp ignored
+uniform matrices sampler 15
 uniform win_tran mat4 identity
 uniform invert bool false
 uniform flip bool false
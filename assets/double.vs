@@ -1,17 +1,27 @@
-#version 130
+#version 140
 in vec3 vertex;
 in vec2 uv;
 out vec2 tex_uv;
 out vec2 win_uv;
 
-uniform mat4 mvp;
+// The matrices are 4 texels each, mvp is the index of ours
+uniform samplerBuffer matrices;
+uniform int mvp;
 uniform mat4 win_tran;
 
 uniform bool flip = false;
 
 void main() {
+    int base = mvp * 4;
+    mat4 transform = mat4(
+        texelFetch(matrices, base),
+        texelFetch(matrices, base + 1),
+        texelFetch(matrices, base + 2),
+        texelFetch(matrices, base + 3)
+    );
+
     tex_uv = flip ? vec2(uv.x, 1 - uv.y) : uv;
     win_uv = (win_tran * vec4(tex_uv, 1.0, 1.0)).xy;
 
-    gl_Position = mvp * vec4(vertex, 1.0);
+    gl_Position = transform * vec4(vertex, 1.0);
 }
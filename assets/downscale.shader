@@ -7,6 +7,7 @@ attrib 0 vertex
 attrib 1 uv
 
 uniform mvp ignored
+uniform matrices sampler 15
 uniform tex_scr sampler
 uniform uvscale vec2 1,1
 uniform pixeluv vec2 1,1
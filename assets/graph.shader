@@ -7,6 +7,7 @@ attrib 0 vertex
 attrib 1 uv
 
 uniform mvp ignored
+uniform matrices sampler 15
 uniform sampler sampler
 uniform opacity float 1.0
 uniform cursor int
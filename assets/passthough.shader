@@ -7,6 +7,7 @@ attrib 0 vertex
 attrib 1 uv
 
 uniform mvp ignored
+uniform matrices sampler 15
 uniform flip bool false
 uniform opacity float 1.0
 uniform tex_scr sampler
@@ -7,5 +7,6 @@ attrib 0 vertex
 attrib 1 uv
 
 uniform mvp ignored
+uniform matrices sampler 15
 uniform opacity float 1.0
 uniform color vec3
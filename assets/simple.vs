@@ -1,15 +1,25 @@
-#version 130
+#version 140
 in vec3 vertex;
 in vec2 uv;
 out vec2 fragmentUV;
 
-uniform mat4 mvp;
+// The matrices are 4 texels each, mvp is the index of ours
+uniform samplerBuffer matrices;
+uniform int mvp;
 uniform vec2 uvscale = vec2(1.0, 1.0);
 
 uniform bool flip = false;
 
 void main() {
+    int base = mvp * 4;
+    mat4 transform = mat4(
+        texelFetch(matrices, base),
+        texelFetch(matrices, base + 1),
+        texelFetch(matrices, base + 2),
+        texelFetch(matrices, base + 3)
+    );
+
     fragmentUV = flip ? vec2(uv.x, 1 - uv.y) : uv;
     fragmentUV *= uvscale;
-    gl_Position = mvp * vec4(vertex, 1.0);
+    gl_Position = transform * vec4(vertex, 1.0);
 }
@@ -0,0 +1,75 @@
+#version 130
+
+// Has to match enum WindowFeature in windowlist.h
+#define FEATURE_BACKGROUND 1
+#define FEATURE_TINT 2
+#define FEATURE_CONTENT 4
+
+in vec2 fragmentUV;
+in vec2 win_uv;
+in vec2 bg_uv;
+
+uniform int features = 0;
+
+uniform sampler2D win_tex;
+uniform sampler2D bg_tex;
+uniform float bg_opacity = 1.0;
+
+uniform vec2 window;
+uniform vec3 tint;
+uniform float tint_opacity = 1.0;
+
+uniform float dim = 1.0;
+uniform float opacity = 1.0;
+
+float rand(in vec2 co) {
+    return fract(sin(dot(co.xy, vec2(12.9898,78.233))) * 43758.5453);
+}
+
+// Premultiplied src over dst. The windows are blended with
+// GL_ONE, GL_ONE_MINUS_SRC_ALPHA, so drawing dst and then src as separate
+// passes leaves
+//   src.rgb + (dst.rgb + fb.rgb * (1 - dst.a)) * (1 - src.a)
+//   = over(src, dst).rgb + fb.rgb * (1 - src.a) * (1 - dst.a)
+// To let the same amount of the framebuffer through in one pass, the
+// combined alpha has to be 1 - (1 - src.a) * (1 - dst.a).
+// The alpha channel of the framebuffer uses GL_MAX, so it can end up
+// slightly higher than with separate passes. Nothing reads it back.
+vec4 over(vec4 src, vec4 dst) {
+    return vec4(src.rgb + dst.rgb * (1.0 - src.a), src.a + dst.a * (1.0 - src.a));
+}
+
+void main() {
+    vec4 content = vec4(0.0);
+    if((features & (FEATURE_BACKGROUND | FEATURE_CONTENT)) != 0)
+        content = texture2D(win_tex, win_uv);
+
+    vec4 color = vec4(0.0);
+
+    // The blurred background only shows through where the window has pixels
+    if((features & FEATURE_BACKGROUND) != 0 && content.a > 0.0) {
+        color = texture2D(bg_tex, bg_uv) * bg_opacity;
+    }
+
+    if((features & FEATURE_TINT) != 0) {
+        vec2 screen_uv = floor(fragmentUV * window);
+        float noise = rand(screen_uv);
+        if(noise >= .25)
+            color = over(vec4(tint, 1.0) * noise * 0.03 * tint_opacity, color);
+    }
+
+    if((features & FEATURE_CONTENT) != 0) {
+        vec3 contrib = content.rgb * vec3(0.2627, 0.6780, 0.0593);
+        float luma = contrib.r + contrib.g + contrib.b;
+        content.rgb += (1.0 - dim) * (vec3(luma) - content.rgb);
+
+        content.rgb *= .2 * dim + .8;
+
+        color = over(content * opacity, color);
+    }
+
+    gl_FragColor = color;
+
+    if(gl_FragColor.a == 0)
+        discard;
+}
@@ -0,0 +1,21 @@
+#version 1
+
+type window
+vertex window.vs
+fragment window.fs
+attrib 0 vertex
+attrib 1 uv
+
+uniform mvp ignored
+uniform matrices sampler 15
+uniform features int 0
+uniform flip bool false
+uniform win_tex sampler
+uniform bg_flip bool false
+uniform bg_tex sampler
+uniform bg_opacity float 1.0
+uniform window vec2 0.0,0.0
+uniform tint vec3 1.0,1.0,1.0
+uniform tint_opacity float 1.0
+uniform dim float 1.0
+uniform opacity float 1.0
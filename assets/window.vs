@@ -0,0 +1,28 @@
+#version 140
+in vec3 vertex;
+in vec2 uv;
+out vec2 fragmentUV;
+out vec2 win_uv;
+out vec2 bg_uv;
+
+// The matrices are 4 texels each, mvp is the index of ours
+uniform samplerBuffer matrices;
+uniform int mvp;
+
+uniform bool flip = false;
+uniform bool bg_flip = false;
+
+void main() {
+    int base = mvp * 4;
+    mat4 transform = mat4(
+        texelFetch(matrices, base),
+        texelFetch(matrices, base + 1),
+        texelFetch(matrices, base + 2),
+        texelFetch(matrices, base + 3)
+    );
+
+    fragmentUV = uv;
+    win_uv = flip ? vec2(uv.x, 1 - uv.y) : uv;
+    bg_uv = bg_flip ? vec2(uv.x, 1 - uv.y) : uv;
+    gl_Position = transform * vec4(vertex, 1.0);
+}
@@ -0,0 +1,55 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <fnmatch.h>
+
+#define BENCH_MIN_NS 200000000ull
+
+static char** selected;
+static size_t selected_num;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static bool is_selected(const char* name) {
+    if(selected_num == 0)
+        return true;
+
+    for(size_t i = 0; i < selected_num; i++) {
+        if(fnmatch(selected[i], name, 0) == 0)
+            return true;
+    }
+    return false;
+}
+
+void bench_select(int argc, char** argv) {
+    selected = argv + 1;
+    selected_num = argc - 1;
+}
+
+void bench_run(const char* name, bench_func func, void* userdata) {
+    if(!is_selected(name))
+        return;
+
+    // Warm up the caches
+    func(userdata, 1);
+
+    size_t iterations = 1;
+    uint64_t elapsed;
+    while(true) {
+        uint64_t start = now_ns();
+        func(userdata, iterations);
+        elapsed = now_ns() - start;
+
+        if(elapsed >= BENCH_MIN_NS)
+            break;
+
+        iterations *= 2;
+    }
+
+    printf("%-70s %12zu iters %10.2f ns/iter\n", name, iterations, (double)elapsed / iterations);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// A benchmark is run with an increasing number of iterations until the
+// measurement takes long enough to be meaningful. The function has to do
+// iterations units of work every time it's called.
+typedef void (*bench_func)(void* userdata, size_t iterations);
+
+void bench_select(int argc, char** argv);
+// Run func and report the time per iteration under name.
+void bench_run(const char* name, bench_func func, void* userdata);
+
+#define BENCH(f, data) \
+    bench_run(#f, f, data)
@@ -0,0 +1,305 @@
+#include "bench.h"
+
+#include "compton.h"
+#include "swiss.h"
+#include "window.h"
+#include "winindex.h"
+#include "xorg.h"
+
+#include "test/xorg.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+struct WindowSet {
+    size_t count;
+    Swiss em;
+    struct WinIndex index;
+    Window* xids;
+};
+
+static void windowset_init(struct WindowSet* set, size_t count) {
+    set->count = count;
+    swiss_clearComponentSizes(&set->em);
+    swiss_setComponentSize(&set->em, COMPONENT_TRACKS_WINDOW, sizeof(struct TracksWindowComponent));
+    swiss_init(&set->em, 512);
+    winindex_init(&set->index);
+    set->xids = malloc(sizeof(Window) * count);
+
+    for(size_t i = 0; i < count; i++) {
+        win_id wid = swiss_allocate(&set->em);
+        struct TracksWindowComponent* tracks = swiss_addComponent(&set->em, COMPONENT_TRACKS_WINDOW, wid);
+        // Window ids are handed out in sparse blocks by the server
+        tracks->id = 0x1e00001 + i * 0x200003;
+        set->xids[i] = tracks->id;
+        winindex_add(&set->index, tracks->id, wid);
+    }
+}
+
+static void windowset_delete(struct WindowSet* set) {
+    free(set->xids);
+    winindex_delete(&set->index);
+    swiss_kill(&set->em);
+}
+
+// The find_win we had before the index
+static win_id linear_find(Swiss* em, Window xid) {
+    for_components(it, em, COMPONENT_TRACKS_WINDOW, CQ_END) {
+        struct TracksWindowComponent* w = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, it.id);
+        if(w->id == xid)
+            return it.id;
+    }
+    return -1;
+}
+
+static volatile win_id sink;
+
+static void find_win__linear(void* userdata, size_t iterations) {
+    struct WindowSet* set = userdata;
+    for(size_t i = 0; i < iterations; i++) {
+        // Events are for every window, not just the first few
+        sink = linear_find(&set->em, set->xids[(i * 7919) % set->count]);
+    }
+}
+
+static void find_win__index(void* userdata, size_t iterations) {
+    struct WindowSet* set = userdata;
+    for(size_t i = 0; i < iterations; i++) {
+        sink = winindex_find(&set->index, set->xids[(i * 7919) % set->count]);
+    }
+}
+
+// Just enough of a session for the handlers of the per-frame events
+struct DispatchSet {
+    size_t count;
+    session_t* ps;
+    Window* xids;
+};
+
+static void dispatchset_init(struct DispatchSet* set, size_t count) {
+    set->count = count;
+    set->ps = calloc(1, sizeof(session_t));
+    Swiss* em = &set->ps->win_list;
+    swiss_clearComponentSizes(em);
+    swiss_setComponentSize(em, COMPONENT_MUD, sizeof(win));
+    swiss_setComponentSize(em, COMPONENT_TRACKS_WINDOW, sizeof(struct TracksWindowComponent));
+    swiss_setComponentSize(em, COMPONENT_STATEFUL, sizeof(struct StatefulComponent));
+    swiss_setComponentSize(em, COMPONENT_PHYSICAL, sizeof(struct PhysicalComponent));
+    swiss_setComponentSize(em, COMPONENT_MOVE, sizeof(struct MoveComponent));
+    swiss_setComponentSize(em, COMPONENT_RESIZE, sizeof(struct ResizeComponent));
+    swiss_init(em, 512);
+    winindex_init(&set->ps->win_index);
+    set->xids = malloc(sizeof(Window) * count);
+
+    for(size_t i = 0; i < count; i++) {
+        win_id wid = swiss_allocate(em);
+        swiss_addComponent(em, COMPONENT_MUD, wid);
+        struct TracksWindowComponent* tracks = swiss_addComponent(em, COMPONENT_TRACKS_WINDOW, wid);
+        tracks->id = 0x1e00001 + i * 0x200003;
+        tracks->border_size = 0;
+        struct StatefulComponent* stateful = swiss_addComponent(em, COMPONENT_STATEFUL, wid);
+        stateful->state = STATE_ACTIVE;
+        struct PhysicalComponent* physical = swiss_addComponent(em, COMPONENT_PHYSICAL, wid);
+        physical->position = (Vector2){{0, 0}};
+        physical->size = (Vector2){{100, 100}};
+
+        set->xids[i] = tracks->id;
+        winindex_add(&set->ps->win_index, tracks->id, wid);
+    }
+}
+
+static void dispatchset_delete(struct DispatchSet* set) {
+    free(set->xids);
+    winindex_delete(&set->ps->win_index);
+    swiss_kill(&set->ps->win_list);
+    free(set->ps);
+}
+
+// The events the session handles every frame, spread over all the windows.
+// This should cost the same no matter how many windows there are.
+static void dispatch__map_configure_damage(void* userdata, size_t iterations) {
+    struct DispatchSet* set = userdata;
+    for(size_t i = 0; i < iterations; i++) {
+        Window xid = set->xids[(i * 7919) % set->count];
+
+        struct Event event = {.type = ET_MAP, .map = {.xid = xid}};
+        session_handleEvent(set->ps, &event);
+
+        event = (struct Event){.type = ET_MANDR, .mandr = {
+            .xid = xid,
+            .pos = {{i % 100, 0}},
+            .size = {{100, 100}},
+        }};
+        session_handleEvent(set->ps, &event);
+
+        event = (struct Event){.type = ET_DAMAGE, .damage = {.xid = xid}};
+        session_handleEvent(set->ps, &event);
+    }
+}
+
+// From the mocked X in test/xorg.c
+extern size_t qCursor;
+extern size_t fenceRequests;
+
+struct XorgSet {
+    size_t count;
+    struct X11Context ctx;
+    struct Atoms atoms;
+    XWindowAttributes attr;
+};
+
+static void drain(struct X11Context* ctx) {
+    struct Event ev;
+    while(XEventsQueuedH(ctx->display, 0) > 0 || vector_size(&ctx->eventBuf) > ctx->readCursor) {
+        xorg_nextEvent(ctx, &ev);
+    }
+    vector_clear(&eventQ);
+    qCursor = 0;
+}
+
+static void xorgset_init(struct XorgSet* set, size_t count) {
+    set->count = count;
+    xorgContext_init(&set->ctx, (void*)0x01, 0, &set->atoms);
+
+    set->attr = (XWindowAttributes) {
+        .class = InputOutput,
+    };
+
+    // Every toplevel is a mapped frame with a single client, like under
+    // a reparenting WM
+    for(size_t i = 0; i < count; i++) {
+        Window frame = 1 + i * 2;
+        setWindowAttr(frame, &set->attr);
+        vector_putBack(&eventQ, &(XCreateWindowEvent){
+            .type = CreateNotify,
+            .window = frame,
+            .parent = 0,
+        });
+        vector_putBack(&eventQ, &(XCreateWindowEvent){
+            .type = CreateNotify,
+            .window = frame + 1,
+            .parent = frame,
+        });
+        vector_putBack(&eventQ, &(XPropertyEvent){
+            .type = PropertyNotify,
+            .window = frame + 1,
+            .atom = set->atoms.atom_client,
+            .state = PropertyNewValue,
+        });
+        vector_putBack(&eventQ, &(XMapEvent){
+            .type = MapNotify,
+            .window = frame,
+        });
+    }
+    drain(&set->ctx);
+}
+
+static void xorgset_delete(struct XorgSet* set) {
+    xorgContext_delete(&set->ctx);
+}
+
+// The events we get in the hot path while dragging a window playing a video
+static void xorg_preprocess__damage_and_configure(void* userdata, size_t iterations) {
+    struct XorgSet* set = userdata;
+    for(size_t i = 0; i < iterations; i++) {
+        Window frame = 1 + ((i * 7919) % set->count) * 2;
+        vector_putBack(&eventQ, &(XDamageNotifyEvent){
+            .type = set->ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+            .drawable = frame,
+        });
+        vector_putBack(&eventQ, &(XConfigureEvent){
+            .type = ConfigureNotify,
+            .window = frame,
+            .width = 100,
+            .height = 100,
+        });
+        // Property changes on the client have to find the frame
+        vector_putBack(&eventQ, &(XPropertyEvent){
+            .type = PropertyNotify,
+            .window = frame + 1,
+            .atom = set->atoms.atom_name,
+            .state = PropertyNewValue,
+        });
+
+        if(vector_size(&eventQ) >= 3 * 256)
+            drain(&set->ctx);
+    }
+    drain(&set->ctx);
+}
+
+// The fences we used to create for every damaged window before binding
+static void texture_sync__fence_per_window(void* userdata, size_t iterations) {
+    struct XorgSet* set = userdata;
+    Display* dpy = set->ctx.display;
+    for(size_t i = 0; i < iterations; i++) {
+        for(size_t j = 0; j < set->count; j++) {
+            XSyncFence fence = XSyncCreateFenceH(dpy, 1 + j * 2, false);
+            XSyncTriggerFenceH(dpy, fence);
+            XSyncAwaitFenceH(dpy, &fence, 1);
+            XSyncDestroyFenceH(dpy, fence);
+        }
+    }
+}
+
+static void texture_sync__shared_fence(void* userdata, size_t iterations) {
+    struct XorgSet* set = userdata;
+    for(size_t i = 0; i < iterations; i++) {
+        xorg_awaitRendering(&set->ctx);
+    }
+}
+
+// The mocked requests are free, so the time doesn't tell us much about the
+// round trips. Count the requests a single frame sends instead.
+static void fence_requests(const char* name, bench_func func, void* userdata) {
+    fenceRequests = 0;
+    func(userdata, 1);
+    printf("%-70s %12zu requests/frame\n", name, fenceRequests);
+}
+
+int main(int argc, char** argv) {
+    bench_select(argc, argv);
+
+    static const size_t counts[] = {10, 100, 500, 2000};
+    for(size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        struct WindowSet set;
+        windowset_init(&set, counts[i]);
+
+        printf("%zu windows\n", counts[i]);
+        BENCH(find_win__linear, &set);
+        BENCH(find_win__index, &set);
+
+        struct DispatchSet dispatchSet;
+        dispatchset_init(&dispatchSet, counts[i]);
+        BENCH(dispatch__map_configure_damage, &dispatchSet);
+        dispatchset_delete(&dispatchSet);
+
+        windowset_delete(&set);
+    }
+
+    vector_init(&eventQ, sizeof(XEvent), 1024);
+    for(size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        struct XorgSet set;
+        xorgset_init(&set, counts[i]);
+
+        printf("%zu frames\n", counts[i]);
+        BENCH(xorg_preprocess__damage_and_configure, &set);
+
+        xorgset_delete(&set);
+    }
+
+    // Every window is animating, so they are all damaged every frame
+    {
+        struct XorgSet set;
+        xorgset_init(&set, 50);
+
+        printf("50 animating windows\n");
+        BENCH(texture_sync__fence_per_window, &set);
+        BENCH(texture_sync__shared_fence, &set);
+        fence_requests("texture_sync__fence_per_window", texture_sync__fence_per_window, &set);
+        fence_requests("texture_sync__shared_fence", texture_sync__shared_fence, &set);
+
+        xorgset_delete(&set);
+    }
+
+    return 0;
+}
@@ -12,11 +12,14 @@ void help(FILE* dest, char* name) {
     fprintf(dest, "  -h     print help\n");
 }
 
+// Has to match SHADER_UNIFORMS_MAX in src/assets/shader.h
+#define MAX_UNIFORMS 16
+
 struct type {
     char name[64];
     char info[64];
     char struc[64];
-    char uniforms[10][64];
+    char uniforms[MAX_UNIFORMS][64];
     int num_uniforms;
 };
 
@@ -72,8 +75,8 @@ int process_file(FILE* out, char* path, struct type* type) {
         }else if(strcmp(comm, "struct") == 0) {
             strncpy(type->struc, arg, 63);
         }else if(strcmp(comm, "uniform") == 0) {
-            if(type->num_uniforms == 10) {
-                fprintf(stderr, "%s: Max 10 uniforms\n", path);
+            if(type->num_uniforms == MAX_UNIFORMS) {
+                fprintf(stderr, "%s: Max %d uniforms\n", path, MAX_UNIFORMS);
                 exit(EXIT_FAILURE);
             }
             strncpy(type->uniforms[type->num_uniforms], arg, 63);
@@ -157,7 +160,6 @@ int main(int argc, char **argv) {
             fprintf(out, "    }\n");
             fprintf(out, "    bool found[%d] = {false};\n", type[i].num_uniforms);
 
-            fprintf(out, "    printf(\"Uniforms in shader \\\"%s\\\"\\n\");\n", type[i].name);
             fprintf(out, "    for(int i = 0; i < program->uniforms_num; i++) {\n");
             for(int j = 0; j < type[i].num_uniforms; j++) {
                 if(j == 0) {
@@ -167,8 +169,6 @@ int main(int argc, char **argv) {
                 }
                 fprintf(out, "            struct shader_value* uniform = &program->uniforms[i];\n");
                 fprintf(out, "            type->%s = uniform;\n", type[i].uniforms[j]);
-                fprintf(out, "            uniform->gl_uniform = glGetUniformLocation(program->gl_program, \"%s\");\n", type[i].uniforms[j]);
-                fprintf(out, "            printf(\"\\tUniform \\\"%s\\\" has id %%d, required %%d\\n\", uniform->gl_uniform, uniform->required);\n", type[i].uniforms[j]);
                 fprintf(out, "            shader_clear_future_uniform(uniform);\n");
                 fprintf(out, "            found[%d] = true;\n", j);
                 fprintf(out, "        }\n");
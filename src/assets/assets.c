@@ -72,6 +72,7 @@ static Pvoid_t loaded = NULL;
 
 static int notifyFd;
 static struct asset_handle* current;
+static bool hotloading = false;
 static Pvoid_t watches;
 
 void assets_init() {
@@ -280,6 +281,10 @@ static void hotload_asset(struct asset_handle* handle) {
     current = parent;
 }
 
+bool assets_hotloading() {
+    return hotloading;
+}
+
 // Called once per iteration. Figure out if any assets were hotloaded and
 // reload them.
 void assets_hotload() {
@@ -289,7 +294,9 @@ void assets_hotload() {
         JLG(handlePtr, watches, event->wd);
         struct asset_handle* handle = *handlePtr;
 
+        hotloading = true;
         hotload_asset(handle);
+        hotloading = false;
     }
 
     if(errno != EAGAIN) {
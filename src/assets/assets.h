@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 typedef struct type_info* type_id;
@@ -23,6 +24,9 @@ void assets_add_handler_internal(asset_type type, const char* extension,
 
 void* assets_load(const char* path);
 void assets_hotload();
+// True while assets_hotload is replacing assets. Loaders have to make sure
+// the new asset works then, the old one is thrown away as soon as they return.
+bool assets_hotloading();
 
 void assets_add_path(const char* path);
 char* assets_resolve_path(const char* path);
@@ -1,11 +1,25 @@
 #include "face.h"
 
+#include "glstate.h"
+
 #include <string.h>
 #include <assert.h>
 
+static void face_init_gl(struct face* asset) {
+    asset->vao = 0;
+    asset->vertex = 0;
+    asset->uv = 0;
+    asset->index = 0;
+    asset->vertex_capacity = 0;
+    asset->uv_capacity = 0;
+    asset->index_capacity = 0;
+}
+
 void face_init(struct face* asset, size_t vertex_count) {
     vector_init(&asset->vertex_buffer, sizeof(float), vertex_count * 3);
     vector_init(&asset->uv_buffer, sizeof(float), vertex_count * 2);
+    vector_init(&asset->index_buffer, sizeof(GLuint), 1);
+    face_init_gl(asset);
 }
 
 struct face* face_load_file(const char* path) {
@@ -18,6 +32,8 @@ struct face* face_load_file(const char* path) {
     fseek(file, 0, SEEK_SET);
 
     struct face* face = malloc(sizeof(struct face));
+    vector_init(&face->index_buffer, sizeof(GLuint), 1);
+    face_init_gl(face);
 
     char* line = NULL;
     size_t line_size = 0;
@@ -138,123 +154,130 @@ struct face* face_load_file(const char* path) {
 }
 
 void face_init_rects(struct face* asset, Vector* rects) {
+    face_init(asset, vector_size(rects) * 4);
+    face_set_rects(asset, rects);
+}
 
-    face_init(asset, vector_size(rects) * 6);
+static void put_corner(float* vertex, float* uv, float x, float y) {
+    vertex[0] = x;
+    vertex[1] = y;
+    vertex[2] = 0;
 
-    float* vertex = vector_reserve(&asset->vertex_buffer, vector_size(rects) * 6 * 3);
-    float* uv = vector_reserve(&asset->uv_buffer, vector_size(rects) * 6 * 2);
+    uv[0] = x;
+    uv[1] = y;
+}
+
+void face_set_rects(struct face* asset, Vector* rects) {
+    vector_clear(&asset->vertex_buffer);
+    vector_clear(&asset->uv_buffer);
+    vector_clear(&asset->index_buffer);
+
+    // Every rect is 4 corners, drawn as 2 triangles sharing the diagonal
+    float* vertex = vector_reserve(&asset->vertex_buffer, vector_size(rects) * 4 * 3);
+    float* uv = vector_reserve(&asset->uv_buffer, vector_size(rects) * 4 * 2);
+    GLuint* indices = vector_reserve(&asset->index_buffer, vector_size(rects) * 6);
 
     size_t index;
     struct Rect* rect = vector_getFirst(rects, &index);
     while(rect != NULL) {
-        // A single rect line in the vertex buffer is 3 * 6
-        float* vertex_rect = &vertex[index * 3 * 6];
-        // A single rect line in the uv buffer is 2 * 6
-        float* uv_rect = &uv[index * 2 * 6];
-
-        int vec_cnt = 0;
-        {
-            float* vertex_vec = &vertex_rect[vec_cnt * 3];
-            float* uv_vec = &uv_rect[vec_cnt * 2];
-            vec_cnt++;
-            vertex_vec[0] = rect->pos.x;
-            vertex_vec[1] = rect->pos.y;
-            vertex_vec[2] = 0;
-
-            uv_vec[0] = rect->pos.x;
-            uv_vec[1] = rect->pos.y;
-        }
+        float* vertex_rect = &vertex[index * 4 * 3];
+        float* uv_rect = &uv[index * 4 * 2];
+
+        float left = rect->pos.x;
+        float right = rect->pos.x + rect->size.x;
+        float top = rect->pos.y;
+        float bottom = rect->pos.y - rect->size.y;
+
+        // Upper left, lower left, upper right and lower right
+        put_corner(&vertex_rect[0 * 3], &uv_rect[0 * 2], left, top);
+        put_corner(&vertex_rect[1 * 3], &uv_rect[1 * 2], left, bottom);
+        put_corner(&vertex_rect[2 * 3], &uv_rect[2 * 2], right, top);
+        put_corner(&vertex_rect[3 * 3], &uv_rect[3 * 2], right, bottom);
+
+        GLuint first = index * 4;
+        GLuint* index_rect = &indices[index * 6];
+        index_rect[0] = first + 0;
+        index_rect[1] = first + 1;
+        index_rect[2] = first + 2;
+        index_rect[3] = first + 2;
+        index_rect[4] = first + 1;
+        index_rect[5] = first + 3;
 
-        {
-            float* vertex_vec = &vertex_rect[vec_cnt * 3];
-            float* uv_vec = &uv_rect[vec_cnt * 2];
-            vec_cnt++;
-            vertex_vec[0] = rect->pos.x;
-            vertex_vec[1] = rect->pos.y - rect->size.y;
-            vertex_vec[2] = 0;
-
-            uv_vec[0] = rect->pos.x;
-            uv_vec[1] = rect->pos.y - rect->size.y;
-        }
-
-        {
-            float* vertex_vec = &vertex_rect[vec_cnt * 3];
-            float* uv_vec = &uv_rect[vec_cnt * 2];
-            vec_cnt++;
-            vertex_vec[0] = rect->pos.x + rect->size.x;
-            vertex_vec[1] = rect->pos.y;
-            vertex_vec[2] = 0;
-
-            uv_vec[0] = rect->pos.x + rect->size.x;
-            uv_vec[1] = rect->pos.y;
-        }
-
-        {
-            float* vertex_vec = &vertex_rect[vec_cnt * 3];
-            float* uv_vec = &uv_rect[vec_cnt * 2];
-            vec_cnt++;
-            vertex_vec[0] = rect->pos.x + rect->size.x;
-            vertex_vec[1] = rect->pos.y;
-            vertex_vec[2] = 0;
-
-            uv_vec[0] = rect->pos.x + rect->size.x;
-            uv_vec[1] = rect->pos.y;
-        }
-
-        {
-            float* vertex_vec = &vertex_rect[vec_cnt * 3];
-            float* uv_vec = &uv_rect[vec_cnt * 2];
-            vec_cnt++;
-            vertex_vec[0] = rect->pos.x;
-            vertex_vec[1] = rect->pos.y - rect->size.y;
-            vertex_vec[2] = 0;
+        rect = vector_getNext(rects, &index);
+    }
+}
 
-            uv_vec[0] = rect->pos.x;
-            uv_vec[1] = rect->pos.y - rect->size.y;
-        }
+// Put the data in the buffer, making a new buffer only when it doesn't fit
+static void upload_buffer(GLenum target, GLuint* buffer, size_t* capacity, const Vector* data) {
+    size_t size = data->size * data->elementSize;
 
-        {
-            float* vertex_vec = &vertex_rect[vec_cnt * 3];
-            float* uv_vec = &uv_rect[vec_cnt * 2];
-            vec_cnt++;
-            vertex_vec[0] = rect->pos.x + rect->size.x;
-            vertex_vec[1] = rect->pos.y - rect->size.y;
-            vertex_vec[2] = 0;
+    if(*buffer == 0)
+        glGenBuffers(1, buffer);
+    glBindBuffer(target, *buffer);
 
-            uv_vec[0] = rect->pos.x + rect->size.x;
-            uv_vec[1] = rect->pos.y - rect->size.y;
-        }
-        rect = vector_getNext(rects, &index);
+    if(size > *capacity) {
+        glBufferData(target, size, data->data, GL_STATIC_DRAW);
+        *capacity = size;
+    } else if(size > 0) {
+        glBufferSubData(target, 0, size, data->data);
     }
 }
 
 void face_upload(struct face* asset) {
-    glGenVertexArrays(1, &asset->vao);
+    bool fresh = asset->vao == 0;
+    if(fresh)
+        glGenVertexArrays(1, &asset->vao);
+
+    glstate_bindVertexArray(asset->vao);
+
+    // The attribute pointers stay with the VAO, and keep pointing at the same
+    // buffers when we reupload
+    upload_buffer(GL_ARRAY_BUFFER, &asset->vertex, &asset->vertex_capacity, &asset->vertex_buffer);
+    if(fresh) {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    }
 
-    glGenBuffers(1, &asset->vertex);
-    glGenBuffers(1, &asset->uv);
+    upload_buffer(GL_ARRAY_BUFFER, &asset->uv, &asset->uv_capacity, &asset->uv_buffer);
+    if(fresh) {
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    }
 
-    glBindVertexArray(asset->vao);
+    // The element buffer binding is part of the VAO
+    if(vector_size(&asset->index_buffer) > 0)
+        upload_buffer(GL_ELEMENT_ARRAY_BUFFER, &asset->index, &asset->index_capacity, &asset->index_buffer);
+}
 
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, asset->vertex);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * asset->vertex_buffer.size, asset->vertex_buffer.data, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+void face_bind(const struct face* face) {
+    glstate_bindVertexArray(face->vao);
+}
 
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, asset->uv);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * asset->uv_buffer.size, asset->uv_buffer.data, GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+void face_draw(const struct face* face) {
+    if(vector_size(&face->index_buffer) > 0) {
+        glDrawElements(GL_TRIANGLES, vector_size(&face->index_buffer), GL_UNSIGNED_INT, (void*)0);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, face->vertex_buffer.size / 3);
+    }
 }
 
-void face_bind(const struct face* face) {
-    glBindVertexArray(face->vao);
+void face_drawInstanced(const struct face* face, size_t count) {
+    if(vector_size(&face->index_buffer) > 0) {
+        glDrawElementsInstanced(GL_TRIANGLES, vector_size(&face->index_buffer), GL_UNSIGNED_INT, (void*)0, count);
+    } else {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, face->vertex_buffer.size / 3, count);
+    }
 }
 
 void face_unload_file(struct face* asset) {
     glDeleteBuffers(1, &asset->vertex);
     glDeleteBuffers(1, &asset->uv);
+    if(asset->index != 0)
+        glDeleteBuffers(1, &asset->index);
+    glDeleteVertexArrays(1, &asset->vao);
+    glstate_forgetVertexArray(asset->vao);
 
     vector_kill(&asset->vertex_buffer);
     vector_kill(&asset->uv_buffer);
+    vector_kill(&asset->index_buffer);
 }
@@ -12,10 +12,19 @@
 struct face {
     Vector vertex_buffer;
     Vector uv_buffer;
+    // GLuint indices into the vertex buffer. Faces loaded from files are
+    // drawn as they are, and leave this empty.
+    Vector index_buffer;
 
     GLuint vao;
     GLuint vertex;
     GLuint uv;
+    GLuint index;
+
+    // Bytes the GL buffers can hold, so uploading again can reuse them
+    size_t vertex_capacity;
+    size_t uv_capacity;
+    size_t index_capacity;
 };
 
 struct face* face_load_file(const char* path);
@@ -28,8 +37,15 @@ struct Rect {
 
 void face_init(struct face* asset, size_t vertex_count);
 void face_init_rects(struct face* asset, Vector* rects);
+// Replace the geometry of a face that's already been initialized. The GL
+// buffers are kept, and reused on the next upload.
+void face_set_rects(struct face* asset, Vector* rects);
 
 void face_upload(struct face* asset);
 void face_bind(const struct face* face);
 
+// The face has to be bound
+void face_draw(const struct face* face);
+void face_drawInstanced(const struct face* face, size_t count);
+
 void face_unload_file(struct face* asset);
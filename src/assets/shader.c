@@ -1,5 +1,7 @@
 #include "shader.h"
 
+#include "glstate.h"
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -10,6 +12,7 @@
 #include "logging.h"
 
 #include "assets.h"
+#include "shadercache.h"
 #include "gen/shaders/include.h"
 
 static struct shader* shader_load_file(const char* path, GLenum type) {
@@ -39,25 +42,56 @@ static struct shader* shader_load_file(const char* path, GLenum type) {
     fclose(file);
 
     struct shader* shader = malloc(sizeof(struct shader));
+    if(shader == NULL) {
+        printf("Failed allocating shader %s\n", path);
+        free(buffer);
+        return NULL;
+    }
 
-    shader->gl_shader = glCreateShader(type);
-    if(shader < 0) {
-        printf("Failed creating the shader object for %s\n", path);
+    // @PERFORMANCE We don't compile until a program needs linking from
+    // source. When the program is in the cache we never have to.
+    shader->gl_shader = 0;
+    shader->type = type;
+    shader->source = buffer;
+    shader->hash = shadercache_hash(SHADERCACHE_HASH_SEED, &type, sizeof(type));
+    shader->hash = shadercache_hash(shader->hash, buffer, length);
+
+    shader->path = strdup(path);
+    if(shader->path == NULL) {
+        printf("Failed duplicating path for shader %s\n", path);
         free(buffer);
         free(shader);
         return NULL;
     }
 
-    glShaderSource(shader->gl_shader, 1, (const char**)&buffer, NULL);
+    return shader;
+}
+
+// Start compiling the shader. The driver might do it in the background, so we
+// don't ask how it went until a program using it has been linked
+static bool shader_compile(struct shader* shader) {
+    if(shader->gl_shader != 0)
+        return true;
+
+    shader->gl_shader = glCreateShader(shader->type);
+    if(shader->gl_shader == 0) {
+        printf("Failed creating the shader object for %s\n", shader->path);
+        return false;
+    }
+
+    glShaderSource(shader->gl_shader, 1, (const char**)&shader->source, NULL);
     glCompileShader(shader->gl_shader);
+    return true;
+}
 
-    // GL Lets you free the string right after the compile
-    free(buffer);
+static void shader_print_errors(struct shader* shader) {
+    if(shader->gl_shader == 0)
+        return;
 
     int status = GL_FALSE;
     glGetShaderiv(shader->gl_shader, GL_COMPILE_STATUS, &status);
     if(status == GL_FALSE) {
-        printf("Failed compiling shader %s\n", path);
+        printf("Failed compiling shader %s\n", shader->path);
 
         GLint log_len = 0;
         glGetShaderiv(shader->gl_shader, GL_INFO_LOG_LENGTH, &log_len);
@@ -67,11 +101,7 @@ static struct shader* shader_load_file(const char* path, GLenum type) {
             printf(" -- %s\n", log);
             fflush(stdout);
         }
-
-        return NULL;
     }
-
-    return shader;
 }
 
 struct shader* vert_shader_load_file(const char* path) {
@@ -84,15 +114,53 @@ struct shader* frag_shader_load_file(const char* path) {
 
 
 void shader_unload_file(struct shader* asset) {
-    glDeleteShader(asset->gl_shader);
+    if(asset->gl_shader != 0)
+        glDeleteShader(asset->gl_shader);
+    free(asset->source);
+    free(asset->path);
     free(asset);
 }
 
-static void shader_program_link(struct shader_program* program) {
+// Everything that goes into linking the program
+static uint64_t shader_program_key(const struct shader_program* program) {
+    uint64_t key = SHADERCACHE_HASH_SEED;
+    key = shadercache_hash(key, &program->vertex->hash, sizeof(program->vertex->hash));
+    key = shadercache_hash(key, &program->fragment->hash, sizeof(program->fragment->hash));
+
+    // @FRAGILE 64 here is has to be the same as the MAXIMUM length of a shader
+    // variable name
+    char name[64] = {0};
+    int* index;
+    JSLF(index, program->attributes, (uint8_t*) name);
+    while(index != NULL) {
+        key = shadercache_hash(key, name, strlen(name) + 1);
+        key = shadercache_hash(key, index, sizeof(*index));
+        JSLN(index, program->attributes, (uint8_t*)name);
+    }
+    return key;
+}
+
+// Hand the program to the driver. It's not usable until
+// shader_program_finish, which gives the driver time to build it in the
+// background.
+static bool shader_program_submit(struct shader_program* program) {
     program->gl_program = glCreateProgram();
     if(program->gl_program == 0) {
         printf("Failed creating program\n");
-        return;
+        return false;
+    }
+    program->pending = true;
+
+    program->cache_key = shader_program_key(program);
+    program->cached = shadercache_load(program->cache_key, program->gl_program);
+    if(program->cached)
+        return true;
+
+    if(!shader_compile(program->vertex) || !shader_compile(program->fragment)) {
+        glDeleteProgram(program->gl_program);
+        glstate_forgetProgram(program->gl_program);
+        program->gl_program = 0;
+        return false;
     }
 
     glAttachShader(program->gl_program, program->fragment->gl_shader);
@@ -108,12 +176,24 @@ static void shader_program_link(struct shader_program* program) {
         JSLN(key, program->attributes, (uint8_t*)name);
     }
 
+    glProgramParameteri(program->gl_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(program->gl_program);
+    return true;
+}
+
+// Wait for the driver to finish building the program, and find the uniforms.
+// Returns false if the program can't be used.
+static bool shader_program_finish(struct shader_program* program) {
+    if(!program->pending)
+        return program->gl_program != 0;
+    program->pending = false;
 
     GLint status = GL_FALSE;
     glGetProgramiv(program->gl_program, GL_LINK_STATUS, &status);
     if (GL_FALSE == status) {
-        printf("Failed linking shader\n");
+        shader_print_errors(program->vertex);
+        shader_print_errors(program->fragment);
+        printf("Failed linking shader \"%s\"\n", program->shader_type_info->name);
 
         GLint log_len = 0;
         glGetProgramiv(program->gl_program, GL_INFO_LOG_LENGTH, &log_len);
@@ -125,10 +205,34 @@ static void shader_program_link(struct shader_program* program) {
         }
 
         glDeleteProgram(program->gl_program);
+        glstate_forgetProgram(program->gl_program);
+        program->gl_program = 0;
+        return false;
     }
+
+    if(!program->cached) {
+        // A linked program doesn't need its shaders anymore
+        glDetachShader(program->gl_program, program->fragment->gl_shader);
+        glDetachShader(program->gl_program, program->vertex->gl_shader);
+
+        shadercache_store(program->cache_key, program->gl_program);
+    }
+
+    printf("Uniforms in shader \"%s\"\n", program->shader_type_info->name);
+    for(size_t i = 0; i < program->uniforms_num; i++) {
+        struct shader_value* uniform = &program->uniforms[i];
+        uniform->gl_uniform = glGetUniformLocation(program->gl_program, program->uniform_names[i]);
+        printf("\tUniform \"%s\" has id %d, required %d\n", program->uniform_names[i],
+                uniform->gl_uniform, uniform->required);
+    }
+
+    return true;
 }
 
 static int parse_type(char* def, struct shader_value* uniform) {
+    uniform->set = false;
+    uniform->cached = false;
+
     char type[64];
     char value[64];
     int matches = sscanf(def, "%63s %63[^\n]", type, value);
@@ -178,6 +282,24 @@ static int parse_type(char* def, struct shader_value* uniform) {
     } else if(strcmp(type, "sampler") == 0) {
         uniform->type = SHADER_VALUE_SAMPLER;
         uniform->required = true;
+        // A sampler can be given the unit it always reads from
+        if(matches == 2) {
+            uniform->required = false;
+
+            uniform->stock.sampler = atoi(value);
+        }
+    } else if(strcmp(type, "samplers") == 0) {
+        uniform->type = SHADER_VALUE_SAMPLERS;
+        uniform->required = true;
+
+        // The size of the array is part of the type
+        int count = matches == 2 ? atoi(value) : 0;
+        if(count <= 0 || count > SHADER_SAMPLERS_MAX) {
+            printf("Sampler array size must be between 1 and %d, got \"%s\"\n", SHADER_SAMPLERS_MAX, def);
+            return 1;
+        }
+        uniform->stock.samplers.first = 0;
+        uniform->stock.samplers.count = count;
     } else if(strcmp(type, "vec2") == 0) {
         uniform->type = SHADER_VALUE_VEC2;
 
@@ -246,12 +368,13 @@ struct shader_program* shader_program_load_file(const char* path) {
     program->vertex = NULL;
     program->fragment = NULL;
     program->attributes = NULL;
-    program->gl_program = -1;
+    program->gl_program = 0;
+    program->pending = false;
+    memset(program->uniform_names, 0, sizeof(program->uniform_names));
 
     char* shader_type = NULL;
 
     size_t uniform_cursor = 0;
-    char names[SHADER_UNIFORMS_MAX][64] = {{0}};
 
     char* line = NULL;
     size_t line_size = 0;
@@ -341,7 +464,7 @@ struct shader_program* shader_program_load_file(const char* path) {
                 continue;
             }
             char rest[128];
-            int matches = sscanf(value, "%63s %127[^\n]", names[uniform_cursor], rest);
+            int matches = sscanf(value, "%63s %127[^\n]", program->uniform_names[uniform_cursor], rest);
 
             if(matches != 2) {
                 printf("Couldn't parse the uniform definition \"%s\"\n", value);
@@ -386,13 +509,21 @@ struct shader_program* shader_program_load_file(const char* path) {
         return NULL;
     }
 
-    shader_program_link(program);
+    if(!shader_program_submit(program)) {
+        printf("Failed building the program for %s\n", path);
+        free(shader_type);
+        Word_t freed;
+        JSLFA(freed, program->attributes);
+        free(program);
+        return NULL;
+    }
 
     struct shader_type_info* shader_info = get_shader_type_info(shader_type);
     free(shader_type);
     if(shader_info == NULL) {
         printf("Failed to find shader type info for %s\n", shader_type);
         glDeleteProgram(program->gl_program);
+        glstate_forgetProgram(program->gl_program);
         free(program);
         return NULL;
     }
@@ -401,49 +532,80 @@ struct shader_program* shader_program_load_file(const char* path) {
     program->uniforms_num = uniform_cursor;
 
     // Bind the static shadertype members to the shader_value structs
-    program->shader_type = shader_info->create(program->shader_type, program, names);
+    program->shader_type = shader_info->create(program->shader_type, program, program->uniform_names);
     if(program->shader_type == NULL) {
         printf("Failed to create shader type\n");
         glDeleteProgram(program->gl_program);
+        glstate_forgetProgram(program->gl_program);
         free(program);
         return NULL;
     }
 
-    printf("Uniforms in shader \"%s\"\n", program->shader_type_info->name);
+    // Only the startup programs can be left building in the background. A
+    // hotload replaces a working program, so it has to link first.
+    if(assets_hotloading() && !shader_program_finish(program)) {
+        printf("Keeping the old program for %s\n", path);
+        shader_program_unload_file(program);
+        return NULL;
+    }
 
     return program;
 }
 
 void shader_program_unload_file(struct shader_program* asset) {
-    glDeleteProgram(asset->gl_program);
+    if(asset->gl_program != 0)
+        glDeleteProgram(asset->gl_program);
+    glstate_forgetProgram(asset->gl_program);
     free(asset->shader_type);
     Word_t freed;
     JSLFA(freed, asset->attributes);
     free(asset);
 }
 
-static void set_shader_uniform(const struct shader_value* uniform, const union shader_uniform_value* value) {
+// Returns true if the uniform has to be sent to GL, and remembers the value
+static bool cache_uniform(struct shader_value* uniform, const void* value, size_t size) {
+    if(uniform->cached && memcmp(&uniform->current, value, size) == 0)
+        return glstate_count(false);
+
+    memcpy(&uniform->current, value, size);
+    uniform->cached = true;
+    return glstate_count(true);
+}
+
+static void set_shader_uniform(struct shader_value* uniform, const union shader_uniform_value* value) {
     switch(uniform->type) {
         case SHADER_VALUE_BOOL:
-            glUniform1i(uniform->gl_uniform, value->boolean);
+            shader_set_uniform_bool(uniform, value->boolean);
             break;
         case SHADER_VALUE_FLOAT:
-            glUniform1f(uniform->gl_uniform, (double)value->flt);
+            shader_set_uniform_float(uniform, value->flt);
             break;
         case SHADER_VALUE_INT:
-            glUniform1i(uniform->gl_uniform, (double)value->integer);
+            shader_set_uniform_int(uniform, value->integer);
             break;
         case SHADER_VALUE_VEC2:
-            glUniform2f(uniform->gl_uniform, value->vector.x, value->vector.y);
+            shader_set_uniform_vec2(uniform, &value->vector);
             break;
         case SHADER_VALUE_VEC3:
-            glUniform3f(uniform->gl_uniform, value->vec3.x, value->vec3.y, value->vec3.z);
+            shader_set_uniform_vec3(uniform, &value->vec3);
             break;
         case SHADER_VALUE_MAT4:
             shader_set_uniform_mat4(uniform, &value->mat4);
+            break;
         case SHADER_VALUE_SAMPLER:
-            glUniform1i(uniform->gl_uniform, value->sampler);
+            shader_set_uniform_sampler(uniform, value->sampler);
+            break;
+        case SHADER_VALUE_SAMPLERS: {
+            if(!cache_uniform(uniform, &value->samplers, sizeof(value->samplers)))
+                break;
+
+            GLint units[SHADER_SAMPLERS_MAX];
+            for(GLint i = 0; i < value->samplers.count; i++) {
+                units[i] = value->samplers.first + i;
+            }
+            glUniform1iv(uniform->gl_uniform, value->samplers.count, units);
             break;
+        }
         case SHADER_VALUE_IGNORED:
             // Ignored shaders aren't set
             break;
@@ -459,7 +621,14 @@ void shader_use(struct shader_program* shader) {
         assert(!uniform->required || uniform->set);
     }
 
-    glUseProgram(shader->gl_program);
+    // @PERFORMANCE This is where we wait if the driver is still building the
+    // program
+    if(!shader_program_finish(shader)) {
+        glstate_useProgram(0);
+        return;
+    }
+
+    glstate_useProgram(shader->gl_program);
 
     for(size_t i = 0; i < shader->uniforms_num; i++) {
         struct shader_value* uniform = &shader->uniforms[i];
@@ -472,32 +641,39 @@ void shader_use(struct shader_program* shader) {
     }
 }
 
-void shader_set_uniform_bool(const struct shader_value* uniform, bool value) {
-    glUniform1i(uniform->gl_uniform, value);
+void shader_set_uniform_bool(struct shader_value* uniform, bool value) {
+    if(cache_uniform(uniform, &value, sizeof(value)))
+        glUniform1i(uniform->gl_uniform, value);
 }
 
-void shader_set_uniform_float(const struct shader_value* uniform, float value) {
-    glUniform1f(uniform->gl_uniform, value);
+void shader_set_uniform_float(struct shader_value* uniform, float value) {
+    if(cache_uniform(uniform, &value, sizeof(value)))
+        glUniform1f(uniform->gl_uniform, value);
 }
 
-void shader_set_uniform_int(const struct shader_value* uniform, int32_t value) {
-    glUniform1i(uniform->gl_uniform, value);
+void shader_set_uniform_int(struct shader_value* uniform, int32_t value) {
+    if(cache_uniform(uniform, &value, sizeof(value)))
+        glUniform1i(uniform->gl_uniform, value);
 }
 
-void shader_set_uniform_vec2(const struct shader_value* uniform, const Vector2* value) {
-    glUniform2f(uniform->gl_uniform, value->x, value->y);
+void shader_set_uniform_vec2(struct shader_value* uniform, const Vector2* value) {
+    if(cache_uniform(uniform, value, sizeof(*value)))
+        glUniform2f(uniform->gl_uniform, value->x, value->y);
 }
 
-void shader_set_uniform_vec3(const struct shader_value* uniform, const Vector3* value) {
-    glUniform3f(uniform->gl_uniform, value->x, value->y, value->z);
+void shader_set_uniform_vec3(struct shader_value* uniform, const Vector3* value) {
+    if(cache_uniform(uniform, value, sizeof(*value)))
+        glUniform3f(uniform->gl_uniform, value->x, value->y, value->z);
 }
 
-void shader_set_uniform_mat4(const struct shader_value* uniform, const Matrix* value) {
-    glUniformMatrix4fv(uniform->gl_uniform, 1, GL_FALSE, value->m);
+void shader_set_uniform_mat4(struct shader_value* uniform, const Matrix* value) {
+    if(cache_uniform(uniform, value, sizeof(*value)))
+        glUniformMatrix4fv(uniform->gl_uniform, 1, GL_FALSE, value->m);
 }
 
-void shader_set_uniform_sampler(const struct shader_value* uniform, int value) {
-    glUniform1i(uniform->gl_uniform, value);
+void shader_set_uniform_sampler(struct shader_value* uniform, int value) {
+    if(cache_uniform(uniform, &value, sizeof(value)))
+        glUniform1i(uniform->gl_uniform, value);
 }
 
 void shader_set_future_uniform_bool(struct shader_value* uniform, bool value) {
@@ -530,6 +706,12 @@ void shader_set_future_uniform_sampler(struct shader_value* uniform, int value)
     uniform->set = true;
 }
 
+void shader_set_future_uniform_samplers(struct shader_value* uniform, int first) {
+    uniform->value.samplers.first = first;
+    uniform->value.samplers.count = uniform->stock.samplers.count;
+    uniform->set = true;
+}
+
 void shader_clear_future_uniform(struct shader_value* uniform) {
     uniform->set = false;
 }
@@ -8,7 +8,13 @@
 #include <Judy.h>
 
 struct shader {
+    // 0 until a program has to be linked from this shader
     GLuint gl_shader;
+    GLenum type;
+    char* path;
+    char* source;
+    // Identifies the source for the program cache
+    uint64_t hash;
 };
 
 struct shader* vert_shader_load_file(const char* path);
@@ -16,7 +22,9 @@ struct shader* frag_shader_load_file(const char* path);
 
 void shader_unload_file(struct shader* asset);
 
-#define SHADER_UNIFORMS_MAX 8
+#define SHADER_UNIFORMS_MAX 16
+// The most texture units a sampler array can span
+#define SHADER_SAMPLERS_MAX 16
 
 enum shader_value_type {
     SHADER_VALUE_BOOL,
@@ -26,6 +34,7 @@ enum shader_value_type {
     SHADER_VALUE_VEC3,
     SHADER_VALUE_MAT4,
     SHADER_VALUE_SAMPLER,
+    SHADER_VALUE_SAMPLERS,
     SHADER_VALUE_IGNORED,
 };
 
@@ -37,6 +46,11 @@ union shader_uniform_value {
     Vector3 vec3;
     Matrix mat4;
     GLint sampler;
+    // A sampler array bound to count consecutive units
+    struct {
+        GLint first;
+        GLint count;
+    } samplers;
 };
 
 struct shader_value {
@@ -48,6 +62,11 @@ struct shader_value {
 
     bool set;
     union shader_uniform_value value;
+
+    // What the program has right now, uniforms keep their value between uses
+    // so we only have to tell GL when it changes
+    bool cached;
+    union shader_uniform_value current;
 };
 
 struct shader_program {
@@ -58,21 +77,29 @@ struct shader_program {
     Pvoid_t attributes;
     GLuint gl_program;
 
+    // The driver might still be building the program, it's done the first
+    // time the program is used
+    bool pending;
+    uint64_t cache_key;
+    // The program came from the program cache, so it has no shaders attached
+    bool cached;
+
     size_t uniforms_num;
     struct shader_value uniforms[SHADER_UNIFORMS_MAX];
+    char uniform_names[SHADER_UNIFORMS_MAX][64];
 };
 struct shader_program* shader_program_load_file(const char* path);
 void shader_program_unload_file(struct shader_program* asset);
 
 void shader_use(struct shader_program* shader);
 
-void shader_set_uniform_bool(const struct shader_value* location, bool value);
-void shader_set_uniform_float(const struct shader_value* location, float value);
-void shader_set_uniform_int(const struct shader_value* location, int32_t value);
-void shader_set_uniform_vec2(const struct shader_value* location, const Vector2* value);
-void shader_set_uniform_vec3(const struct shader_value* uniform, const Vector3* value);
-void shader_set_uniform_mat4(const struct shader_value* uniform, const Matrix* value);
-void shader_set_uniform_sampler(const struct shader_value* location, int value);
+void shader_set_uniform_bool(struct shader_value* location, bool value);
+void shader_set_uniform_float(struct shader_value* location, float value);
+void shader_set_uniform_int(struct shader_value* location, int32_t value);
+void shader_set_uniform_vec2(struct shader_value* location, const Vector2* value);
+void shader_set_uniform_vec3(struct shader_value* uniform, const Vector3* value);
+void shader_set_uniform_mat4(struct shader_value* uniform, const Matrix* value);
+void shader_set_uniform_sampler(struct shader_value* location, int value);
 
 void shader_set_future_uniform_bool(struct shader_value* location, bool value);
 void shader_set_future_uniform_float(struct shader_value* location, float value);
@@ -80,5 +107,6 @@ void shader_set_future_uniform_int(struct shader_value* location, int32_t value)
 void shader_set_future_uniform_vec2(struct shader_value* location, const Vector2* value);
 void shader_set_future_uniform_vec3(struct shader_value* location, const Vector3* value);
 void shader_set_future_uniform_sampler(struct shader_value* location, int value);
+void shader_set_future_uniform_samplers(struct shader_value* location, int first);
 
 void shader_clear_future_uniform(struct shader_value* uniform);
@@ -0,0 +1,261 @@
+#include "shadercache.h"
+
+#include <string.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.h"
+
+#define SHADERCACHE_MAGIC "NCPROG"
+// Bump when the file layout changes
+#define SHADERCACHE_VERSION 1
+
+struct shadercache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t driver_length;
+    uint64_t binary_length;
+};
+
+static bool enabled = false;
+static char* cache_dir = NULL;
+// Vendor, renderer and version of the driver, binaries only work on the
+// driver that made them
+static char* driver = NULL;
+
+// Create dir and all its parents
+static bool make_dirs(const char* dir) {
+    char* path = strdup(dir);
+    if(path == NULL)
+        return false;
+
+    for(char* cursor = path + 1; ; cursor++) {
+        if(*cursor != '/' && *cursor != '\0')
+            continue;
+
+        char end = *cursor;
+        *cursor = '\0';
+        if(mkdir(path, 0755) != 0 && errno != EEXIST) {
+            printf_errf("Failed creating the directory %s: %s", path, strerror(errno));
+            free(path);
+            return false;
+        }
+        *cursor = end;
+
+        if(end == '\0')
+            break;
+    }
+
+    free(path);
+    return true;
+}
+
+void shadercache_init(const char* dir) {
+    shadercache_delete();
+
+    if(dir == NULL)
+        return;
+
+    // An unknown enum leaves the value alone, so this also covers drivers
+    // without program binaries at all
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if(formats <= 0) {
+        printf_dbgf("Program binaries not supported, shaders are built from source");
+        return;
+    }
+
+    const char* vendor = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if(vendor == NULL || renderer == NULL || version == NULL)
+        return;
+
+    if(!make_dirs(dir))
+        return;
+
+    if(asprintf(&driver, "%s\n%s\n%s", vendor, renderer, version) < 0) {
+        driver = NULL;
+        return;
+    }
+    cache_dir = strdup(dir);
+    if(cache_dir == NULL) {
+        free(driver);
+        driver = NULL;
+        return;
+    }
+
+    enabled = true;
+}
+
+void shadercache_delete() {
+    enabled = false;
+    free(cache_dir);
+    cache_dir = NULL;
+    free(driver);
+    driver = NULL;
+}
+
+// FNV-1a, we just need something that changes with the source
+uint64_t shadercache_hash(uint64_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+    for(size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static char* key_path(uint64_t key) {
+    char* path;
+    if(asprintf(&path, "%s/%016" PRIx64 ".bin", cache_dir, key) < 0)
+        return NULL;
+    return path;
+}
+
+bool shadercache_write_file(const char* path, const char* driver, GLenum format,
+        const void* binary, size_t length) {
+    struct shadercache_header header = {
+        .magic = SHADERCACHE_MAGIC,
+        .version = SHADERCACHE_VERSION,
+        .format = format,
+        .driver_length = strlen(driver),
+        .binary_length = length,
+    };
+
+    // Write somewhere else first and move it into place, so a crash or
+    // another instance never sees half a file
+    char* tmp_path;
+    if(asprintf(&tmp_path, "%s.%d.tmp", path, getpid()) < 0)
+        return false;
+
+    FILE* file = fopen(tmp_path, "wb");
+    if(file == NULL) {
+        printf_errf("Failed opening %s: %s", tmp_path, strerror(errno));
+        free(tmp_path);
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(driver, 1, header.driver_length, file) == header.driver_length
+        && fwrite(binary, 1, length, file) == length;
+    written = fclose(file) == 0 && written;
+
+    if(!written || rename(tmp_path, path) != 0) {
+        printf_errf("Failed writing %s", path);
+        unlink(tmp_path);
+        free(tmp_path);
+        return false;
+    }
+
+    free(tmp_path);
+    return true;
+}
+
+bool shadercache_read_file(const char* path, const char* driver, GLenum* format,
+        void** binary, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL)
+        return false;
+
+    struct shadercache_header header;
+    if(fread(&header, sizeof(header), 1, file) != 1
+            || memcmp(header.magic, SHADERCACHE_MAGIC, sizeof(SHADERCACHE_MAGIC)) != 0
+            || header.version != SHADERCACHE_VERSION
+            || header.driver_length != strlen(driver)) {
+        fclose(file);
+        return false;
+    }
+
+    char stored_driver[header.driver_length];
+    if(fread(stored_driver, 1, header.driver_length, file) != header.driver_length
+            || memcmp(stored_driver, driver, header.driver_length) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    void* data = malloc(header.binary_length);
+    if(data == NULL) {
+        fclose(file);
+        return false;
+    }
+
+    if(fread(data, 1, header.binary_length, file) != header.binary_length) {
+        free(data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    *format = header.format;
+    *binary = data;
+    *length = header.binary_length;
+    return true;
+}
+
+bool shadercache_load(uint64_t key, GLuint program) {
+    if(!enabled)
+        return false;
+
+    char* path = key_path(key);
+    if(path == NULL)
+        return false;
+
+    GLenum format;
+    void* binary;
+    size_t length;
+    if(!shadercache_read_file(path, driver, &format, &binary, &length)) {
+        free(path);
+        return false;
+    }
+
+    glProgramBinary(program, format, binary, length);
+    free(binary);
+
+    // The driver is free to reject binaries it doesn't like anymore, the
+    // caller will link from source and replace the file
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status == GL_FALSE) {
+        printf_dbgf("Cached program %s was rejected by the driver", path);
+        unlink(path);
+        free(path);
+        return false;
+    }
+
+    free(path);
+    return true;
+}
+
+void shadercache_store(uint64_t key, GLuint program) {
+    if(!enabled)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0)
+        return;
+
+    void* binary = malloc(length);
+    if(binary == NULL)
+        return;
+
+    GLenum format;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary);
+    if(written <= 0) {
+        free(binary);
+        return;
+    }
+
+    char* path = key_path(key);
+    if(path != NULL)
+        shadercache_write_file(path, driver, format, binary, written);
+
+    free(path);
+    free(binary);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <GL/glx.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Linked programs are kept on disk as driver binaries so we don't have to
+// compile and link them from source every time we start. The key is a hash of
+// everything that goes into the link, the driver is checked when loading.
+
+// Start using the cache in dir for the current GL context. Without support for
+// program binaries the cache stays disabled and everything is built from
+// source.
+void shadercache_init(const char* dir);
+void shadercache_delete();
+
+uint64_t shadercache_hash(uint64_t hash, const void* data, size_t length);
+#define SHADERCACHE_HASH_SEED 0xcbf29ce484222325ULL
+
+// Load the cached binary for key into program. Returns false if it has to be
+// linked from source.
+bool shadercache_load(uint64_t key, GLuint program);
+// Remember the binary of a freshly linked program
+void shadercache_store(uint64_t key, GLuint program);
+
+// The file format, independent of GL
+bool shadercache_write_file(const char* path, const char* driver, GLenum format,
+        const void* binary, size_t length);
+// binary is allocated and has to be freed by the caller. A file from another
+// driver is rejected.
+bool shadercache_read_file(const char* path, const char* driver, GLenum* format,
+        void** binary, size_t* length);
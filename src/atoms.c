@@ -1,8 +1,13 @@
 #include "atoms.h"
 
 #include "intercept/xorg.h"
+#include "logging.h"
 #include "session.h"
 
+#include "profiler/zone.h"
+
+DECLARE_ZONE(intern_atoms);
+
 
 Atom get_atom(struct X11Context* context, const char* atom_name) {
   return get_atom_internal(context->display, atom_name);
@@ -12,53 +17,63 @@ Atom get_atom_internal(Display* display, const char* atom_name) {
   return XInternAtomH(display, atom_name, False);
 }
 
+struct AtomRequest {
+    char* name;
+    Atom* atom;
+};
+
 void atoms_init(struct Atoms* atoms, Display* display) {
-    atoms->atom_client = get_atom_internal(display, "WM_STATE");
+    zone_scope(&ZONE_intern_atoms);
+
     atoms->atom_name = XA_WM_NAME;
-    atoms->atom_name_ewmh = get_atom_internal(display, "_NET_WM_NAME");
     atoms->atom_class = XA_WM_CLASS;
-    atoms->atom_role = get_atom_internal(display, "WM_WINDOW_ROLE");
     atoms->atom_transient = XA_WM_TRANSIENT_FOR;
-    atoms->atom_client_leader = get_atom_internal(display, "WM_CLIENT_LEADER");
-    atoms->atom_ewmh_active_win = get_atom_internal(display, "_NET_ACTIVE_WINDOW");
-    atoms->atom_compton_shadow = get_atom_internal(display, "_COMPTON_SHADOW");
-    atoms->atom_bypass = get_atom_internal(display, "_NET_WM_BYPASS_COMPOSITOR");
-
-    atoms->atom_win_type = get_atom_internal(display, "_NET_WM_WINDOW_TYPE");
     atoms->atoms_wintypes[WINTYPE_UNKNOWN] = 0;
-    atoms->atoms_wintypes[WINTYPE_DESKTOP] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_DESKTOP");
-    atoms->atoms_wintypes[WINTYPE_DOCK] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_DOCK");
-    atoms->atoms_wintypes[WINTYPE_TOOLBAR] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_TOOLBAR");
-    atoms->atoms_wintypes[WINTYPE_MENU] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_MENU");
-    atoms->atoms_wintypes[WINTYPE_UTILITY] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_UTILITY");
-    atoms->atoms_wintypes[WINTYPE_SPLASH] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_SPLASH");
-    atoms->atoms_wintypes[WINTYPE_DIALOG] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_DIALOG");
-    atoms->atoms_wintypes[WINTYPE_NORMAL] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_NORMAL");
-    atoms->atoms_wintypes[WINTYPE_DROPDOWN_MENU] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU");
-    atoms->atoms_wintypes[WINTYPE_POPUP_MENU] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_POPUP_MENU");
-    atoms->atoms_wintypes[WINTYPE_TOOLTIP] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_TOOLTIP");
-    atoms->atoms_wintypes[WINTYPE_NOTIFY] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_NOTIFICATION");
-    atoms->atoms_wintypes[WINTYPE_COMBO] = get_atom_internal(display,
-               "_NET_WM_WINDOW_TYPE_COMBO");
-    atoms->atoms_wintypes[WINTYPE_DND] = get_atom_internal(display,
-                  "_NET_WM_WINDOW_TYPE_DND");
-
-    atoms->atom_xrootmapid = get_atom_internal(display,
-                  "_XROOTPMAP_ID");
-    atoms->atom_xsetrootid = get_atom_internal(display,
-                  "_XSETROOT_ID");
+
+    struct AtomRequest requests[] = {
+        {"WM_STATE", &atoms->atom_client},
+        {"_NET_WM_NAME", &atoms->atom_name_ewmh},
+        {"WM_WINDOW_ROLE", &atoms->atom_role},
+        {"WM_CLIENT_LEADER", &atoms->atom_client_leader},
+        {"_NET_ACTIVE_WINDOW", &atoms->atom_ewmh_active_win},
+        {"_COMPTON_SHADOW", &atoms->atom_compton_shadow},
+        {"_NET_WM_BYPASS_COMPOSITOR", &atoms->atom_bypass},
+
+        {"_NET_WM_WINDOW_TYPE", &atoms->atom_win_type},
+        {"_NET_WM_WINDOW_TYPE_DESKTOP", &atoms->atoms_wintypes[WINTYPE_DESKTOP]},
+        {"_NET_WM_WINDOW_TYPE_DOCK", &atoms->atoms_wintypes[WINTYPE_DOCK]},
+        {"_NET_WM_WINDOW_TYPE_TOOLBAR", &atoms->atoms_wintypes[WINTYPE_TOOLBAR]},
+        {"_NET_WM_WINDOW_TYPE_MENU", &atoms->atoms_wintypes[WINTYPE_MENU]},
+        {"_NET_WM_WINDOW_TYPE_UTILITY", &atoms->atoms_wintypes[WINTYPE_UTILITY]},
+        {"_NET_WM_WINDOW_TYPE_SPLASH", &atoms->atoms_wintypes[WINTYPE_SPLASH]},
+        {"_NET_WM_WINDOW_TYPE_DIALOG", &atoms->atoms_wintypes[WINTYPE_DIALOG]},
+        {"_NET_WM_WINDOW_TYPE_NORMAL", &atoms->atoms_wintypes[WINTYPE_NORMAL]},
+        {"_NET_WM_WINDOW_TYPE_DROPDOWN_MENU", &atoms->atoms_wintypes[WINTYPE_DROPDOWN_MENU]},
+        {"_NET_WM_WINDOW_TYPE_POPUP_MENU", &atoms->atoms_wintypes[WINTYPE_POPUP_MENU]},
+        {"_NET_WM_WINDOW_TYPE_TOOLTIP", &atoms->atoms_wintypes[WINTYPE_TOOLTIP]},
+        {"_NET_WM_WINDOW_TYPE_NOTIFICATION", &atoms->atoms_wintypes[WINTYPE_NOTIFY]},
+        {"_NET_WM_WINDOW_TYPE_COMBO", &atoms->atoms_wintypes[WINTYPE_COMBO]},
+        {"_NET_WM_WINDOW_TYPE_DND", &atoms->atoms_wintypes[WINTYPE_DND]},
+
+        {"_XROOTPMAP_ID", &atoms->atom_xrootmapid},
+        {"_XSETROOT_ID", &atoms->atom_xsetrootid},
+    };
+    const size_t numRequests = sizeof(requests) / sizeof(struct AtomRequest);
+
+    // Intern them all in a single round trip
+    char* names[numRequests];
+    Atom values[numRequests];
+    for(size_t i = 0; i < numRequests; i++) {
+        names[i] = requests[i].name;
+    }
+
+    if(!XInternAtomsH(display, names, numRequests, False, values)) {
+        printf_errf("Failed interning some atoms");
+    }
+
+    for(size_t i = 0; i < numRequests; i++) {
+        *requests[i].atom = values[i];
+    }
 
     vector_init(&atoms->extra, sizeof(Atom), 4);
 }
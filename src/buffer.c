@@ -33,3 +33,12 @@ void bo_update(struct BufferObject* bo, size_t offset, size_t size, void* data)
     glBindBuffer(GL_TEXTURE_BUFFER, bo->gl);
     glBufferSubData(GL_TEXTURE_BUFFER, offset, size, data);
 }
+
+// Respecify the whole buffer. The driver can hand us fresh storage instead of
+// waiting for the GPU to finish reading the old contents.
+void bo_replace(struct BufferObject* bo, size_t size, void* data) {
+    glBindBuffer(GL_TEXTURE_BUFFER, bo->gl);
+    glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+    bo->size = size;
+    bo->allocated = true;
+}
@@ -17,3 +17,4 @@ int bo_init(struct BufferObject* bo, const size_t size);
 void bo_delete(struct BufferObject* bo);
 bool bo_initialized(const struct BufferObject* bo);
 void bo_update(struct BufferObject* bo, size_t offset, size_t size, void* data);
+void bo_replace(struct BufferObject* bo, size_t size, void* data);
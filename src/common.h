@@ -143,9 +143,6 @@ typedef uint64_t win_id;
 #define US_PER_SEC 1000000L
 #define MS_PER_SEC 1000
 
-/// @brief Maximum OpenGL buffer age.
-#define CGLX_MAX_BUFFER_AGE 5
-
 // Window flags
 
 // Window size is changed
@@ -313,4 +310,7 @@ glx_init(session_t *ps);
 
 void
 glx_destroy(session_t *ps);
+
+bool
+glx_hasglxext(session_t *ps, const char *ext);
 ///@}
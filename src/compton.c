@@ -18,6 +18,7 @@
 #include "logging.h"
 
 #include "opengl.h"
+#include "glstate.h"
 #include "swiss.h"
 #include "vmath.h"
 #include "window.h"
@@ -27,6 +28,7 @@
 #include "timer.h"
 #include "paths.h"
 #include "debug.h"
+#include "framegraph.h"
 
 #include "systems/blur.h"
 #include "systems/shape.h"
@@ -36,10 +38,13 @@
 #include "systems/xorg.h"
 #include "systems/opacity.h"
 #include "systems/order.h"
+#include "systems/occlusion.h"
+#include "systems/damage.h"
 #include "systems/state.h"
 
 #include "assets/assets.h"
 #include "assets/shader.h"
+#include "assets/shadercache.h"
 
 #include "renderutil.h"
 
@@ -54,12 +59,18 @@
 // === Global constants ===
 
 DECLARE_ZONE(global);
+DECLARE_ZONE(startup);
+DECLARE_ZONE(startup_xorg);
+DECLARE_ZONE(startup_glx);
+DECLARE_ZONE(startup_shaders);
+DECLARE_ZONE(startup_scan);
 DECLARE_ZONE(input);
 DECLARE_ZONE(preprocess);
 DECLARE_ZONE(handle_event);
 
 DECLARE_ZONE(one_event);
 DECLARE_ZONE(sleep);
+DECLARE_ZONE(frame_wait);
 
 DECLARE_ZONE(update);
 DECLARE_ZONE(update_z);
@@ -71,7 +82,6 @@ DECLARE_ZONE(remove_input);
 DECLARE_ZONE(commit_resize);
 
 DECLARE_ZONE(paint);
-DECLARE_ZONE(effect_textures);
 DECLARE_ZONE(blur_background);
 DECLARE_ZONE(fetch_prop);
 
@@ -82,18 +92,7 @@ DECLARE_ZONE(update_fade);
 // From the header {{{
 //
 static win_id find_win(session_t *ps, Window id) {
-    if (!id)
-        return -1;
-
-    for_components(it, &ps->win_list,
-            COMPONENT_TRACKS_WINDOW, CQ_END) {
-        struct TracksWindowComponent* w = swiss_getComponent(&ps->win_list, COMPONENT_TRACKS_WINDOW, it.id);
-
-        if (w->id == id)
-            return it.id;
-    }
-
-    return -1;
+    return winindex_find(&ps->win_index, id);
 }
 
 static void wintype_arr_enable(bool arr[]) {
@@ -104,13 +103,6 @@ static void wintype_arr_enable(bool arr[]) {
     }
 }
 
-static struct timeval ms_to_tv(int timeout) {
-    return (struct timeval) {
-        .tv_sec = timeout / MS_PER_SEC,
-        .tv_usec = timeout % MS_PER_SEC * (US_PER_SEC / MS_PER_SEC)
-    };
-}
-
 // @X11
 static bool validate_pixmap(session_t *ps, Pixmap pxmap) {
     if (!pxmap) return false;
@@ -155,6 +147,24 @@ const char* const StateNames[] = {
     "Destroyed",
 };
 
+// The programs we draw with. They are handed to the driver before we scan the
+// X tree, so it can build them in the meantime.
+static const char* const STARTUP_PROGRAMS[] = {
+    "batch.shader",
+    "bgblit.shader",
+    "downscale.shader",
+    "global.shader",
+    "passthough.shader",
+    "postshadow.shader",
+    "profiler.shader",
+    "shadow.shader",
+    "stencil.shader",
+    "text.shader",
+    "tint.shader",
+    "upsample.shader",
+    "window.shader",
+};
+
 // === Global variables ===
 
 /// Pointer to current session, as a global variable. Only used by
@@ -164,6 +174,104 @@ session_t *ps_g = NULL;
 
 // === Windows ===
 
+// How many frames old the back buffer is, 0 if we don't know
+static int back_buffer_age(session_t* ps) {
+    if(ps->psglx->has_buffer_age) {
+        unsigned int age = 0;
+        glXQueryDrawable(ps->dpy, ps->overlay, GLX_BACK_BUFFER_AGE_EXT, &age);
+        return age;
+    }
+
+    // We never swap, so the back buffer has the last frame in it
+    if(ps->psglx->glXCopySubBufferProc != NULL)
+        return 1;
+
+    return 0;
+}
+
+static void gl_scissor_rect(session_t* ps, const struct Rect* rect) {
+    int x1 = floor(rect->pos.x);
+    int y1 = floor(rect->pos.y);
+    int x2 = ceil(rect->pos.x + rect->size.x);
+    int y2 = ceil(rect->pos.y + rect->size.y);
+    glScissor(x1, ps->root_size.y - y2, x2 - x1, y2 - y1);
+}
+
+// Limit painting to the damaged region. A single rectangle only needs the
+// scissor, more than that are marked in the stencil.
+static void clip_to_damage(session_t* ps, const Vector* region) {
+    struct Rect bounds = {{{0, 0}}, {{0, 0}}};
+    size_t index;
+    const struct Rect* rect = vector_getFirst(region, &index);
+    if(rect != NULL) {
+        Vector2 low = rect->pos;
+        Vector2 high = rect->pos;
+        vec2_add(&high, &rect->size);
+        while(rect != NULL) {
+            low.x = fmin(low.x, rect->pos.x);
+            low.y = fmin(low.y, rect->pos.y);
+            high.x = fmax(high.x, rect->pos.x + rect->size.x);
+            high.y = fmax(high.y, rect->pos.y + rect->size.y);
+            rect = vector_getNext(region, &index);
+        }
+        bounds.pos = low;
+        bounds.size = high;
+        vec2_sub(&bounds.size, &low);
+    }
+
+    glstate_enable(GL_SCISSOR_TEST);
+    gl_scissor_rect(ps, &bounds);
+
+    if(vector_size(region) <= 1)
+        return;
+
+    glstate_stencilMask(0xFF);
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+
+    glClearStencil(1);
+    rect = vector_getFirst(region, &index);
+    while(rect != NULL) {
+        gl_scissor_rect(ps, rect);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        rect = vector_getNext(region, &index);
+    }
+    glClearStencil(0);
+
+    gl_scissor_rect(ps, &bounds);
+
+    glstate_enable(GL_STENCIL_TEST);
+    glstate_stencilMask(0);
+    glstate_stencilFunc(GL_EQUAL, 1, 0xFF);
+    glstate_stencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+}
+
+// Without buffer age we keep painting the same back buffer, and copy what
+// changed to the front
+static void present_frame(session_t* ps) {
+    f_CopySubBuffer copy = ps->psglx->glXCopySubBufferProc;
+    if(copy == NULL) {
+        glXSwapBuffers(ps->dpy, ps->overlay);
+        return;
+    }
+
+    if(!ps->damage.partial) {
+        copy(ps->dpy, ps->overlay, 0, 0, ps->root_size.x, ps->root_size.y);
+        return;
+    }
+
+    size_t index;
+    const struct Rect* rect = vector_getFirst(&ps->damage.region, &index);
+    while(rect != NULL) {
+        int x1 = floor(rect->pos.x);
+        int y1 = floor(rect->pos.y);
+        int x2 = ceil(rect->pos.x + rect->size.x);
+        int y2 = ceil(rect->pos.y + rect->size.y);
+        copy(ps->dpy, ps->overlay, x1, ps->root_size.y - y2, x2 - x1, y2 - y1);
+        rect = vector_getNext(&ps->damage.region, &index);
+    }
+}
+
 /**
  * Paint root window content.
  */
@@ -172,13 +280,144 @@ static void paint_root(session_t *ps) {
 
     glViewport(0, 0, ps->root_size.x, ps->root_size.y);
 
-    glEnable(GL_DEPTH_TEST);
+    glstate_enable(GL_DEPTH_TEST);
 
     struct face* face = assets_load("window.face");
     Vector3 pos = {{0, 0, 0.9999}};
     draw_tex(face, &ps->root_texture.texture, &pos, &ps->root_size);
 
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_DEPTH_TEST);
+}
+
+// What the passes of a frame draw
+struct FrameLists {
+    session_t* ps;
+    Vector* opaque;
+    Vector* transparent;
+};
+
+static void pass_shadows(struct FrameGraph* graph, void* userdata) {
+    struct FrameLists* lists = userdata;
+    shadowsystem_updateShadow(lists->ps, lists->transparent);
+}
+
+static void pass_blur(struct FrameGraph* graph, void* userdata) {
+    struct FrameLists* lists = userdata;
+    session_t* ps = lists->ps;
+    blursystem_updateBlur(&ps->win_list, &ps->root_size, &ps->root_texture.texture,
+            ps->o.blur_level, lists->opaque, lists->transparent, ps);
+}
+
+static void pass_setup(struct FrameGraph* graph, void* userdata) {
+    struct FrameLists* lists = userdata;
+    session_t* ps = lists->ps;
+
+    glstate_depthMask(GL_TRUE);
+    glstate_bindFramebuffer(GL_FRAMEBUFFER, 0);
+    static const GLenum DRAWBUFS[2] = { GL_BACK_LEFT };
+    glDrawBuffers(1, DRAWBUFS);
+    glViewport(0, 0, ps->root_size.x, ps->root_size.y);
+
+    damagesystem_region(&ps->damage, back_buffer_age(ps));
+    if(ps->damage.partial)
+        clip_to_damage(ps, &ps->damage.region);
+
+    glClearDepth(1.0);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glstate_depthFunc(GL_LESS);
+}
+
+static void pass_opaque(struct FrameGraph* graph, void* userdata) {
+    struct FrameLists* lists = userdata;
+    windowlist_drawBackground(lists->ps, lists->opaque);
+    windowlist_drawTint(lists->ps);
+    windowlist_draw(lists->ps, lists->opaque);
+}
+
+static void pass_root(struct FrameGraph* graph, void* userdata) {
+    struct FrameLists* lists = userdata;
+    paint_root(lists->ps);
+}
+
+static void pass_transparent(struct FrameGraph* graph, void* userdata) {
+    struct FrameLists* lists = userdata;
+    windowlist_drawTransparent(lists->ps, lists->transparent);
+}
+
+static void pass_finish(struct FrameGraph* graph, void* userdata) {
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
+
+#ifdef DEBUG_WINDOWS
+    struct FrameLists* lists = userdata;
+    draw_component_debug(&lists->ps->win_list, &lists->ps->root_size);
+#endif
+}
+
+static bool any_with(Swiss* em, const Vector* windows, enum ComponentType type) {
+    for(size_t i = 0; i < vector_size(windows); i++) {
+        win_id wid = *(win_id*)vector_get(windows, i);
+        if(swiss_hasComponent(em, type, wid))
+            return true;
+    }
+    return false;
+}
+
+// Passes only declare what they actually use this frame, so the effects
+// nobody draws are culled
+static void build_frame_graph(struct FrameGraph* graph, struct FrameLists* lists) {
+    session_t* ps = lists->ps;
+    Swiss* em = &ps->win_list;
+
+    framegraph_begin(graph);
+
+    size_t back = framegraph_resource(graph, "back buffer", FRAMEGRAPH_COLOR, FRAMEGRAPH_OUTPUT);
+    size_t depth = framegraph_resource(graph, "depth", FRAMEGRAPH_DEPTH, FRAMEGRAPH_IMPORTED);
+    size_t stencil = framegraph_resource(graph, "damage stencil", FRAMEGRAPH_STENCIL, FRAMEGRAPH_IMPORTED);
+    size_t shadows = framegraph_resource(graph, "shadows", FRAMEGRAPH_COLOR, FRAMEGRAPH_IMPORTED);
+    size_t blurs = framegraph_resource(graph, "blurs", FRAMEGRAPH_COLOR, FRAMEGRAPH_IMPORTED);
+
+    size_t pass = framegraph_pass(graph, "shadows", pass_shadows, lists);
+    framegraph_write(graph, pass, shadows);
+
+    if(ps->o.blur_background) {
+        pass = framegraph_pass(graph, "blur", pass_blur, lists);
+        framegraph_write(graph, pass, blurs);
+    }
+
+    pass = framegraph_pass(graph, "setup", pass_setup, lists);
+    framegraph_write(graph, pass, back);
+    framegraph_write(graph, pass, depth);
+    framegraph_write(graph, pass, stencil);
+
+    pass = framegraph_pass(graph, "opaque", pass_opaque, lists);
+    framegraph_read(graph, pass, depth);
+    framegraph_read(graph, pass, stencil);
+    if(any_with(em, lists->opaque, COMPONENT_BLUR))
+        framegraph_read(graph, pass, blurs);
+    framegraph_write(graph, pass, depth);
+    framegraph_write(graph, pass, back);
+
+    pass = framegraph_pass(graph, "root", pass_root, lists);
+    framegraph_read(graph, pass, depth);
+    framegraph_read(graph, pass, stencil);
+    framegraph_write(graph, pass, back);
+
+    pass = framegraph_pass(graph, "transparent", pass_transparent, lists);
+    framegraph_read(graph, pass, depth);
+    framegraph_read(graph, pass, stencil);
+    // The shadow pass also creates the shadows of new windows, so we can't
+    // wait for them to have one
+    if(vector_size(lists->transparent) > 0)
+        framegraph_read(graph, pass, shadows);
+    if(any_with(em, lists->transparent, COMPONENT_BLUR))
+        framegraph_read(graph, pass, blurs);
+    framegraph_write(graph, pass, back);
+
+    pass = framegraph_pass(graph, "finish", pass_finish, lists);
+    framegraph_write(graph, pass, back);
+
+    framegraph_compile(graph);
 }
 
 static void assign_depth(Swiss* em, Vector* order) {
@@ -263,6 +502,7 @@ static bool add_win(session_t *ps, struct AddWin* ev) {
       window->border_size = ev->border_size;
       window->id = ev->xid;
   }
+  winindex_add(&ps->win_index, ev->xid, slot);
 
   ordersystem_add(&ps->order, slot);
 
@@ -294,16 +534,21 @@ restack_win(session_t *ps, struct Restack* ev) {
     }
 
     ordersystem_restack(&ps->order, ev->loc, w_id, above_id);
+    ps->redraw_needed = true;
 }
 
 static void canvas_change(session_t* ps, struct CanvasChange* ev) {
     ps->root_size = ev->size;
+    ps->redraw_needed = true;
 
     glViewport(0, 0, ps->root_size.x, ps->root_size.y);
 
     ps->psglx->view = mat4_orthogonal(0, ps->root_size.x, 0, ps->root_size.y, -.1, 1);
     view = ps->psglx->view;
 
+    // The screen changing size usually means the monitors changed
+    framesched_setPeriod(&ps->frame_sched, xorg_refreshPeriod(&ps->xcontext));
+
     return;
 }
 
@@ -339,11 +584,15 @@ static void destroy_win(session_t *ps, win_id wid) {
     // Immediatly remove the tracked window to make sure that if X reuses the
     // window id we don't mistakenly find this one. We can't use the window id
     // anyway.
+    struct TracksWindowComponent* tracks = swiss_getComponent(&ps->win_list, COMPONENT_TRACKS_WINDOW, wid);
+    winindex_remove(&ps->win_index, tracks->id, wid);
     swiss_removeComponent(&ps->win_list, COMPONENT_TRACKS_WINDOW, wid);
 }
 
 static void
 root_damaged(session_t *ps, struct NewRoot* ev) {
+  ps->redraw_needed = true;
+
   if (ps->root_texture.bound) {
     xtexture_unbind(&ps->root_texture);
   }
@@ -389,11 +638,8 @@ root_damaged(session_t *ps, struct NewRoot* ev) {
 }
 
 static void damage_win(session_t *ps, struct Damage *ev) {
-    // @PERFORMANCE: We are getting a DamageNotify while moving windows, which
-    // means we are damaging the contents (and therefore rebinding the window)
-    // for every move. In most cases, that's completely unnecessary. I don'r
-    // know how to detect if a damage is caused by a move at this time.
-    // - Delusional 16/11-2018
+    // Damage caused by just moving the window is filtered out in xorg.c, so
+    // this is always a change in the contents.
 
     win_id wid = find_win(ps, ev->xid);
 
@@ -534,6 +780,10 @@ get_cfg(session_t *ps, int argc, char *const *argv) {
     { "benchmark", required_argument, NULL, 293 },
     { "glx-use-copysubbuffermesa", no_argument, NULL, 295 },
     { "blur-level", required_argument, NULL, 301 },
+    { "frames-in-flight", required_argument, NULL, 321 },
+    { "gpu-timing", no_argument, NULL, 322 },
+    { "immediate-frames", no_argument, NULL, 323 },
+    { "no-unredir-fullscreen", no_argument, NULL, 324 },
     { "version", no_argument, NULL, 318 },
     // Must terminate with a NULL entry
     { NULL, 0, NULL, 0 },
@@ -635,6 +885,13 @@ get_cfg(session_t *ps, int argc, char *const *argv) {
       P_CASEBOOL(283, blur_background);
       P_CASELONG(293, benchmark);
       P_CASELONG(301, blur_level);
+      P_CASELONG(321, frames_in_flight);
+      P_CASEBOOL(322, gpu_timing);
+      P_CASEBOOL(323, immediate_frames);
+      case 324:
+        // --no-unredir-fullscreen
+        ps->o.unredir_fullscreen = false;
+        break;
       default:
         usage(1);
         break;
@@ -649,6 +906,8 @@ get_cfg(session_t *ps, int argc, char *const *argv) {
 
   // Range checking and option assignments
   ps->o.inactive_dim = clamp_double(ps->o.inactive_dim) * 100;
+  if (ps->o.frames_in_flight < 1 || ps->o.frames_in_flight > FRAMESYNC_MAX_IN_FLIGHT)
+    printf_errfq(1, "Frames in flight must be between 1 and %d", FRAMESYNC_MAX_IN_FLIGHT);
 }
 
 /**
@@ -668,9 +927,111 @@ static void ev_bypass(session_t* ps, struct Bypass* ev) {
     swiss_ensureComponent(&ps->win_list, COMPONENT_BYPASS, wid);
 }
 
+bool session_handleEvent(session_t *ps, struct Event* event) {
+    switch(event->type) {
+        case ET_ADD:
+            zone_enter_extra(&ZONE_one_event, "ADD");
+            add_win(ps, &event->add);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_DESTROY:
+            zone_enter_extra(&ZONE_one_event, "DESTROY");
+            ev_destroy_notify(ps, event->des.xid);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_MAP:
+            zone_enter_extra(&ZONE_one_event, "MAP");
+            map_win(ps, &event->map);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_UNMAP:
+            zone_enter_extra(&ZONE_one_event, "UNMAP");
+            ev_unmap_notify(ps, &event->unmap);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_BYPASS:
+            zone_enter_extra(&ZONE_one_event, "BYPASS");
+            ev_bypass(ps, &event->bypass);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_CLIENT:
+            zone_enter_extra(&ZONE_one_event, "CLIENT");
+            getsclient(ps, &event->cli);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_CCHANGE:
+            zone_enter_extra(&ZONE_one_event, "CCHANGE");
+            canvas_change(ps, &event->cchange);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_MANDR:
+            zone_enter_extra(&ZONE_one_event, "MANDR");
+            configure_win(ps, &event->mandr);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_RESTACK:
+            zone_enter_extra(&ZONE_one_event, "RESTACK");
+            restack_win(ps, &event->restack);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_FOCUS:
+            zone_enter_extra(&ZONE_one_event, "FOCUS");
+            set_active_window(ps, &event->focus);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_NEWROOT:
+            zone_enter_extra(&ZONE_one_event, "NEWROOT");
+            root_damaged(ps, &event->newRoot);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_WINTYPE:
+            zone_enter_extra(&ZONE_one_event, "WINTYPE");
+            swiss_ensureComponent(&ps->win_list, COMPONENT_WINTYPE_CHANGE, find_win(ps, event->wintype.xid));
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_WINCLASS:
+            zone_enter_extra(&ZONE_one_event, "WINCLASS");
+            swiss_ensureComponent(&ps->win_list, COMPONENT_CLASS_CHANGE, find_win(ps, event->wintype.xid));
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_DAMAGE:
+            zone_enter_extra(&ZONE_one_event, "DAMAGE");
+            damage_win(ps, &event->damage);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_SHAPE:
+            zone_enter_extra(&ZONE_one_event, "SHAPE");
+            ev_shape_notify(ps, &event->shape);
+            zone_leave(&ZONE_one_event);
+            break;
+        case ET_NONE:
+            zone_enter_extra(&ZONE_one_event, "NONE");
+            zone_leave(&ZONE_one_event);
+            return false;
+        default:
+            printf_errf("Unknown event type, ignoring");
+    }
+    return true;
+}
+
 /**
  * Main loop.
  */
+// Handle all the events we have without blocking. Returns true if we handled
+// anything.
+static bool drainEvents(session_t *ps) {
+    bool processed = false;
+    while(true) {
+        struct Event event;
+
+        // This doesn't block.
+        xorg_nextEvent(&ps->xcontext, &event);
+        if(!session_handleEvent(ps, &event))
+            return processed;
+        processed = true;
+    }
+}
+
 static bool pumpEvents(session_t *ps) {
     while(true) {
         // This might be called multiple times per frame, but only if we did
@@ -678,115 +1039,7 @@ static bool pumpEvents(session_t *ps) {
         zone_render();
 
         // Process existing events
-        bool done = false;
-        bool processed = false;
-        while(!done) {
-            struct Event event;
-
-            // This doesn't block.
-            xorg_nextEvent(&ps->xcontext, &event);
-            switch(event.type) {
-                case ET_ADD:
-                    zone_enter_extra(&ZONE_one_event, "ADD");
-                    processed = true;
-                    add_win(ps, &event.add);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_DESTROY:
-                    zone_enter_extra(&ZONE_one_event, "DESTROY");
-                    processed = true;
-                    ev_destroy_notify(ps, event.des.xid);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_MAP:
-                    zone_enter_extra(&ZONE_one_event, "MAP");
-                    processed = true;
-                    map_win(ps, &event.map);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_UNMAP:
-                    zone_enter_extra(&ZONE_one_event, "UNMAP");
-                    processed = true;
-                    ev_unmap_notify(ps, &event.unmap);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_BYPASS:
-                    zone_enter_extra(&ZONE_one_event, "BYPASS");
-                    processed = true;
-                    ev_bypass(ps, &event.bypass);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_CLIENT:
-                    zone_enter_extra(&ZONE_one_event, "CLIENT");
-                    processed = true;
-                    getsclient(ps, &event.cli);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_CCHANGE:
-                    zone_enter_extra(&ZONE_one_event, "CCHANGE");
-                    processed = true;
-                    canvas_change(ps, &event.cchange);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_MANDR:
-                    zone_enter_extra(&ZONE_one_event, "MANDR");
-                    processed = true;
-                    configure_win(ps, &event.mandr);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_RESTACK:
-                    zone_enter_extra(&ZONE_one_event, "RESTACK");
-                    processed = true;
-                    restack_win(ps, &event.restack);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_FOCUS:
-                    zone_enter_extra(&ZONE_one_event, "FOCUS");
-                    processed = true;
-                    set_active_window(ps, &event.focus);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_NEWROOT:
-                    zone_enter_extra(&ZONE_one_event, "NEWROOT");
-                    processed = true;
-                    root_damaged(ps, &event.newRoot);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_WINTYPE:
-                    zone_enter_extra(&ZONE_one_event, "WINTYPE");
-                    processed = true;
-                    swiss_ensureComponent(&ps->win_list, COMPONENT_WINTYPE_CHANGE, find_win(ps, event.wintype.xid));
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_WINCLASS:
-                    zone_enter_extra(&ZONE_one_event, "WINCLASS");
-                    processed = true;
-                    swiss_ensureComponent(&ps->win_list, COMPONENT_CLASS_CHANGE, find_win(ps, event.wintype.xid));
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_DAMAGE:
-                    zone_enter_extra(&ZONE_one_event, "DAMAGE");
-                    processed = true;
-                    damage_win(ps, &event.damage);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_SHAPE:
-                    zone_enter_extra(&ZONE_one_event, "SHAPE");
-                    processed = true;
-                    ev_shape_notify(ps, &event.shape);
-                    zone_leave(&ZONE_one_event);
-                    break;
-                case ET_NONE:
-                    zone_enter_extra(&ZONE_one_event, "NONE");
-                    done = true;
-                    zone_leave(&ZONE_one_event);
-                    break;
-                default:
-                    printf_errf("Unknown event type, ignoring");
-            }
-        }
-
-        if(processed) {
+        if(drainEvents(ps)) {
             return false;
         }
 
@@ -798,13 +1051,9 @@ static bool pumpEvents(session_t *ps) {
             return false;
         }
 
-        // This is where we block if we don't have any events to handle
-
-        // Calculate timeout
-        time_ms_t tmout_ms = TIME_MS_MAX;
-        struct timeval tv;
-        tv = ms_to_tv(tmout_ms);
-
+        // This is where we block if we don't have any events to handle.
+        // Nothing is animating, so there's no reason to wake up before X has
+        // something for us.
         {
             zone_scope(&ZONE_sleep);
 
@@ -815,13 +1064,49 @@ static bool pumpEvents(session_t *ps) {
             } else {
                 FD_ZERO(&read);
             }
-            select(ps->nfds_max, &read, NULL, NULL, &tv);
+            select(ps->nfds_max, &read, NULL, NULL, NULL);
         }
     }
 
     return false;
 }
 
+// Sleep until the scheduler wants us to start painting. Events arriving in
+// the meantime are handled right away, so they make it into the frame.
+static void waitForFrame(session_t *ps) {
+    zone_scope(&ZONE_frame_wait);
+
+    timestamp now;
+    getTime(&now);
+    uint64_t deadline = framesched_deadline(&ps->frame_sched, timeInMicros(&now));
+
+    while(!ps->reset) {
+        drainEvents(ps);
+
+        getTime(&now);
+        uint64_t nowUs = timeInMicros(&now);
+        if(nowUs >= deadline)
+            break;
+
+        uint64_t left = deadline - nowUs;
+        struct timeval tv = {
+            .tv_sec = left / US_PER_SEC,
+            .tv_usec = left % US_PER_SEC,
+        };
+
+        fd_set read;
+        if(ps->pfds_read) {
+            memcpy(&read, ps->pfds_read, sizeof(fd_set));
+        } else {
+            FD_ZERO(&read);
+        }
+        select(ps->nfds_max, &read, NULL, NULL, &tv);
+    }
+
+    getTime(&now);
+    framesched_begin(&ps->frame_sched, timeInMicros(&now));
+}
+
 /**
  * Initialize a session.
  *
@@ -845,6 +1130,10 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
       .config_file = NULL,
       .blur_level = 0,
       .benchmark = 0,
+      .frames_in_flight = 1,
+      .gpu_timing = false,
+      .immediate_frames = false,
+      .unredir_fullscreen = true,
 
       .wintype_opacity = { -1.0 },
       .inactive_opacity = 100.0,
@@ -865,6 +1154,7 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
 
     .time_start = { 0, 0 },
     .idling = false,
+    .redraw_needed = true,
     .reset = false,
 
     .win_list = {0},
@@ -920,12 +1210,18 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
   swiss_disableAutoRemove(&ps->win_list, COMPONENT_SHAPED);
   swiss_setComponentSize(&ps->win_list, COMPONENT_SHAPE_DAMAGED, sizeof(struct ShapeDamagedEvent));
   swiss_disableAutoRemove(&ps->win_list, COMPONENT_SHAPE_DAMAGED);
+  swiss_setComponentSize(&ps->win_list, COMPONENT_DAMAGED_REGION, sizeof(struct DamagedRegionComponent));
+  swiss_disableAutoRemove(&ps->win_list, COMPONENT_DAMAGED_REGION);
   swiss_setComponentSize(&ps->win_list, COMPONENT_STATEFUL, sizeof(struct StatefulComponent));
   swiss_setComponentSize(&ps->win_list, COMPONENT_TRANSITIONING, sizeof(struct TransitioningComponent));
 
   swiss_setComponentSize(&ps->win_list, COMPONENT_DEBUGGED, sizeof(struct DebuggedComponent));
   swiss_init(&ps->win_list, 512);
 
+  // The startup gets its own stream, which is emitted as the first frame once
+  // the profiler writer is up
+  zone_start(&ZONE_startup);
+
   // Inherit old Display if possible, primarily for resource leak checking
   if (ps_old && ps_old->dpy)
     ps->dpy = ps_old->dpy;
@@ -962,10 +1258,12 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
   }};
 
   // Also initializes the atoms
+  zone_enter(&ZONE_startup_xorg);
   if(!xorgContext_init(&ps->xcontext, ps->dpy, ps->scr, &ps->atoms)) {
     printf_errf("Failed initializing the xorg context");
     exit(1);
   }
+  zone_leave(&ZONE_startup_xorg);
 
   // Overlay must be initialized before double buffer, and before creation
   // of OpenGL context.
@@ -1002,8 +1300,34 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
   add_xdg_asset_paths();
 
   // Initialize OpenGL as early as possible
+  zone_enter(&ZONE_startup_glx);
   if (!glx_init(ps))
     exit(1);
+  // The context is fresh, nothing we might have assumed about it holds
+  glstate_invalidate();
+  {
+      char* cache_dir = xdg_cache_path("neocomp/shaders");
+      shadercache_init(cache_dir);
+      free(cache_dir);
+  }
+  framesync_init(&ps->frame_sync, ps->o.frames_in_flight, ps->o.gpu_timing);
+  // 256KiB fits thousands of windows for every frame in flight, and is well
+  // below the smallest buffer texture GL allows
+  if(ringbuffer_init(&ps->stream, 256 * 1024, ps->o.frames_in_flight,
+              glx_hasglext(ps, "GL_ARB_buffer_storage")) != 0) {
+      printf_errf("Failed initializing the stream buffer");
+  }
+  framegraph_init(&ps->frame_graph);
+  zone_leave(&ZONE_startup_glx);
+
+  // We don't wait for the programs here, that happens when they are first
+  // used
+  zone_enter(&ZONE_startup_shaders);
+  for(size_t i = 0; i < sizeof(STARTUP_PROGRAMS) / sizeof(STARTUP_PROGRAMS[0]); i++) {
+      if(assets_load(STARTUP_PROGRAMS[i]) == NULL)
+          printf_errf("Failed loading %s", STARTUP_PROGRAMS[i]);
+  }
+  zone_leave(&ZONE_startup_shaders);
 
   if(xorgContext_ensure_capabilities(&ps->xcontext.capabilities)) {
       printf_errf("One of the required X extensions were missing");
@@ -1013,7 +1337,7 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
   // Initialize VSync
   {
       // Check if we have the vsync extension
-      if(!glx_hasglext(ps, "EXT_swap_control")) {
+      if(!glx_hasglxext(ps, "GLX_EXT_swap_control")) {
           printf_errf("No swap control extension, can't set the swap inteval. Expect no vsync");
           exit(1);
       }
@@ -1030,6 +1354,9 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
       ps->psglx->glXSwapIntervalProc(ps->xcontext.display, glXGetCurrentDrawable(), 1);
   }
 
+  framesched_init(&ps->frame_sched, ps->dpy, glXGetCurrentDrawable(), ps->psglx->glXGetSyncValuesOML,
+          xorg_refreshPeriod(&ps->xcontext));
+
   char* debug_font_loc = assets_resolve_path("Roboto-Light.ttf");
   if(debug_font_loc != NULL) {
       text_debug_load(debug_font_loc);
@@ -1042,8 +1369,12 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
 
   // Initialize filters, must be preceded by OpenGL context creation
   ordersystem_init(&ps->order);
+  winindex_init(&ps->win_index);
   blursystem_init();
   texturesystem_init();
+  windowlist_init(&ps->stream);
+  renderutil_init(&ps->stream);
+  damagesystem_init(&ps->damage);
   glx_check_err(ps);
   xtexture_init(&ps->root_texture, &ps->xcontext);
 
@@ -1056,7 +1387,9 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
   // We must call XSync here to ensure the window has gotten mapped
   XSync(ps->dpy, False);
 
+  zone_enter(&ZONE_startup_scan);
   xorg_beginEvents(&ps->xcontext);
+  zone_leave(&ZONE_startup_scan);
 
   {
       int fd = ConnectionNumber(ps->xcontext.display);
@@ -1132,9 +1465,13 @@ void session_destroy(session_t *ps) {
   }
   swiss_resetComponent(&ps->win_list, COMPONENT_BINDS_TEXTURE);
   ordersystem_delete(&ps->order);
+  winindex_delete(&ps->win_index);
   shadowsystem_delete(&ps->win_list);
   blursystem_delete(&ps->win_list);
   texturesystem_delete();
+  windowlist_delete();
+  renderutil_delete();
+  damagesystem_delete(&ps->damage);
   shapesystem_delete(&ps->win_list);
 
   // Free tracked atom list
@@ -1147,6 +1484,10 @@ void session_destroy(session_t *ps) {
 
   xorgContext_delete(&ps->xcontext);
 
+  framegraph_delete(&ps->frame_graph);
+  ringbuffer_delete(&ps->stream);
+  framesync_delete(&ps->frame_sync);
+  shadercache_delete();
   glx_destroy(ps);
 
   swiss_kill(&ps->win_list);
@@ -1231,25 +1572,25 @@ bool do_win_fade(struct Bezier* curve, double dt, Swiss* em) {
 
                     struct FadeKeyframe* keyframe = &fade->keyframes[i];
                     if(!keyframe->ignore){
-                        keyframe->time += dt;
+            keyframe->time += dt;
                     } else {
-                        keyframe->ignore = false;
+            keyframe->ignore = false;
                     }
 
                     double time = fmax(keyframe->time - keyframe->lead, 0);
                     double x = time / (keyframe->duration - keyframe->lead);
                     if(x >= 1.0) {
-                        // We're done, clean out the time and set this as the head
-                        keyframe->time = 0.0;
-                        keyframe->duration = -1;
-                        fade->head = i;
-
-                        // Force the value. We are still going to blend it with stuff
-                        // on top of this
-                        fade->value = keyframe->target;
+            // We're done, clean out the time and set this as the head
+            keyframe->time = 0.0;
+            keyframe->duration = -1;
+            fade->head = i;
+
+            // Force the value. We are still going to blend it with stuff
+            // on top of this
+            fade->value = keyframe->target;
                     } else {
-                        double t = bezier_getSplineValue(curve, x);
-                        fade->value = lerp(fade->value, keyframe->target, t);
+            double t = bezier_getSplineValue(curve, x);
+            fade->value = lerp(fade->value, keyframe->target, t);
                     }
                 }
 
@@ -1385,6 +1726,56 @@ static void fetchSortedWindowsWithArr(Swiss* em, Vector* result, CType* query) {
 #define fetchSortedWindowsWith(em, result, ...) \
     fetchSortedWindowsWithArr(em, result, (CType[]){ __VA_ARGS__ })
 
+// Does anything on screen change this frame? If not, we can skip painting and
+// sleep until X tells us something happened.
+static bool frame_needed(session_t* ps) {
+#if defined(FRAMERATE_DISPLAY) || defined(DEBUG_WINDOWS)
+    // The debug overlays change every frame
+    return true;
+#endif
+
+    if(ps->o.benchmark)
+        return true;
+
+    // X is drawing a fullscreen window straight to the screen, none of what
+    // we would paint is visible
+    struct SwissIterator fullscreen = swiss_getFirstInit(&ps->win_list, (CType[]){COMPONENT_UNREDIRECTED, CQ_END});
+    if(!fullscreen.done)
+        return false;
+
+    // Something is fading
+    if(ps->skip_poll)
+        return true;
+
+    if(ps->redraw_needed)
+        return true;
+
+    // The blur and shadow damage is derived from these, so we don't have to
+    // look at it. A resize is kept around until the window gets a physical
+    // size, it's only visible once it has one.
+    const CType* messages[] = {
+        (CType[]){COMPONENT_NEW, CQ_END},
+        (CType[]){COMPONENT_MAP, CQ_END},
+        (CType[]){COMPONENT_UNMAP, CQ_END},
+        (CType[]){COMPONENT_BYPASS, CQ_END},
+        (CType[]){COMPONENT_MOVE, CQ_END},
+        (CType[]){COMPONENT_RESIZE, COMPONENT_PHYSICAL, CQ_END},
+        (CType[]){COMPONENT_CONTENTS_DAMAGED, CQ_END},
+        (CType[]){COMPONENT_SHAPE_DAMAGED, CQ_END},
+        (CType[]){COMPONENT_FOCUS_CHANGE, CQ_END},
+        (CType[]){COMPONENT_WINTYPE_CHANGE, CQ_END},
+        (CType[]){COMPONENT_CLASS_CHANGE, CQ_END},
+        (CType[]){COMPONENT_TRANSITIONING, CQ_END},
+    };
+    for(size_t i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+        struct SwissIterator it = swiss_getFirstInit(&ps->win_list, messages[i]);
+        if(!it.done)
+            return true;
+    }
+
+    return false;
+}
+
 /**
  * Do the actual work.
  *
@@ -1394,6 +1785,7 @@ void session_run(session_t *ps) {
 #ifdef DEBUG_PROFILE
     struct ProfilerWriterSession profSess;
     profilerWriter_init(&profSess);
+    profilerWriter_emitFrame(&profSess, zone_package(&ZONE_startup));
 #endif
 
     timestamp lastTime;
@@ -1419,6 +1811,14 @@ void session_run(session_t *ps) {
 
         pumpEvents(ps);
 
+        if(!ps->o.immediate_frames && !ps->o.benchmark) {
+            waitForFrame(ps);
+        } else {
+            timestamp start;
+            getTime(&start);
+            framesched_begin(&ps->frame_sched, timeInMicros(&start));
+        }
+
         assets_hotload();
 
         Swiss* em = &ps->win_list;
@@ -1439,9 +1839,6 @@ void session_run(session_t *ps) {
 
         ps->skip_poll = false;
 
-        // idling will be turned off later if desired.
-        ps->idling = true;
-
         zone_enter(&ZONE_preprocess);
 
         shapesystem_updateShapes(em, &ps->xcontext);
@@ -1468,7 +1865,7 @@ void session_run(session_t *ps) {
         zone_enter(&ZONE_input_react);
         statesystem_tick(&ps->win_list);
         commit_map(&ps->win_list, &ps->atoms, &ps->xcontext);
-        xorgsystem_tick(&ps->win_list, &ps->xcontext, &ps->atoms, &ps->root_size);
+        xorgsystem_tick(&ps->win_list, &ps->xcontext, &ps->atoms);
         physics_tick(&ps->win_list);
         zone_leave(&ZONE_input_react);
 
@@ -1497,13 +1894,20 @@ void session_run(session_t *ps) {
             struct TransitioningComponent* t = swiss_getComponent(em, COMPONENT_TRANSITIONING, it.id);
             t->time += dt;
 
-            if(t->time >= t->duration)
+            if(t->time >= t->duration) {
                 swiss_removeComponent(em, COMPONENT_TRANSITIONING, it.id);
+            } else {
+                // We have to keep ticking until the transition is done
+                ps->skip_poll = true;
+            }
         }
 
         zone_leave(&ZONE_update_fade);
 
         transition_faded_entities(&ps->win_list);
+        // Has to run after the fades and the physics have settled, since
+        // they decide if the top window can be unredirected
+        xorgsystem_updateRedirection(&ps->win_list, &ps->xcontext, &ps->order.order, &ps->root_size, ps->o.unredir_fullscreen);
         texturesystem_tick(&ps->win_list, &ps->xcontext);
         shadowsystem_tick(em);
         ordersystem_tick(&ps->win_list, &ps->order);
@@ -1513,74 +1917,91 @@ void session_run(session_t *ps) {
 
         zone_leave(&ZONE_update);
 
-        Vector opaque;
-        vector_init(&opaque, sizeof(win_id), ps->order.order.size);
-        fetchSortedWindowsWith(&ps->win_list, &opaque,
-                COMPONENT_MUD, COMPONENT_TEXTURED, CQ_NOT, COMPONENT_BGOPACITY, COMPONENT_PHYSICAL, CQ_END);
-
-        Vector transparent;
-        vector_init(&transparent, sizeof(win_id), ps->order.order.size);
-        // Even non-opaque windows have some transparent elements (shadow).
-        // Trying to draw something as transparent when it only has opaque
-        // elements isn't a problem, so we just include everything.
-        fetchSortedWindowsWith(&ps->win_list, &transparent,
-                COMPONENT_MUD, COMPONENT_TEXTURED, /* COMPONENT_OPACITY, */ COMPONENT_PHYSICAL, CQ_END);
-
-        Vector opaque_shadow;
-        vector_init(&opaque_shadow, sizeof(win_id), ps->order.order.size);
-        fetchSortedWindowsWith(&ps->win_list, &opaque_shadow,
-                COMPONENT_MUD, COMPONENT_Z, COMPONENT_PHYSICAL, CQ_NOT, COMPONENT_OPACITY, COMPONENT_SHADOW, CQ_END);
-
-        zone_enter(&ZONE_effect_textures);
-
-        shadowsystem_updateShadow(ps, &transparent);
-
-        if(ps->o.blur_background)
-            blursystem_updateBlur(&ps->win_list, &ps->root_size, &ps->root_texture.texture, ps->o.blur_level, &opaque, &transparent, ps);
-
-        zone_leave(&ZONE_effect_textures);
-
-        {
-            static int paint = 0;
-
-            zone_enter(&ZONE_paint);
-
-            glDepthMask(GL_TRUE);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            static const GLenum DRAWBUFS[2] = { GL_BACK_LEFT };
-            glDrawBuffers(1, DRAWBUFS);
-            glViewport(0, 0, ps->root_size.x, ps->root_size.y);
-
-            glClearDepth(1.0);
-            glClear(GL_DEPTH_BUFFER_BIT);
-            glDepthFunc(GL_LESS);
-
-            windowlist_drawBackground(ps, &opaque);
-            windowlist_drawTint(ps);
-            windowlist_draw(ps, &opaque);
+        // X paints the screen while a window is unredirected, so none of our
+        // buffers are current when we take over again
+        if(!swiss_getFirstInit(&ps->win_list, (CType[]){COMPONENT_UNREDIRECTED, CQ_END}).done)
+            ps->redraw_needed = true;
+
+        ps->idling = !frame_needed(ps);
+        if(!ps->idling) {
+            Vector opaque;
+            vector_init(&opaque, sizeof(win_id), ps->order.order.size);
+            fetchSortedWindowsWith(&ps->win_list, &opaque,
+                    COMPONENT_MUD, COMPONENT_TEXTURED, CQ_NOT, COMPONENT_BGOPACITY, COMPONENT_PHYSICAL, CQ_END);
+
+            Vector transparent;
+            vector_init(&transparent, sizeof(win_id), ps->order.order.size);
+            // Even non-opaque windows have some transparent elements (shadow).
+            // Trying to draw something as transparent when it only has opaque
+            // elements isn't a problem, so we just include everything.
+            fetchSortedWindowsWith(&ps->win_list, &transparent,
+                    COMPONENT_MUD, COMPONENT_TEXTURED, /* COMPONENT_OPACITY, */ COMPONENT_PHYSICAL, CQ_END);
+
+            Vector opaque_shadow;
+            vector_init(&opaque_shadow, sizeof(win_id), ps->order.order.size);
+            fetchSortedWindowsWith(&ps->win_list, &opaque_shadow,
+                    COMPONENT_MUD, COMPONENT_Z, COMPONENT_PHYSICAL, CQ_NOT, COMPONENT_OPACITY, COMPONENT_SHADOW, CQ_END);
+
+            // Don't queue up more than the allowed frames on the GPU. All the
+            // event handling and updating above overlaps with the GPU
+            // finishing the earlier frames.
+            timestamp throttle;
+            getTime(&throttle);
+            framesched_pause(&ps->frame_sched, timeInMicros(&throttle));
+            framesync_throttle(&ps->frame_sync);
+            getTime(&throttle);
+            framesched_resume(&ps->frame_sched, timeInMicros(&throttle));
+            ringbuffer_beginFrame(&ps->stream, ps->frame_sync.cursor);
+
+            // Anything hidden behind the opaque windows is dropped from the
+            // lists, and its shadow and blur are left damaged until it shows
+            occlusionsystem_tick(&ps->win_list, &ps->root_size, &opaque, &transparent);
+
+            // Nothing consumes the blur damage when we don't blur
+            if(!ps->o.blur_background)
+                swiss_resetComponent(&ps->win_list, COMPONENT_BLUR_DAMAGED);
+
+            // Has to see the damage before the effects consume it
+#if defined(FRAMERATE_DISPLAY) || defined(DEBUG_WINDOWS)
+            // The debug overlays are drawn on top of everything
+            damagesystem_tick(&ps->win_list, &ps->damage, &transparent, true);
+#else
+            damagesystem_tick(&ps->win_list, &ps->damage, &transparent, ps->redraw_needed);
+#endif
 
-            paint_root(ps);
+            {
+                static int paint = 0;
 
-            windowlist_drawTransparent(ps, &transparent);
+                zone_enter(&ZONE_paint);
 
-#ifdef DEBUG_WINDOWS
-            draw_component_debug(&ps->win_list, &ps->root_size);
+                struct FrameLists lists = {
+                    .ps = ps,
+                    .opaque = &opaque,
+                    .transparent = &transparent,
+                };
+                build_frame_graph(&ps->frame_graph, &lists);
+#ifdef DEBUG_FRAMEGRAPH
+                framegraph_dump(&ps->frame_graph, stdout);
 #endif
+                framegraph_execute(&ps->frame_graph);
 
-            vector_kill(&opaque_shadow);
-            vector_kill(&transparent);
-            vector_kill(&opaque);
+                vector_kill(&opaque_shadow);
+                vector_kill(&transparent);
+                vector_kill(&opaque);
 
-            zone_leave(&ZONE_paint);
+                zone_leave(&ZONE_paint);
 
-            paint++;
-            if (ps->o.benchmark && paint >= ps->o.benchmark) {
+                paint++;
+                if (ps->o.benchmark && paint >= ps->o.benchmark) {
 #ifdef DEBUG_PROFILE
-                profilerWriter_kill(&profSess);
+                    profilerWriter_kill(&profSess);
 #endif
-                session_destroy(ps);
-                exit(0);
+                    session_destroy(ps);
+                    exit(0);
+                }
             }
+
+            ps->redraw_needed = false;
         }
 
         zone_enter(&ZONE_remove_input);
@@ -1612,6 +2033,11 @@ void session_run(session_t *ps) {
 
         zone_leave(&ZONE_remove_input);
 
+        for_components(it, em, COMPONENT_DAMAGED_REGION, CQ_END) {
+            struct DamagedRegionComponent* region = swiss_getComponent(em, COMPONENT_DAMAGED_REGION, it.id);
+            vector_kill(&region->rects);
+        }
+        swiss_resetComponent(&ps->win_list, COMPONENT_DAMAGED_REGION);
         swiss_resetComponent(&ps->win_list, COMPONENT_CONTENTS_DAMAGED);
 
         struct ZoneEventStream* event_stream = zone_package(&ZONE_global);
@@ -1626,8 +2052,14 @@ void session_run(session_t *ps) {
         profilerWriter_emitFrame(&profSess, event_stream);
 #endif
 
-        glXSwapBuffers(ps->dpy, ps->overlay);
-        glFinish();
+        if(!ps->idling) {
+            present_frame(ps);
+            framesync_submit(&ps->frame_sync);
+
+            timestamp submitted;
+            getTime(&submitted);
+            framesched_end(&ps->frame_sched, timeInMicros(&submitted));
+        }
 
         lastTime = currentTime;
     }
@@ -31,3 +31,6 @@ void session_destroy(session_t *ps);
 
 
 void session_run(session_t *ps);
+// Run the handler for a single event from xorg_nextEvent. Returns false for
+// ET_NONE, when there are no more events.
+bool session_handleEvent(session_t *ps, struct Event* event);
@@ -1,5 +1,6 @@
 #include "debug.h"
 
+#include "glstate.h"
 #include "renderutil.h"
 #include "text.h"
 #include "window.h"
@@ -37,6 +38,8 @@ char *component_names[NUM_COMPONENT_TYPES] = {
     "[Dim]",
     "[Fades Dim]",
     "[Redirected]",
+    "[Unredirected]",
+    "[Occluded]",
     "[Shaped]",
     "[Stateful]",
     "[Debugged]",
@@ -51,6 +54,7 @@ char *component_names[NUM_COMPONENT_TYPES] = {
     "[Resize]",
     "[Blur Damaged]",
     "[Content Damaged]",
+    "[Damaged Region]",
     "[Shadow Damaged]",
     "[Shape Damaged]",
     "[Focus Changed]",
@@ -635,6 +639,7 @@ void draw_debug_graph(struct DebugGraphState* state, Vector2* pos) {
     winSize.y += bigSize.y;
     winSize.y += smallSize.y;
     winSize.y += smallSize.y;
+    winSize.y += smallSize.y;
     winSize.y += smallSize.y * vector_size(&state->xdata.values);
 
 
@@ -647,9 +652,9 @@ void draw_debug_graph(struct DebugGraphState* state, Vector2* pos) {
     Vector4 bgColor = {{.1, .1, .1, .5}};
     struct face* face = assets_load("window.face");
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glDepthMask(GL_FALSE);
+    glstate_disable(GL_DEPTH_TEST);
+    glstate_enable(GL_BLEND);
+    glstate_depthMask(GL_FALSE);
 
     Vector3 winBorderPos = {{winPos.x - 5, winPos.y - 5, winPos.z}};
     Vector2 winExtents = {{winSize.x + 10, winSize.y + 10}};
@@ -738,6 +743,26 @@ void draw_debug_graph(struct DebugGraphState* state, Vector2* pos) {
     }
     pen.y -= smallSize.y;
 
+    {
+        char* buffer = "GL calls";
+
+        text_size(&debug_font, buffer, &scale, &size);
+        Vector2 tpos = {{pen.x, pen.y - size.y}};
+
+        text_draw_colored(&debug_font, buffer, &tpos, &scale, &(Vector3){{1.0, 1.0, 1.0}});
+    }
+
+    {
+        static char buffer[128];
+        snprintf(buffer, 128, "%zu | %zu", state->glCalls.issued, state->glCalls.skipped);
+
+        text_size(&debug_font, buffer, &scale, &size);
+        Vector2 tpos = {{winPos.x + winSize.x - size.x, pen.y - size.y}};
+
+        text_draw_colored(&debug_font, buffer, &tpos, &scale, &(Vector3){{1.0, 1.0, 1.0}});
+    }
+    pen.y -= smallSize.y;
+
     for(size_t i = 0; i < vector_size(&state->xdata.values); i++) {
         char* buffer = state->xdata.names[i];
 
@@ -782,7 +807,7 @@ void draw_debug_graph(struct DebugGraphState* state, Vector2* pos) {
     texture_bind(&state->tex[1], GL_TEXTURE0);
     draw_rect(face, type->mvp, graphPos, bigSize);
 
-    glDisable(GL_BLEND);
+    glstate_disable(GL_BLEND);
 }
 
 static int draws = 0;
@@ -820,6 +845,7 @@ void update_debug_graph(struct DebugGraphState* state, struct ZoneEventStream* s
 
     state->windows = swiss_size(win_list);
     state->fragmentation = swiss_count_holes(win_list);
+    glstate_takeCounts(&state->glCalls);
 
     state->cursor++;
     if(state->cursor >= state->width)
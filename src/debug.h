@@ -10,6 +10,7 @@
 
 #include "texture.h"
 #include "buffer.h"
+#include "glstate.h"
 
 #include "xorg.h"
 
@@ -29,6 +30,8 @@ struct DebugGraphState {
 
 	size_t windows;
 	size_t fragmentation;
+    // GL state changes sent to the driver and skipped as redundant
+    struct GLStateCounts glCalls;
 
     struct XResourceUsage xdata;
 };
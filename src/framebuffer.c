@@ -1,5 +1,7 @@
 #include "framebuffer.h"
 
+#include "glstate.h"
+
 #include <stdio.h>
 #include <assert.h>
 
@@ -59,7 +61,7 @@ void framebuffer_targetBack(struct Framebuffer* framebuffer) {
 }
 
 int framebuffer_bind(struct Framebuffer* framebuffer) {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer->gl_fbo);
+    glstate_bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer->gl_fbo);
 
     if(framebuffer->target == 0)
         return 0;
@@ -97,12 +99,13 @@ int framebuffer_rebind(struct Framebuffer* framebuffer) {
 }
 
 int framebuffer_bind_read(struct Framebuffer* framebuffer) {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->gl_fbo);
+    glstate_bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->gl_fbo);
     return 0;
 }
 
 void framebuffer_delete(struct Framebuffer* framebuffer) {
     glDeleteFramebuffers(1, &framebuffer->gl_fbo);
+    glstate_forgetFramebuffer(framebuffer->gl_fbo);
     framebuffer_resetTarget(framebuffer);
     framebuffer->gl_fbo = 0;
 }
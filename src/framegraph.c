@@ -0,0 +1,250 @@
+#include "framegraph.h"
+
+#include "logging.h"
+#include "profiler/zone.h"
+
+#include <assert.h>
+
+DECLARE_ZONE(frame_graph_pass);
+
+void framegraph_init(struct FrameGraph* graph) {
+    graph->numPool = 0;
+    framegraph_begin(graph);
+}
+
+void framegraph_delete(struct FrameGraph* graph) {
+    for(size_t i = 0; i < graph->numPool; i++) {
+        if(texture_initialized(&graph->pool[i]))
+            texture_delete(&graph->pool[i]);
+    }
+    graph->numPool = 0;
+}
+
+void framegraph_begin(struct FrameGraph* graph) {
+    graph->numResources = 0;
+    graph->numPasses = 0;
+}
+
+size_t framegraph_resource(struct FrameGraph* graph, const char* name,
+        enum FrameGraphResourceType type, enum FrameGraphLifetime lifetime) {
+    assert(graph->numResources < FRAMEGRAPH_MAX_RESOURCES);
+
+    size_t index = graph->numResources++;
+    struct FrameGraphResource* resource = &graph->resources[index];
+    resource->name = name;
+    resource->type = type;
+    resource->lifetime = lifetime;
+    resource->size = (Vector2){{0, 0}};
+    resource->firstUse = -1;
+    resource->lastUse = -1;
+    resource->slot = -1;
+    return index;
+}
+
+size_t framegraph_transient(struct FrameGraph* graph, const char* name, const Vector2* size) {
+    size_t index = framegraph_resource(graph, name, FRAMEGRAPH_COLOR, FRAMEGRAPH_TRANSIENT);
+    graph->resources[index].size = *size;
+    return index;
+}
+
+size_t framegraph_pass(struct FrameGraph* graph, const char* name,
+        framegraph_execute_fn execute, void* userdata) {
+    assert(graph->numPasses < FRAMEGRAPH_MAX_PASSES);
+
+    size_t index = graph->numPasses++;
+    struct FrameGraphPass* pass = &graph->passes[index];
+    pass->name = name;
+    pass->execute = execute;
+    pass->userdata = userdata;
+    pass->reads = 0;
+    pass->writes = 0;
+    pass->culled = false;
+    pass->barriers = 0;
+    return index;
+}
+
+void framegraph_read(struct FrameGraph* graph, size_t pass, size_t resource) {
+    assert(pass < graph->numPasses);
+    assert(resource < graph->numResources);
+    graph->passes[pass].reads |= 1u << resource;
+}
+
+void framegraph_write(struct FrameGraph* graph, size_t pass, size_t resource) {
+    assert(pass < graph->numPasses);
+    assert(resource < graph->numResources);
+    graph->passes[pass].writes |= 1u << resource;
+}
+
+static void cull_passes(struct FrameGraph* graph) {
+    uint32_t needed = 0;
+    for(size_t i = 0; i < graph->numResources; i++) {
+        if(graph->resources[i].lifetime == FRAMEGRAPH_OUTPUT)
+            needed |= 1u << i;
+    }
+
+    // Walking backwards we know everything the later passes read. A pass
+    // that writes none of it does nothing anyone sees.
+    for(size_t i = graph->numPasses; i-- > 0;) {
+        struct FrameGraphPass* pass = &graph->passes[i];
+        pass->culled = (pass->writes & needed) == 0;
+        if(!pass->culled)
+            needed |= pass->reads;
+    }
+}
+
+static void find_lifetimes(struct FrameGraph* graph) {
+    uint32_t written = 0;
+    for(size_t i = 0; i < graph->numPasses; i++) {
+        struct FrameGraphPass* pass = &graph->passes[i];
+        if(pass->culled)
+            continue;
+
+        // GL already orders rendering to a texture before sampling it in a
+        // later draw, so these are only for the dump. A pass sampling what
+        // it renders to would need a texture barrier.
+        pass->barriers = pass->reads & written;
+        written |= pass->writes;
+
+        uint32_t used = pass->reads | pass->writes;
+        for(size_t j = 0; j < graph->numResources; j++) {
+            if((used & (1u << j)) == 0)
+                continue;
+
+            struct FrameGraphResource* resource = &graph->resources[j];
+            if(resource->firstUse == -1)
+                resource->firstUse = i;
+            resource->lastUse = i;
+        }
+    }
+}
+
+// Transients of the same size that are never alive at the same time share a
+// texture. The resources are declared in the order they are first needed, so
+// we only have to remember when each slot is free again.
+static void assign_slots(struct FrameGraph* graph) {
+    int slotFree[FRAMEGRAPH_MAX_RESOURCES];
+    Vector2 slotSize[FRAMEGRAPH_MAX_RESOURCES];
+    size_t numSlots = 0;
+
+    for(size_t i = 0; i < graph->numResources; i++) {
+        struct FrameGraphResource* resource = &graph->resources[i];
+        if(resource->lifetime != FRAMEGRAPH_TRANSIENT || resource->firstUse == -1)
+            continue;
+
+        for(size_t slot = 0; slot < numSlots; slot++) {
+            if(slotFree[slot] < resource->firstUse
+                    && slotSize[slot].x == resource->size.x
+                    && slotSize[slot].y == resource->size.y) {
+                resource->slot = slot;
+                break;
+            }
+        }
+
+        if(resource->slot == -1) {
+            resource->slot = numSlots++;
+            slotSize[resource->slot] = resource->size;
+        }
+        slotFree[resource->slot] = resource->lastUse;
+    }
+}
+
+void framegraph_compile(struct FrameGraph* graph) {
+    cull_passes(graph);
+    find_lifetimes(graph);
+    assign_slots(graph);
+}
+
+static int prepare_slot(struct FrameGraph* graph, int slot, const Vector2* size) {
+    while(graph->numPool <= (size_t)slot) {
+        graph->pool[graph->numPool].gl_texture = 0;
+        graph->numPool++;
+    }
+
+    struct Texture* texture = &graph->pool[slot];
+    if(!texture_initialized(texture)) {
+        if(texture_init(texture, GL_TEXTURE_2D, size) != 0)
+            return 1;
+    } else if(texture->size.x != size->x || texture->size.y != size->y) {
+        texture_resize(texture, size);
+    }
+    return 0;
+}
+
+void framegraph_execute(struct FrameGraph* graph) {
+    for(size_t i = 0; i < graph->numPasses; i++) {
+        struct FrameGraphPass* pass = &graph->passes[i];
+        if(pass->culled)
+            continue;
+
+        bool ready = true;
+        for(size_t j = 0; j < graph->numResources; j++) {
+            struct FrameGraphResource* resource = &graph->resources[j];
+            if(resource->slot == -1 || resource->firstUse != (int)i)
+                continue;
+
+            if(prepare_slot(graph, resource->slot, &resource->size) != 0) {
+                printf_errf("Failed creating the texture for %s", resource->name);
+                ready = false;
+            }
+        }
+        if(!ready)
+            continue;
+
+        zone_scope_extra(&ZONE_frame_graph_pass, "%s", pass->name);
+        pass->execute(graph, pass->userdata);
+    }
+}
+
+struct Texture* framegraph_texture(struct FrameGraph* graph, size_t resource) {
+    assert(resource < graph->numResources);
+    int slot = graph->resources[resource].slot;
+    assert(slot != -1 && (size_t)slot < graph->numPool);
+    return &graph->pool[slot];
+}
+
+static void dump_mask(const struct FrameGraph* graph, FILE* out, const char* label, uint32_t mask) {
+    if(mask == 0)
+        return;
+
+    fprintf(out, "    %s:", label);
+    for(size_t i = 0; i < graph->numResources; i++) {
+        if(mask & (1u << i))
+            fprintf(out, " %s", graph->resources[i].name);
+    }
+    fprintf(out, "\n");
+}
+
+void framegraph_dump(const struct FrameGraph* graph, FILE* out) {
+    static const char* const LIFETIMES[] = {
+        [FRAMEGRAPH_TRANSIENT] = "transient",
+        [FRAMEGRAPH_IMPORTED] = "imported",
+        [FRAMEGRAPH_OUTPUT] = "output",
+    };
+    static const char* const TYPES[] = {
+        [FRAMEGRAPH_COLOR] = "color",
+        [FRAMEGRAPH_DEPTH] = "depth",
+        [FRAMEGRAPH_STENCIL] = "stencil",
+    };
+
+    fprintf(out, "Frame graph: %zu passes, %zu resources\n", graph->numPasses, graph->numResources);
+    for(size_t i = 0; i < graph->numPasses; i++) {
+        const struct FrameGraphPass* pass = &graph->passes[i];
+        fprintf(out, "  %zu %s%s\n", i, pass->name, pass->culled ? " (culled)" : "");
+        dump_mask(graph, out, "reads", pass->reads);
+        dump_mask(graph, out, "writes", pass->writes);
+        dump_mask(graph, out, "barriers", pass->barriers);
+    }
+
+    for(size_t i = 0; i < graph->numResources; i++) {
+        const struct FrameGraphResource* resource = &graph->resources[i];
+        fprintf(out, "  %s: %s %s", resource->name, LIFETIMES[resource->lifetime], TYPES[resource->type]);
+        if(resource->firstUse == -1) {
+            fprintf(out, ", unused\n");
+            continue;
+        }
+        fprintf(out, ", passes %d-%d", resource->firstUse, resource->lastUse);
+        if(resource->slot != -1)
+            fprintf(out, ", slot %d", resource->slot);
+        fprintf(out, "\n");
+    }
+}
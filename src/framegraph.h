@@ -0,0 +1,98 @@
+#pragma once
+
+#include "texture.h"
+#include "vmath.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// The reads and writes of a pass are bitmasks of resources
+#define FRAMEGRAPH_MAX_RESOURCES 32
+#define FRAMEGRAPH_MAX_PASSES 32
+
+enum FrameGraphResourceType {
+    FRAMEGRAPH_COLOR,
+    FRAMEGRAPH_DEPTH,
+    FRAMEGRAPH_STENCIL,
+};
+
+enum FrameGraphLifetime {
+    // Only lives during the frame. The graph owns the texture, and shares it
+    // with other transients that aren't alive at the same time.
+    FRAMEGRAPH_TRANSIENT,
+    // Owned by someone else and kept between frames, like the blur caches
+    FRAMEGRAPH_IMPORTED,
+    // What the frame is for. Passes that don't lead to an output are culled.
+    FRAMEGRAPH_OUTPUT,
+};
+
+struct FrameGraph;
+typedef void (*framegraph_execute_fn)(struct FrameGraph* graph, void* userdata);
+
+struct FrameGraphResource {
+    const char* name;
+    enum FrameGraphResourceType type;
+    enum FrameGraphLifetime lifetime;
+    // Only used by transients
+    Vector2 size;
+
+    // Filled in by framegraph_compile. The uses are pass indices, and the
+    // slot is the texture in the pool a transient ends up in.
+    int firstUse;
+    int lastUse;
+    int slot;
+};
+
+struct FrameGraphPass {
+    const char* name;
+    framegraph_execute_fn execute;
+    void* userdata;
+
+    uint32_t reads;
+    uint32_t writes;
+
+    // Filled in by framegraph_compile
+    bool culled;
+    // Resources an earlier pass wrote and this one reads
+    uint32_t barriers;
+};
+
+// Passes and resources are declared again every frame, in the order the
+// passes should run. The transient textures are kept between frames.
+struct FrameGraph {
+    struct FrameGraphResource resources[FRAMEGRAPH_MAX_RESOURCES];
+    size_t numResources;
+    struct FrameGraphPass passes[FRAMEGRAPH_MAX_PASSES];
+    size_t numPasses;
+
+    struct Texture pool[FRAMEGRAPH_MAX_RESOURCES];
+    size_t numPool;
+};
+
+void framegraph_init(struct FrameGraph* graph);
+void framegraph_delete(struct FrameGraph* graph);
+
+// Forget the passes and resources of the last frame
+void framegraph_begin(struct FrameGraph* graph);
+
+size_t framegraph_resource(struct FrameGraph* graph, const char* name,
+        enum FrameGraphResourceType type, enum FrameGraphLifetime lifetime);
+size_t framegraph_transient(struct FrameGraph* graph, const char* name, const Vector2* size);
+
+size_t framegraph_pass(struct FrameGraph* graph, const char* name,
+        framegraph_execute_fn execute, void* userdata);
+void framegraph_read(struct FrameGraph* graph, size_t pass, size_t resource);
+void framegraph_write(struct FrameGraph* graph, size_t pass, size_t resource);
+
+// Cull the passes, find the lifetimes and the barriers, and put the
+// transients into the pool. Doesn't touch GL.
+void framegraph_compile(struct FrameGraph* graph);
+// Run the passes that weren't culled
+void framegraph_execute(struct FrameGraph* graph);
+
+// The texture backing a transient, only valid while its passes run
+struct Texture* framegraph_texture(struct FrameGraph* graph, size_t resource);
+
+void framegraph_dump(const struct FrameGraph* graph, FILE* out);
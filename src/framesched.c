@@ -0,0 +1,139 @@
+#include "framesched.h"
+
+#include "logging.h"
+
+#include <assert.h>
+
+// Half a refresh at 60hz, until we have measured some frames
+#define DEFAULT_COST 8333
+// Slack for the frames that take a bit longer than the slowest recent one
+#define SAFETY_MARGIN 1000
+// OML timestamps further than this from our clock aren't on the same clock
+#define MAX_CLOCK_SKEW 1000000
+
+void framesched_init(struct FrameScheduler* sched, Display* dpy, GLXDrawable drawable,
+        f_GetSyncValues getSyncValues, uint64_t period) {
+    sched->dpy = dpy;
+    sched->drawable = drawable;
+    sched->getSyncValues = getSyncValues;
+
+    sched->period = period;
+    sched->vblank = 0;
+    sched->msc = 0;
+
+    // Be pessimistic until we have measured some frames
+    for(size_t i = 0; i < FRAMESCHED_HISTORY; i++) {
+        sched->cost[i] = DEFAULT_COST;
+    }
+    sched->costCursor = 0;
+    sched->frameStart = 0;
+    sched->pauseStart = 0;
+    sched->paused = 0;
+}
+
+void framesched_setPeriod(struct FrameScheduler* sched, uint64_t period) {
+    // Keep what we measured rather than forgetting the rate
+    if(period != 0)
+        sched->period = period;
+}
+
+static void refresh_vblank(struct FrameScheduler* sched, uint64_t now) {
+    if(sched->getSyncValues == NULL)
+        return;
+
+    int64_t ust, msc, sbc;
+    if(!sched->getSyncValues(sched->dpy, sched->drawable, &ust, &msc, &sbc) || ust <= 0) {
+        printf_errf("Failed getting the sync values, estimating vblanks from now on");
+        sched->getSyncValues = NULL;
+        return;
+    }
+
+    if(ust > now + MAX_CLOCK_SKEW || ust + MAX_CLOCK_SKEW < now) {
+        printf_errf("The sync values aren't in monotonic time, estimating vblanks from now on");
+        sched->getSyncValues = NULL;
+        return;
+    }
+
+    if(sched->vblank != 0 && msc > sched->msc && ust > sched->vblank) {
+        uint64_t period = (ust - sched->vblank) / (msc - sched->msc);
+        // Smooth out the jitter in the timestamps
+        if(sched->period == 0) {
+            sched->period = period;
+        } else {
+            sched->period = (sched->period * 7 + period) / 8;
+        }
+    }
+
+    sched->vblank = ust;
+    sched->msc = msc;
+}
+
+static uint64_t predicted_cost(const struct FrameScheduler* sched) {
+    uint64_t cost = 0;
+    for(size_t i = 0; i < FRAMESCHED_HISTORY; i++) {
+        if(sched->cost[i] > cost)
+            cost = sched->cost[i];
+    }
+    cost += SAFETY_MARGIN;
+
+    // If we can't make it in a single period there's no point in waiting
+    if(cost > sched->period)
+        cost = sched->period;
+    return cost;
+}
+
+uint64_t framesched_deadline(struct FrameScheduler* sched, uint64_t now) {
+    refresh_vblank(sched, now);
+
+    // Guessing the rate would hold back faster monitors, so until we know it
+    // we just paint as soon as possible.
+    if(sched->vblank == 0 || sched->period == 0)
+        return now;
+
+    // Without vblank timestamps the estimate goes stale whenever we don't
+    // submit, like while X draws a fullscreen window itself. Keep it going by
+    // whole periods, so we are still paced at the refresh rate instead of
+    // spinning.
+    if(sched->getSyncValues == NULL && now >= sched->vblank + sched->period)
+        sched->vblank += (now - sched->vblank) / sched->period * sched->period;
+
+    uint64_t cost = predicted_cost(sched);
+
+    // The first vblank we can still make
+    uint64_t earliest = now + cost;
+    uint64_t target = sched->vblank;
+    if(earliest > target) {
+        uint64_t periods = (earliest - target + sched->period - 1) / sched->period;
+        target += periods * sched->period;
+    }
+
+    return target - cost;
+}
+
+void framesched_begin(struct FrameScheduler* sched, uint64_t now) {
+    sched->frameStart = now;
+    sched->paused = 0;
+}
+
+void framesched_pause(struct FrameScheduler* sched, uint64_t now) {
+    sched->pauseStart = now;
+}
+
+void framesched_resume(struct FrameScheduler* sched, uint64_t now) {
+    assert(now >= sched->pauseStart);
+    sched->paused += now - sched->pauseStart;
+}
+
+void framesched_end(struct FrameScheduler* sched, uint64_t now) {
+    assert(sched->frameStart != 0);
+    assert(now >= sched->frameStart + sched->paused);
+
+    sched->cost[sched->costCursor] = now - sched->frameStart - sched->paused;
+    sched->costCursor = (sched->costCursor + 1) % FRAMESCHED_HISTORY;
+
+    // Without the vblank timestamps we pretend the frame is scanned out as
+    // soon as we submit it. That paces us at the refresh rate, still
+    // starting as late as possible.
+    if(sched->getSyncValues == NULL)
+        sched->vblank = now;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glx.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FRAMESCHED_HISTORY 16
+
+typedef Bool (*f_GetSyncValues) (Display* dpy, GLXDrawable drawable, int64_t* ust, int64_t* msc, int64_t* sbc);
+
+// Decides when to start painting a frame. We want to start as late as
+// possible, so the frame includes the newest input, but early enough that
+// we still make the next vblank. All times are CLOCK_MONOTONIC microseconds.
+struct FrameScheduler {
+    Display* dpy;
+    GLXDrawable drawable;
+    // glXGetSyncValuesOML, NULL when we have to estimate the vblanks
+    f_GetSyncValues getSyncValues;
+
+    // 0 until we know the refresh rate. Without it we don't delay frames.
+    uint64_t period;
+    // The last vblank we know of, 0 if we don't know any
+    uint64_t vblank;
+    int64_t msc;
+
+    // How long the recent frames took from start to submit
+    uint64_t cost[FRAMESCHED_HISTORY];
+    size_t costCursor;
+    uint64_t frameStart;
+    uint64_t pauseStart;
+    uint64_t paused;
+};
+
+// The period is the refresh period in microseconds, 0 if we don't know it
+void framesched_init(struct FrameScheduler* sched, Display* dpy, GLXDrawable drawable,
+        f_GetSyncValues getSyncValues, uint64_t period);
+void framesched_setPeriod(struct FrameScheduler* sched, uint64_t period);
+
+// The time we have to start painting to make the next vblank we can make
+uint64_t framesched_deadline(struct FrameScheduler* sched, uint64_t now);
+
+void framesched_begin(struct FrameScheduler* sched, uint64_t now);
+// Waiting between pause and resume, like for the GPU to catch up, doesn't
+// count towards what the frame costs
+void framesched_pause(struct FrameScheduler* sched, uint64_t now);
+void framesched_resume(struct FrameScheduler* sched, uint64_t now);
+// The frame has been submitted
+void framesched_end(struct FrameScheduler* sched, uint64_t now);
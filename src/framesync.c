@@ -0,0 +1,70 @@
+#include "framesync.h"
+
+#include "logging.h"
+#include "profiler/zone.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+DECLARE_ZONE(frame_throttle);
+DECLARE_ZONE(gpu_finish);
+
+void framesync_init(struct FrameSync* sync, size_t inFlight, bool timing) {
+    assert(inFlight >= 1 && inFlight <= FRAMESYNC_MAX_IN_FLIGHT);
+
+    sync->inFlight = inFlight;
+    sync->timing = timing;
+    sync->cursor = 0;
+    for(size_t i = 0; i < FRAMESYNC_MAX_IN_FLIGHT; i++) {
+        sync->fences[i] = 0;
+    }
+}
+
+static void wait_fence(GLsync* fence) {
+    if(*fence == 0)
+        return;
+
+    GLenum result;
+    do {
+        result = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+    } while(result == GL_TIMEOUT_EXPIRED);
+
+    if(result == GL_WAIT_FAILED) {
+        printf_errf("Failed waiting for the frame fence");
+    }
+
+    glDeleteSync(*fence);
+    *fence = 0;
+}
+
+void framesync_delete(struct FrameSync* sync) {
+    for(size_t i = 0; i < FRAMESYNC_MAX_IN_FLIGHT; i++) {
+        if(sync->fences[i] != 0) {
+            glDeleteSync(sync->fences[i]);
+            sync->fences[i] = 0;
+        }
+    }
+}
+
+void framesync_throttle(struct FrameSync* sync) {
+    zone_scope(&ZONE_frame_throttle);
+
+    // The slot we are about to use holds the oldest frame still in flight
+    wait_fence(&sync->fences[sync->cursor]);
+}
+
+void framesync_submit(struct FrameSync* sync) {
+    assert(sync->fences[sync->cursor] == 0);
+
+    sync->fences[sync->cursor] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if(sync->fences[sync->cursor] == 0) {
+        printf_errf("Failed creating the frame fence");
+    }
+
+    if(sync->timing) {
+        zone_scope(&ZONE_gpu_finish);
+        wait_fence(&sync->fences[sync->cursor]);
+    }
+
+    sync->cursor = (sync->cursor + 1) % sync->inFlight;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glx.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FRAMESYNC_MAX_IN_FLIGHT 3
+
+// Limits how many frames the GPU can lag behind us. Every submitted frame
+// gets a fence, and before starting on a new frame we wait for the frame that
+// would put us over the limit.
+struct FrameSync {
+    size_t inFlight;
+    // Wait for every frame right after submitting it, so the profiler sees
+    // when the GPU actually finished it.
+    bool timing;
+
+    GLsync fences[FRAMESYNC_MAX_IN_FLIGHT];
+    size_t cursor;
+};
+
+void framesync_init(struct FrameSync* sync, size_t inFlight, bool timing);
+void framesync_delete(struct FrameSync* sync);
+
+// Block until we are allowed to start another frame
+void framesync_throttle(struct FrameSync* sync);
+// Mark the end of the GL commands for the current frame
+void framesync_submit(struct FrameSync* sync);
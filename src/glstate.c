@@ -0,0 +1,230 @@
+#include "glstate.h"
+
+#include <string.h>
+
+// GL 3.2 promises at least 48 combined units, we never use close to that
+#define TRACKED_UNITS 32
+
+enum TrackedTarget {
+    TARGET_2D,
+    TARGET_BUFFER,
+    TARGET_RECTANGLE,
+    NUM_TARGETS,
+};
+
+enum TrackedCap {
+    CAP_BLEND,
+    CAP_DEPTH_TEST,
+    CAP_STENCIL_TEST,
+    CAP_SCISSOR_TEST,
+    NUM_CAPS,
+};
+
+// A value together with whether we know what GL has
+#define KNOWN(type) struct { bool known; type value; }
+
+typedef GLenum GLenum2[2];
+typedef GLenum GLenum3[3];
+struct StencilFunc {
+    GLenum func;
+    GLint ref;
+    GLuint mask;
+};
+
+static struct {
+    KNOWN(GLuint) program;
+    KNOWN(GLenum) activeUnit;
+    KNOWN(GLuint) textures[TRACKED_UNITS][NUM_TARGETS];
+    KNOWN(GLuint) drawFramebuffer;
+    KNOWN(GLuint) readFramebuffer;
+    KNOWN(GLuint) vao;
+
+    KNOWN(bool) caps[NUM_CAPS];
+    KNOWN(GLboolean) depthMask;
+    KNOWN(GLenum) depthFunc;
+    KNOWN(GLenum2) blendFunc;
+    KNOWN(GLenum2) blendEquation;
+    KNOWN(GLuint) stencilMask;
+    KNOWN(struct StencilFunc) stencilFunc;
+    KNOWN(GLenum3) stencilOp;
+} state;
+
+static struct GLStateCounts counts;
+
+// Returns true if the call has to be issued, and remembers the new value
+#define TRACK(field, newValue)                                     \
+    glstate_count(!(field).known || (field).value != (newValue)    \
+        ? ((field).known = true, (field).value = (newValue), true) \
+        : false)
+
+#define TRACK_MEM(field, newValue)                                          \
+    glstate_count(!(field).known || memcmp(&(field).value, &(newValue), sizeof((field).value)) != 0 \
+        ? ((field).known = true, memcpy(&(field).value, &(newValue), sizeof((field).value)), true)   \
+        : false)
+
+void glstate_invalidate() {
+    memset(&state, 0, sizeof(state));
+}
+
+bool glstate_count(bool changed) {
+    if(changed) {
+        counts.issued++;
+    } else {
+        counts.skipped++;
+    }
+    return changed;
+}
+
+void glstate_takeCounts(struct GLStateCounts* out) {
+    *out = counts;
+    counts = (struct GLStateCounts){0};
+}
+
+void glstate_useProgram(GLuint program) {
+    if(TRACK(state.program, program))
+        glUseProgram(program);
+}
+
+static int target_index(GLenum target) {
+    switch(target) {
+        case GL_TEXTURE_2D:
+            return TARGET_2D;
+        case GL_TEXTURE_BUFFER:
+            return TARGET_BUFFER;
+        case GL_TEXTURE_RECTANGLE:
+            return TARGET_RECTANGLE;
+    }
+    return -1;
+}
+
+void glstate_bindTexture(GLenum unit, GLenum target, GLuint texture) {
+    size_t unitIndex = unit - GL_TEXTURE0;
+    int targetIndex = target_index(target);
+
+    // Something we don't track, just pass it through
+    if(unitIndex >= TRACKED_UNITS || targetIndex < 0) {
+        glstate_count(true);
+        glActiveTexture(unit);
+        glBindTexture(target, texture);
+        state.activeUnit.known = true;
+        state.activeUnit.value = unit;
+        return;
+    }
+
+    // Callers edit the texture right after binding it, so the unit has to be
+    // active even when the texture is already bound there
+    if(TRACK(state.activeUnit, unit))
+        glActiveTexture(unit);
+
+    if(TRACK(state.textures[unitIndex][targetIndex], texture))
+        glBindTexture(target, texture);
+}
+
+void glstate_bindFramebuffer(GLenum target, GLuint framebuffer) {
+    bool changed = false;
+    if(target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+        changed |= TRACK(state.drawFramebuffer, framebuffer);
+    if(target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+        changed |= TRACK(state.readFramebuffer, framebuffer);
+
+    if(changed)
+        glBindFramebuffer(target, framebuffer);
+}
+
+void glstate_bindVertexArray(GLuint vao) {
+    if(TRACK(state.vao, vao))
+        glBindVertexArray(vao);
+}
+
+void glstate_forgetProgram(GLuint program) {
+    // A program in use stays current after it's deleted, so we might as well
+    // forget all about it
+    if(state.program.value == program)
+        state.program.known = false;
+}
+
+void glstate_forgetTexture(GLuint texture) {
+    for(size_t i = 0; i < TRACKED_UNITS; i++) {
+        for(size_t j = 0; j < NUM_TARGETS; j++) {
+            if(state.textures[i][j].value == texture)
+                state.textures[i][j].value = 0;
+        }
+    }
+}
+
+void glstate_forgetFramebuffer(GLuint framebuffer) {
+    if(state.drawFramebuffer.value == framebuffer)
+        state.drawFramebuffer.value = 0;
+    if(state.readFramebuffer.value == framebuffer)
+        state.readFramebuffer.value = 0;
+}
+
+void glstate_forgetVertexArray(GLuint vao) {
+    if(state.vao.value == vao)
+        state.vao.value = 0;
+}
+
+static int cap_index(GLenum cap) {
+    switch(cap) {
+        case GL_BLEND:
+            return CAP_BLEND;
+        case GL_DEPTH_TEST:
+            return CAP_DEPTH_TEST;
+        case GL_STENCIL_TEST:
+            return CAP_STENCIL_TEST;
+        case GL_SCISSOR_TEST:
+            return CAP_SCISSOR_TEST;
+    }
+    return -1;
+}
+
+void glstate_enable(GLenum cap) {
+    int index = cap_index(cap);
+    if(index < 0 ? glstate_count(true) : TRACK(state.caps[index], true))
+        glEnable(cap);
+}
+
+void glstate_disable(GLenum cap) {
+    int index = cap_index(cap);
+    if(index < 0 ? glstate_count(true) : TRACK(state.caps[index], false))
+        glDisable(cap);
+}
+
+void glstate_depthMask(GLboolean flag) {
+    if(TRACK(state.depthMask, flag))
+        glDepthMask(flag);
+}
+
+void glstate_depthFunc(GLenum func) {
+    if(TRACK(state.depthFunc, func))
+        glDepthFunc(func);
+}
+
+void glstate_blendFunc(GLenum sfactor, GLenum dfactor) {
+    GLenum value[2] = {sfactor, dfactor};
+    if(TRACK_MEM(state.blendFunc, value))
+        glBlendFunc(sfactor, dfactor);
+}
+
+void glstate_blendEquationSeparate(GLenum modeRGB, GLenum modeAlpha) {
+    GLenum value[2] = {modeRGB, modeAlpha};
+    if(TRACK_MEM(state.blendEquation, value))
+        glBlendEquationSeparate(modeRGB, modeAlpha);
+}
+
+void glstate_stencilMask(GLuint mask) {
+    if(TRACK(state.stencilMask, mask))
+        glStencilMask(mask);
+}
+
+void glstate_stencilFunc(GLenum func, GLint ref, GLuint mask) {
+    struct StencilFunc value = {func, ref, mask};
+    if(TRACK_MEM(state.stencilFunc, value))
+        glStencilFunc(func, ref, mask);
+}
+
+void glstate_stencilOp(GLenum sfail, GLenum dpfail, GLenum dppass) {
+    GLenum value[3] = {sfail, dpfail, dppass};
+    if(TRACK_MEM(state.stencilOp, value))
+        glStencilOp(sfail, dpfail, dppass);
+}
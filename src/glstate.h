@@ -0,0 +1,47 @@
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glx.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Shadows the GL state we change often, so setting something to the value it
+// already has never reaches the driver. Everything that changes this state
+// has to go through here, or the shadow goes stale.
+
+// Calls that made it to the driver and the ones we dropped since the counts
+// were last taken
+struct GLStateCounts {
+    size_t issued;
+    size_t skipped;
+};
+
+// Forget everything we know, the next call of each kind is always issued
+void glstate_invalidate();
+
+// Count a call that was (or wasn't) needed. Returns changed
+bool glstate_count(bool changed);
+void glstate_takeCounts(struct GLStateCounts* counts);
+
+void glstate_useProgram(GLuint program);
+// Also leaves unit as the active texture unit
+void glstate_bindTexture(GLenum unit, GLenum target, GLuint texture);
+void glstate_bindFramebuffer(GLenum target, GLuint framebuffer);
+void glstate_bindVertexArray(GLuint vao);
+
+// GL unbinds objects when they are deleted, and the name might come back
+void glstate_forgetProgram(GLuint program);
+void glstate_forgetTexture(GLuint texture);
+void glstate_forgetFramebuffer(GLuint framebuffer);
+void glstate_forgetVertexArray(GLuint vao);
+
+void glstate_enable(GLenum cap);
+void glstate_disable(GLenum cap);
+void glstate_depthMask(GLboolean flag);
+void glstate_depthFunc(GLenum func);
+void glstate_blendFunc(GLenum sfactor, GLenum dfactor);
+void glstate_blendEquationSeparate(GLenum modeRGB, GLenum modeAlpha);
+void glstate_stencilMask(GLuint mask);
+void glstate_stencilFunc(GLenum func, GLint ref, GLuint mask);
+void glstate_stencilOp(GLenum sfail, GLenum dpfail, GLenum dppass);
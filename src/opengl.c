@@ -55,7 +55,7 @@ static XVisualInfo * get_visualinfo_from_visual(session_t *ps, Visual *visual) {
 /**
  * Check if a GLX extension exists.
  */
-static bool glx_hasglxext(session_t *ps, const char *ext) {
+bool glx_hasglxext(session_t *ps, const char *ext) {
     assert(ext != NULL);
     const char *glx_exts = glXQueryExtensionsString(ps->dpy, ps->scr);
     if(glx_exts == NULL) {
@@ -193,6 +193,39 @@ glx_init(session_t *ps) {
     goto glx_init_end;
   }
 
+  // The frame scheduler estimates the vblanks if we don't have these
+  if (glx_hasglxext(ps, "GLX_OML_sync_control")) {
+    psglx->glXGetSyncValuesOML = (f_GetSyncValuesOML)
+      glXGetProcAddress((const GLubyte *) "glXGetSyncValuesOML");
+    psglx->glXWaitForMscOML = (f_WaitForMscOML)
+      glXGetProcAddress((const GLubyte *) "glXWaitForMscOML");
+  }
+
+  // Knowing what's in the back buffer lets us only paint what changed. Without
+  // that we can keep painting the same back buffer and copy the changes over
+  psglx->has_buffer_age = glx_hasglxext(ps, "GLX_EXT_buffer_age");
+  if (!psglx->has_buffer_age && glx_hasglxext(ps, "GLX_MESA_copy_sub_buffer")) {
+    psglx->glXCopySubBufferProc = (f_CopySubBuffer)
+      glXGetProcAddress((const GLubyte *) "glXCopySubBufferMESA");
+  }
+
+  // Let the driver build shader programs on its own threads, so we can do
+  // something else until a program is used. Without this the driver may still
+  // build them in the background, but that's up to the driver.
+  {
+    f_MaxShaderCompilerThreads max_threads = NULL;
+    if (glx_hasglext(ps, "GL_KHR_parallel_shader_compile")) {
+      max_threads = (f_MaxShaderCompilerThreads)
+        glXGetProcAddress((const GLubyte *) "glMaxShaderCompilerThreadsKHR");
+    } else if (glx_hasglext(ps, "GL_ARB_parallel_shader_compile")) {
+      max_threads = (f_MaxShaderCompilerThreads)
+        glXGetProcAddress((const GLubyte *) "glMaxShaderCompilerThreadsARB");
+    }
+    // All ones lets the driver pick the number of threads
+    if (max_threads != NULL)
+      max_threads(0xFFFFFFFF);
+  }
+
   // Render preparations
   glViewport(0, 0, ps->root_size.x, ps->root_size.y);
 
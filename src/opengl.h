@@ -72,7 +72,7 @@ static bool glx_hasglext(session_t *ps, const char *ext) {
     glGetIntegerv(GL_NUM_EXTENSIONS, &n);
     for(int i = 0; i < n; i++) {
         const char* extension = (char*)glGetStringi(GL_EXTENSIONS, i);
-        if(strcmp(ext, extension)) {
+        if(strcmp(ext, extension) == 0) {
             return true;
         }
     }
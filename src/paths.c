@@ -4,6 +4,7 @@
 #include "vector.h"
 
 #include <string.h>
+#include <stdio.h>
 
 static void add_xdg_home(Vector *scratch, const char* appPath, size_t appPath_len) {
     char* home = getenv("HOME");
@@ -58,3 +59,21 @@ void add_xdg_asset_paths() {
     add_xdg_config_dirs(&curPath, appPath, appPath_len);
     vector_kill(&curPath);
 }
+
+char* xdg_cache_path(const char* appPath) {
+    char* path;
+    char* cache_dir = getenv("XDG_CACHE_HOME");
+    if(cache_dir != NULL && strlen(cache_dir) > 0) {
+        if(asprintf(&path, "%s/%s", cache_dir, appPath) < 0)
+            return NULL;
+        return path;
+    }
+
+    char* home = getenv("HOME");
+    if(home == NULL || strlen(home) == 0)
+        return NULL;
+
+    if(asprintf(&path, "%s/.cache/%s", home, appPath) < 0)
+        return NULL;
+    return path;
+}
@@ -1,3 +1,7 @@
 #pragma once
 
 void add_xdg_asset_paths();
+
+// Where the app keeps things that are safe to throw away. The returned path is
+// allocated, or NULL if we don't know where home is.
+char* xdg_cache_path(const char* appPath);
@@ -1,6 +1,8 @@
 #define _GNU_SOURCE
 #include "render.h"
 
+#include "glstate.h"
+
 #include <time.h>
 #include <stdio.h>
 
@@ -117,10 +119,10 @@ static void process(struct ZoneEventStream* stream) {
 static void draw(const Vector2* pos, const Vector2* size) {
     struct face* face = assets_load("window.face");
 
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glstate_bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     static const GLenum DRAWBUFS[2] = { GL_BACK_LEFT };
     glDrawBuffers(1, DRAWBUFS);
@@ -163,7 +165,7 @@ static void draw(const Vector2* pos, const Vector2* size) {
         }
     }
 
-    glEnable(GL_SCISSOR_TEST);
+    glstate_enable(GL_SCISSOR_TEST);
 
     Vector2 textscale = {{1, 1}};
     {
@@ -227,7 +229,7 @@ static void draw(const Vector2* pos, const Vector2* size) {
             }
         }
     }
-    glDisable(GL_SCISSOR_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
 }
 
 void profiler_render(struct ZoneEventStream* event_stream) {
@@ -11,7 +11,37 @@ DECLARE_ZONE(draw_rect);
 
 Matrix view;
 
-void set_matrix(const struct shader_value* mvp, const Vector3 pos, const Vector2 size) {
+// The matrices are written into the stream buffer. When that's full we fall
+// back to respecifying a buffer of our own.
+static struct RingBuffer* matrix_stream;
+static struct BufferObject matrix_bo;
+static struct Texture matrix_tex;
+static struct Texture stream_tex;
+
+void renderutil_init(struct RingBuffer* stream) {
+    matrix_stream = stream;
+    if(bo_init(&matrix_bo, sizeof(Matrix)) != 0) {
+        printf_errf("Failed initializing the matrix buffer");
+        return;
+    }
+    if(texture_init_buffer(&matrix_tex, 0, &matrix_bo, GL_RGBA32F) != 0) {
+        printf_errf("Failed initializing the matrix texture");
+        return;
+    }
+    if(texture_init_buffer(&stream_tex, 0, &stream->bo, GL_RGBA32F) != 0) {
+        printf_errf("Failed initializing the matrix stream texture");
+        return;
+    }
+}
+
+void renderutil_delete() {
+    texture_delete(&stream_tex);
+    texture_delete(&matrix_tex);
+    bo_delete(&matrix_bo);
+    matrix_stream = NULL;
+}
+
+void set_matrix(struct shader_value* mvp, const Vector3 pos, const Vector2 size) {
     Matrix root = view;
     {
         Matrix op = {{
@@ -23,15 +53,36 @@ void set_matrix(const struct shader_value* mvp, const Vector3 pos, const Vector2
         root = mat4_multiply(&root, &op);
     }
 
-    shader_set_uniform_mat4(mvp, &root);
+    // The shader finds the matrix by its index, so it has to start on a whole
+    // matrix
+    size_t offset;
+    if(matrix_stream != NULL
+            && ringbuffer_write(matrix_stream, &root, sizeof(Matrix), sizeof(Matrix), &offset)) {
+        texture_bind(&stream_tex, MATRIX_UNIT);
+        shader_set_uniform_int(mvp, offset / sizeof(Matrix));
+    } else {
+        bo_replace(&matrix_bo, sizeof(Matrix), &root);
+        texture_bind(&matrix_tex, MATRIX_UNIT);
+        shader_set_uniform_int(mvp, 0);
+    }
 }
 
-void draw_rect(const struct face* face, const struct shader_value* mvp, const Vector3 pos, const Vector2 size) {
+void draw_rect(const struct face* face, struct shader_value* mvp, const Vector3 pos, const Vector2 size) {
     zone_scope(&ZONE_draw_rect);
     set_matrix(mvp, pos, size);
 
     face_bind(face);
-    glDrawArrays(GL_TRIANGLES, 0, face->vertex_buffer.size / 3);
+    face_draw(face);
+    debug_mark_draw();
+}
+
+// The shader places every instance itself, so it only needs the view
+void draw_rect_instanced(const struct face* face, struct shader_value* view_uniform, size_t count) {
+    zone_scope(&ZONE_draw_rect);
+    shader_set_uniform_mat4(view_uniform, &view);
+
+    face_bind(face);
+    face_drawInstanced(face, count);
     debug_mark_draw();
 }
 
@@ -11,8 +11,15 @@
 
 extern Matrix view;
 
-void set_matrix(const struct shader_value* mvp, const Vector3 pos, const Vector2 size);
-void draw_rect(const struct face* face, const struct shader_value* mvp, const Vector3 pos, const Vector2 size);
+// The vertex shaders read their matrix from a buffer texture on this unit
+#define MATRIX_UNIT GL_TEXTURE15
+
+void renderutil_init(struct RingBuffer* stream);
+void renderutil_delete();
+
+void set_matrix(struct shader_value* mvp, const Vector3 pos, const Vector2 size);
+void draw_rect(const struct face* face, struct shader_value* mvp, const Vector3 pos, const Vector2 size);
+void draw_rect_instanced(const struct face* face, struct shader_value* view_uniform, size_t count);
 void draw_colored_rect(const struct face* face, const Vector3* pos, const Vector2* size, const Vector4* color);
 
 void draw_tex(struct face* face, const struct Texture* texture,
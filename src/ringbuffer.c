@@ -0,0 +1,140 @@
+#include "ringbuffer.h"
+
+#include "logging.h"
+
+#include <assert.h>
+#include <string.h>
+
+void ringbuffer_reset(struct RingBuffer* ring, size_t size, size_t inFlight) {
+    assert(inFlight >= 1 && inFlight <= FRAMESYNC_MAX_IN_FLIGHT);
+
+    ring->bo.size = size;
+    ring->head = 0;
+    ring->inFlight = inFlight;
+    ring->slot = 0;
+    for(size_t i = 0; i < FRAMESYNC_MAX_IN_FLIGHT; i++) {
+        ring->frameStart[i] = 0;
+        ring->frameUsed[i] = false;
+    }
+}
+
+int ringbuffer_init(struct RingBuffer* ring, size_t size, size_t inFlight, bool persistent) {
+    ringbuffer_reset(ring, size, inFlight);
+    ring->mapped = NULL;
+    ring->bo.allocated = false;
+
+    glGenBuffers(1, &ring->bo.gl);
+    if(ring->bo.gl == 0) {
+        printf_errf("Failed generating the ring buffer");
+        return 1;
+    }
+    ring->bo.target = GL_TEXTURE_BUFFER;
+    glBindBuffer(GL_TEXTURE_BUFFER, ring->bo.gl);
+
+    if(persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_TEXTURE_BUFFER, size, NULL, flags);
+        ring->mapped = glMapBufferRange(GL_TEXTURE_BUFFER, 0, size, flags);
+    }
+
+    if(ring->mapped == NULL) {
+        glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+    ring->bo.allocated = true;
+
+    return 0;
+}
+
+void ringbuffer_delete(struct RingBuffer* ring) {
+    if(ring->mapped != NULL) {
+        glBindBuffer(GL_TEXTURE_BUFFER, ring->bo.gl);
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+        ring->mapped = NULL;
+    }
+    bo_delete(&ring->bo);
+}
+
+void ringbuffer_beginFrame(struct RingBuffer* ring, size_t slot) {
+    assert(slot < ring->inFlight);
+
+    // The last frame in this slot is done, so its data is free
+    ring->slot = slot;
+    ring->frameStart[slot] = ring->head;
+    ring->frameUsed[slot] = true;
+}
+
+// The start of the oldest frame the GPU might still be reading, other than the
+// current one
+static bool oldest_in_flight(const struct RingBuffer* ring, size_t* start) {
+    for(size_t i = 1; i < ring->inFlight; i++) {
+        size_t slot = (ring->slot + i) % ring->inFlight;
+        if(ring->frameUsed[slot]) {
+            *start = ring->frameStart[slot];
+            return true;
+        }
+    }
+
+    // The current frame is the only one, and we don't overwrite that either
+    *start = ring->frameStart[ring->slot];
+    return ring->frameUsed[ring->slot];
+}
+
+static size_t align_up(size_t value, size_t align) {
+    return (value + align - 1) / align * align;
+}
+
+bool ringbuffer_reserve(struct RingBuffer* ring, size_t size, size_t align, size_t* offset) {
+    size_t capacity = ring->bo.size;
+    if(size == 0 || size > capacity)
+        return false;
+
+    size_t tail = 0;
+    if(!oldest_in_flight(ring, &tail))
+        tail = ring->head;
+
+    size_t start = align_up(ring->head, align);
+    if(ring->head >= tail) {
+        // The data in use is between tail and head, so we have the end of the
+        // buffer and then the beginning up to the tail. The head never
+        // catches up with the tail, or we couldn't tell full from empty.
+        if(start + size > capacity) {
+            start = 0;
+            if(ring->head != tail && size >= tail)
+                return false;
+        }
+    } else {
+        // We have wrapped, the free space is between the head and the tail
+        if(start + size >= tail)
+            return false;
+    }
+
+    *offset = start;
+    ring->head = start + size;
+    return true;
+}
+
+bool ringbuffer_write(struct RingBuffer* ring, const void* data, size_t size, size_t align, size_t* offset) {
+    if(!ring->bo.allocated)
+        return false;
+
+    if(!ringbuffer_reserve(ring, size, align, offset))
+        return false;
+
+    if(ring->mapped != NULL) {
+        memcpy((char*)ring->mapped + *offset, data, size);
+        return true;
+    }
+
+    // The fences already tell us the range isn't in use, so the driver
+    // doesn't have to wait for anything
+    glBindBuffer(GL_TEXTURE_BUFFER, ring->bo.gl);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    void* target = glMapBufferRange(GL_TEXTURE_BUFFER, *offset, size, flags);
+    if(target == NULL) {
+        printf_errf("Failed mapping the ring buffer");
+        return false;
+    }
+    memcpy(target, data, size);
+    glUnmapBuffer(GL_TEXTURE_BUFFER);
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "buffer.h"
+#include "framesync.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A buffer for data that changes every frame. Every frame writes after the
+// last one and wraps around at the end. The GPU might still be reading the
+// frames in flight, so their data is kept until FrameSync has seen their
+// fence.
+struct RingBuffer {
+    struct BufferObject bo;
+    // Mapped for as long as the buffer lives, when the driver lets us
+    void* mapped;
+
+    size_t head;
+    size_t inFlight;
+    size_t slot;
+    // Where each frame in flight started writing
+    size_t frameStart[FRAMESYNC_MAX_IN_FLIGHT];
+    bool frameUsed[FRAMESYNC_MAX_IN_FLIGHT];
+};
+
+// persistent needs GL_ARB_buffer_storage. Without it every write maps the
+// range it needs.
+int ringbuffer_init(struct RingBuffer* ring, size_t size, size_t inFlight, bool persistent);
+void ringbuffer_delete(struct RingBuffer* ring);
+
+// Just the bookkeeping, ringbuffer_init does this for us
+void ringbuffer_reset(struct RingBuffer* ring, size_t size, size_t inFlight);
+
+// Start the frame that uses the FrameSync slot. The frame that used the slot
+// last time has to be done.
+void ringbuffer_beginFrame(struct RingBuffer* ring, size_t slot);
+
+// Find room for size bytes at a multiple of align. Returns false if the frames
+// in flight are using all of it.
+bool ringbuffer_reserve(struct RingBuffer* ring, size_t size, size_t align, size_t* offset);
+
+// Copy the data into the buffer. Returns false if there was no room, or the
+// buffer couldn't be written.
+bool ringbuffer_write(struct RingBuffer* ring, const void* data, size_t size, size_t align, size_t* offset);
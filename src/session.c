@@ -66,6 +66,21 @@ void usage(int ret) {
     "\n"
     "--benchmark cycles\n"
     "  Benchmark mode. Repeatedly paint until reaching the specified cycles.\n"
+    "\n"
+    "--frames-in-flight frames\n"
+    "  How many frames the GPU may lag behind the compositor. (1 - 3, default 1)\n"
+    "\n"
+    "--gpu-timing\n"
+    "  Wait for the GPU to finish every frame, so the profiler can see when\n"
+    "  it's done. Slower.\n"
+    "\n"
+    "--immediate-frames\n"
+    "  Start painting as soon as something changes, instead of waiting until\n"
+    "  just before the next vblank.\n"
+    "\n"
+    "--no-unredir-fullscreen\n"
+    "  Keep compositing opaque windows that cover the whole screen, instead\n"
+    "  of letting X draw them directly.\n"
     ;
   FILE *f = (ret ? stderr: stdout);
   fputs(usage_text, f);
@@ -267,6 +282,14 @@ void parse_config(session_t *ps, struct options_tmp *pcfgtmp) {
     lcfg_lookup_bool(&cfg, "blur-background", &ps->o.blur_background);
     // --blur-level
     lcfg_lookup_int(&cfg, "blur-level", &ps->o.blur_level);
+    // --frames-in-flight
+    lcfg_lookup_int(&cfg, "frames-in-flight", &ps->o.frames_in_flight);
+    // --gpu-timing
+    lcfg_lookup_bool(&cfg, "gpu-timing", &ps->o.gpu_timing);
+    // --immediate-frames
+    lcfg_lookup_bool(&cfg, "immediate-frames", &ps->o.immediate_frames);
+    // --no-unredir-fullscreen
+    lcfg_lookup_bool(&cfg, "unredir-fullscreen", &ps->o.unredir_fullscreen);
     // Wintype settings
     {
         wintype_t i;
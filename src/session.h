@@ -8,12 +8,18 @@
 #include "debug.h"
 #include "framebuffer.h"
 #include "renderbuffer.h"
+#include "framesync.h"
+#include "ringbuffer.h"
+#include "framegraph.h"
+#include "framesched.h"
 #include "swiss.h"
 #include "vector.h"
 #include "winprop.h"
+#include "winindex.h"
 
 #include "systems/blur.h"
 #include "systems/order.h"
+#include "systems/damage.h"
 
 #include <X11/extensions/Xinerama.h>
 #include <stdbool.h>
@@ -35,6 +41,8 @@ typedef void (*f_ReleaseTexImageEXT) (Display *display, GLXDrawable drawable, in
 
 typedef void (*f_CopySubBuffer) (Display *dpy, GLXDrawable drawable, int x, int y, int width, int height);
 
+typedef void (*f_MaxShaderCompilerThreads) (GLuint count);
+
 
 #define CGLX_SESSION_INIT { .context = NULL }
 
@@ -84,6 +92,14 @@ typedef struct _options_t {
   int blur_level;
   /// Number of cycles to paint in benchmark mode. 0 for disabled.
   int benchmark;
+  /// Number of frames the GPU may lag behind. 1 - 3.
+  int frames_in_flight;
+  /// Wait for the GPU after every frame, to profile GPU completion.
+  bool gpu_timing;
+  /// Paint as soon as something changes, instead of just before the vblank.
+  bool immediate_frames;
+  /// Let X draw an opaque window covering the whole screen directly.
+  bool unredir_fullscreen;
 
   /// Shadow setting for window types
   bool wintype_shadow[NUM_WINTYPES];
@@ -139,7 +155,10 @@ typedef struct {
   f_BindTexImageEXT glXBindTexImageProc;
   /// Pointer to glXReleaseTexImageEXT function.
   f_ReleaseTexImageEXT glXReleaseTexImageProc;
-  /// Pointer to glXCopySubBufferMESA function.
+  /// Whether we have GLX_EXT_buffer_age.
+  bool has_buffer_age;
+  /// Pointer to glXCopySubBufferMESA function, only used when we don't have
+  /// buffer age.
   f_CopySubBuffer glXCopySubBufferProc;
   /// Current GLX Z value.
   int z;
@@ -193,6 +212,9 @@ typedef struct _session_t {
     /// Whether the program is idling. I.e. no fading, no potential window
     /// changes.
     bool idling;
+    /// Whether something that isn't tracked in the window components changed
+    /// since the last paint (stacking, the root pixmap, the canvas size).
+    bool redraw_needed;
     /// Program start time.
     struct timeval time_start;
     /// Head pointer of the error ignore linked list.
@@ -207,6 +229,8 @@ typedef struct _session_t {
     // Swiss of windows
     Swiss win_list;
     struct Order order;
+    /// Lookup from X window id to the entity tracking it.
+    struct WinIndex win_index;
     /// Pointer to <code>win</code> of current active window. Used by
     /// EWMH <code>_NET_ACTIVE_WINDOW</code> focus detection. In theory,
     /// it's more reliable to store the window ID directly here, just in
@@ -221,6 +245,13 @@ typedef struct _session_t {
 
     struct X11Context xcontext;
     struct DebugGraphState debug_graph;
+
+    struct FrameSync frame_sync;
+    // Data that is made fresh for every frame goes here
+    struct RingBuffer stream;
+    struct FrameGraph frame_graph;
+    struct FrameScheduler frame_sched;
+    struct ScreenDamage damage;
 } session_t;
 
 void usage(int ret);
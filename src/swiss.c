@@ -216,10 +216,12 @@ win_id swiss_allocate(Swiss* index) {
         // Allocate space at the end of the array
         assert(index->capacity != 0);
 
+        size_t oldSize = index->capacity;
         size_t newSize = index->capacity * 2;
         resize_real(index, newSize);
 
-        index->firstFree = findNextFree(index, COMPONENT_META, newSize);
+        // The first new slot is free, everything before it is taken
+        index->firstFree = findNextFree(index, COMPONENT_META, oldSize);
     }
 
     win_id id = index->firstFree;
@@ -48,6 +48,8 @@ enum ComponentType {
     COMPONENT_DIM,
     COMPONENT_FADES_DIM,
     COMPONENT_REDIRECTED,
+    COMPONENT_UNREDIRECTED, // Fullscreen, drawn by X instead of us
+    COMPONENT_OCCLUDED, // Hidden behind opaque windows, shadow and all
     COMPONENT_SHAPED,
     COMPONENT_STATEFUL,
     COMPONENT_DEBUGGED,
@@ -63,6 +65,7 @@ enum ComponentType {
     COMPONENT_RESIZE,
     COMPONENT_BLUR_DAMAGED,
     COMPONENT_CONTENTS_DAMAGED,
+    COMPONENT_DAMAGED_REGION,
     COMPONENT_SHADOW_DAMAGED,
 	COMPONENT_SHAPE_DAMAGED,
     COMPONENT_FOCUS_CHANGE,
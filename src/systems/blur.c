@@ -1,6 +1,7 @@
 #define GL_GLEXT_PROTOTYPES
 #include "blur.h"
 
+#include "glstate.h"
 #include "profiler/zone.h"
 
 #include "assets/assets.h"
@@ -43,7 +44,7 @@ static void fetchSortedWindowsWithArr(Swiss* em, Vector* result, CType* query) {
 
 void blursystem_init() {
     glGenVertexArrays(1, &context.array);
-    glBindVertexArray(context.array);
+    glstate_bindVertexArray(context.array);
 
     // Generate FBO if needed
     if(!framebuffer_initialized(&context.fbo)) {
@@ -78,6 +79,7 @@ void blursystem_delete(Swiss* em) {
     swiss_resetComponent(em, COMPONENT_BLUR);
 
     glDeleteVertexArrays(1, &context.array);
+    glstate_forgetVertexArray(context.array);
     vector_kill(&context.to_blur);
 
 	vector_kill(&context.opaque_behind);
@@ -210,6 +212,41 @@ static int blur_cache_init(glx_blur_cache_t* cache) {
     return 0;
 }
 
+// Does any of the damaged parts of the window overlap the other window
+static bool damage_overlap(Swiss* em, win_id damaged, win_id other) {
+    if(!win_overlap(em, damaged, other))
+        return false;
+
+    // Without a region the entire window is damaged
+    if(!swiss_hasComponent(em, COMPONENT_DAMAGED_REGION, damaged))
+        return true;
+
+    struct DamagedRegionComponent* region = swiss_getComponent(em, COMPONENT_DAMAGED_REGION, damaged);
+    struct PhysicalComponent* damagedPhy = swiss_getComponent(em, COMPONENT_PHYSICAL, damaged);
+    struct PhysicalComponent* otherPhy = swiss_getComponent(em, COMPONENT_PHYSICAL, other);
+
+    Vector2 otherMax = otherPhy->position;
+    vec2_add(&otherMax, &otherPhy->size);
+
+    size_t index;
+    struct Rect* rect = vector_getFirst(&region->rects, &index);
+    while(rect != NULL) {
+        Vector2 min = damagedPhy->position;
+        vec2_add(&min, &rect->pos);
+        Vector2 max = min;
+        vec2_add(&max, &rect->size);
+
+        if(min.x <= otherMax.x && otherPhy->position.x <= max.x
+                && min.y <= otherMax.y && otherPhy->position.y <= max.y) {
+            return true;
+        }
+
+        rect = vector_getNext(&region->rects, &index);
+    }
+
+    return false;
+}
+
 void damage_blur_over_damaged(Swiss* em, Vector* order) {
     zone_scope(&ZONE_prop_blur_damage);
     // Damage the blur of windows on top of damaged windows
@@ -221,7 +258,7 @@ void damage_blur_over_damaged(Swiss* em, Vector* order) {
         win_id* other_id = vector_getNext(order, &order_slot);
         while(other_id != NULL) {
 
-            if(win_overlap(em, it.id, *other_id)) {
+            if(damage_overlap(em, it.id, *other_id)) {
                 swiss_ensureComponent(em, COMPONENT_BLUR_DAMAGED, *other_id);
             }
 
@@ -344,7 +381,7 @@ void blursystem_updateBlur(Swiss* em, Vector2* root_size,
         vector_clear(&context.to_blur);
         fetchSortedWindowsWith(em, &context.to_blur, 
                 COMPONENT_MUD, COMPONENT_BLUR, COMPONENT_BLUR_DAMAGED, COMPONENT_Z,
-                COMPONENT_PHYSICAL, CQ_END);
+                COMPONENT_PHYSICAL, CQ_NOT, COMPONENT_OCCLUDED, CQ_END);
     }
 
     framebuffer_resetTarget(&context.fbo);
@@ -352,8 +389,8 @@ void blursystem_updateBlur(Swiss* em, Vector2* root_size,
 
     struct face* face = assets_load("window.face");
 
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
 
     // Blurring is a strange process, because every window depends on the blurs
     // behind it. Therefore we render them individually, starting from the
@@ -377,13 +414,13 @@ void blursystem_updateBlur(Swiss* em, Vector2* root_size,
         view = mat4_orthogonal(glpos.x, glpos.x + physical->size.x, glpos.y, glpos.y + physical->size.y, -1, 1);
         glViewport(0, 0, physical->size.x, physical->size.y);
 
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
+        glstate_enable(GL_DEPTH_TEST);
+        glstate_enable(GL_BLEND);
 
         glClearColor(1.0, 0.0, 1.0, 0.0);
         glClearDepth(1.0);
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS);
+        glstate_depthMask(GL_TRUE);
+        glstate_depthFunc(GL_LESS);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Find the drawables behind this one
@@ -396,15 +433,15 @@ void blursystem_updateBlur(Swiss* em, Vector2* root_size,
         windowlist_draw(ps, &context.opaque_behind);
 
         // Draw root
-        glEnable(GL_DEPTH_TEST);
+        glstate_enable(GL_DEPTH_TEST);
         draw_tex(face, texture, &(Vector3){{0, 0, 0.99999}}, root_size);
-        glDisable(GL_DEPTH_TEST);
+        glstate_disable(GL_DEPTH_TEST);
 
         windowlist_drawTransparent(ps, &context.transparent_behind);
 
         view = old_view;
 
-        glDisable(GL_BLEND);
+        glstate_disable(GL_BLEND);
 
         struct TextureBlurData blurData = {
             .depth = &blur->stencil,
@@ -434,18 +471,20 @@ void blursystem_updateBlur(Swiss* em, Vector2* root_size,
         glClearColor(0.0, 0.0, 0.0, 0.0);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        /* glEnable(GL_STENCIL_TEST); */
+        /* glstate_enable(GL_STENCIL_TEST); */
 
-        glStencilMask(0);
-        glStencilFunc(GL_EQUAL, 1, 0xFF);
+        glstate_stencilMask(0);
+        glstate_stencilFunc(GL_EQUAL, 1, 0xFF);
 
         draw_tex(face, &blur->texture[1], &VEC3_ZERO, &blur->texture[0].size);
 
-        /* glDisable(GL_STENCIL_TEST); */
+        /* glstate_disable(GL_STENCIL_TEST); */
         view = old_view;
 
         w_id = vector_getPrev(&context.to_blur, &index);
     }
 
-    swiss_resetComponent(em, COMPONENT_BLUR_DAMAGED);
+    // Hidden windows keep their damage until they show up again
+    swiss_removeComponentWhere(em, COMPONENT_BLUR_DAMAGED,
+            (CType[]){CQ_NOT, COMPONENT_OCCLUDED, CQ_END});
 }
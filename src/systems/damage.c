@@ -0,0 +1,223 @@
+#include "damage.h"
+
+#include <math.h>
+
+#include "profiler/zone.h"
+
+#include "window.h"
+#include "systems/shadow.h"
+
+DECLARE_ZONE(collect_damage);
+
+// Past this many rectangles we might as well paint everything
+#define MAX_DAMAGE_RECTS 128
+
+void damagesystem_init(struct ScreenDamage* damage) {
+    vector_init(&damage->windows, sizeof(struct PaintedWindow), 16);
+    for(size_t i = 0; i < DAMAGE_MAX_AGE; i++) {
+        // We don't know what's in the buffers yet
+        damage->frames[i].full = true;
+        vector_init(&damage->frames[i].rects, sizeof(struct Rect), 16);
+    }
+    damage->cursor = 0;
+    damage->frame = 0;
+
+    vector_init(&damage->region, sizeof(struct Rect), 16);
+    damage->partial = false;
+}
+
+void damagesystem_delete(struct ScreenDamage* damage) {
+    vector_kill(&damage->region);
+    for(size_t i = 0; i < DAMAGE_MAX_AGE; i++) {
+        vector_kill(&damage->frames[i].rects);
+    }
+    vector_kill(&damage->windows);
+}
+
+static void add_damage(struct DamageFrame* frame, const struct Rect* rect) {
+    if(frame->full)
+        return;
+
+    if(rect->size.x <= 0 || rect->size.y <= 0)
+        return;
+
+    if(vector_size(&frame->rects) >= MAX_DAMAGE_RECTS) {
+        frame->full = true;
+        return;
+    }
+
+    vector_putBack(&frame->rects, rect);
+}
+
+static struct Rect window_body(Swiss* em, win_id wid) {
+    struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, wid);
+    struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, wid);
+
+    // The content is drawn at the size of the texture, which lags behind
+    // the window when it's resized
+    struct Rect body = {
+        .pos = physical->position,
+        .size = physical->size,
+    };
+    body.size.x = fmax(body.size.x, textured->texture.size.x);
+    body.size.y = fmax(body.size.y, textured->texture.size.y);
+    return body;
+}
+
+static struct Rect window_shadow(Swiss* em, win_id wid, const struct Rect* body) {
+    struct glx_shadow_cache* shadow = swiss_getComponent(em, COMPONENT_SHADOW, wid);
+
+    struct Rect extents = *body;
+    vec2_sub(&extents.pos, &shadow->border);
+    vec2_add(&extents.size, &shadow->border);
+    vec2_add(&extents.size, &shadow->border);
+    return extents;
+}
+
+static struct PaintedWindow describe_window(Swiss* em, win_id wid, size_t frame) {
+    struct ZComponent* z = swiss_getComponent(em, COMPONENT_Z, wid);
+    struct OpacityComponent* opacity = swiss_godComponent(em, COMPONENT_OPACITY, wid);
+    struct BgOpacityComponent* bgOpacity = swiss_godComponent(em, COMPONENT_BGOPACITY, wid);
+    struct DimComponent* dim = swiss_godComponent(em, COMPONENT_DIM, wid);
+    struct TintComponent* tint = swiss_godComponent(em, COMPONENT_TINT, wid);
+
+    struct PaintedWindow painted = {
+        .painted = true,
+        .frame = frame,
+        .extents = window_body(em, wid),
+        .z = z->z,
+        .opacity = opacity != NULL ? opacity->opacity : 100.0,
+        .bgOpacity = bgOpacity != NULL ? bgOpacity->opacity : 100.0,
+        .dim = dim != NULL ? dim->dim : 100.0,
+        .tint = tint != NULL ? tint->color : (Vector4){{0, 0, 0, 0}},
+    };
+
+    if(swiss_hasComponent(em, COMPONENT_SHADOW, wid)) {
+        painted.extents = window_shadow(em, wid, &painted.extents);
+    }
+
+    return painted;
+}
+
+static bool same_rect(const struct Rect* a, const struct Rect* b) {
+    return a->pos.x == b->pos.x && a->pos.y == b->pos.y
+        && a->size.x == b->size.x && a->size.y == b->size.y;
+}
+
+static bool same_look(const struct PaintedWindow* a, const struct PaintedWindow* b) {
+    return same_rect(&a->extents, &b->extents)
+        && a->z == b->z
+        && a->opacity == b->opacity
+        && a->bgOpacity == b->bgOpacity
+        && a->dim == b->dim
+        && a->tint.x == b->tint.x && a->tint.y == b->tint.y
+        && a->tint.z == b->tint.z && a->tint.w == b->tint.w;
+}
+
+// Damage from what happened inside a window that otherwise looks the same
+static void damage_window_contents(Swiss* em, win_id wid, struct DamageFrame* frame) {
+    struct Rect body = window_body(em, wid);
+
+    // The new shape can uncover what's below, and the shadow follows it
+    if(swiss_hasComponent(em, COMPONENT_SHAPE_DAMAGED, wid)
+            || swiss_hasComponent(em, COMPONENT_SHADOW_DAMAGED, wid)) {
+        struct Rect extents = body;
+        if(swiss_hasComponent(em, COMPONENT_SHADOW, wid))
+            extents = window_shadow(em, wid, &body);
+        add_damage(frame, &extents);
+        return;
+    }
+
+    // The blur fills the entire window
+    if(swiss_hasComponent(em, COMPONENT_BLUR_DAMAGED, wid)) {
+        add_damage(frame, &body);
+        return;
+    }
+
+    if(!swiss_hasComponent(em, COMPONENT_CONTENTS_DAMAGED, wid))
+        return;
+
+    if(!swiss_hasComponent(em, COMPONENT_DAMAGED_REGION, wid)) {
+        add_damage(frame, &body);
+        return;
+    }
+
+    struct DamagedRegionComponent* region = swiss_getComponent(em, COMPONENT_DAMAGED_REGION, wid);
+    size_t index;
+    struct Rect* rect = vector_getFirst(&region->rects, &index);
+    while(rect != NULL) {
+        struct Rect screen = *rect;
+        vec2_add(&screen.pos, &body.pos);
+        add_damage(frame, &screen);
+
+        rect = vector_getNext(&region->rects, &index);
+    }
+}
+
+void damagesystem_tick(Swiss* em, struct ScreenDamage* damage, Vector* painted, bool full) {
+    zone_scope(&ZONE_collect_damage);
+
+    damage->frame++;
+    damage->cursor = (damage->cursor + 1) % DAMAGE_MAX_AGE;
+    struct DamageFrame* frame = &damage->frames[damage->cursor];
+    frame->full = full;
+    vector_clear(&frame->rects);
+
+    while(vector_size(&damage->windows) < em->capacity) {
+        struct PaintedWindow* window = vector_reserve(&damage->windows, 1);
+        *window = (struct PaintedWindow){0};
+    }
+
+    size_t index;
+    win_id* wid = vector_getFirst(painted, &index);
+    while(wid != NULL) {
+        struct PaintedWindow* last = vector_get(&damage->windows, *wid);
+        struct PaintedWindow now = describe_window(em, *wid, damage->frame);
+
+        if(!last->painted || !same_look(last, &now)) {
+            // Whatever was there before has to go, and the new look has to
+            // be painted
+            if(last->painted)
+                add_damage(frame, &last->extents);
+            add_damage(frame, &now.extents);
+        } else {
+            damage_window_contents(em, *wid, frame);
+        }
+
+        *last = now;
+        wid = vector_getNext(painted, &index);
+    }
+
+    // Windows that were painted last time but aren't anymore leave a hole
+    for(size_t i = 0; i < vector_size(&damage->windows); i++) {
+        struct PaintedWindow* window = vector_get(&damage->windows, i);
+        if(!window->painted || window->frame == damage->frame)
+            continue;
+
+        add_damage(frame, &window->extents);
+        window->painted = false;
+    }
+}
+
+bool damagesystem_region(struct ScreenDamage* damage, int age) {
+    vector_clear(&damage->region);
+    damage->partial = false;
+
+    // An age of 0 means the contents of the buffer are unknown
+    if(age <= 0 || age > DAMAGE_MAX_AGE)
+        return false;
+
+    for(int i = 0; i < age; i++) {
+        size_t cursor = (damage->cursor + DAMAGE_MAX_AGE - i) % DAMAGE_MAX_AGE;
+        const struct DamageFrame* frame = &damage->frames[cursor];
+        if(frame->full) {
+            vector_clear(&damage->region);
+            return false;
+        }
+
+        vector_putListBack(&damage->region, frame->rects.data, vector_size(&frame->rects));
+    }
+
+    damage->partial = true;
+    return true;
+}
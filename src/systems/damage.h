@@ -0,0 +1,59 @@
+#pragma once
+
+#include "swiss.h"
+#include "vector.h"
+#include "vmath.h"
+#include "assets/face.h"
+
+// Back buffers older than this are painted completely
+#define DAMAGE_MAX_AGE 5
+
+// What we painted a window as last time, so we can tell when it changes
+struct PaintedWindow {
+    bool painted;
+    // The frame we last saw the window in
+    size_t frame;
+
+    // Everything the window draws, shadow included
+    struct Rect extents;
+
+    double z;
+    double opacity;
+    double bgOpacity;
+    double dim;
+    Vector4 tint;
+};
+
+struct DamageFrame {
+    // The whole screen has to be painted
+    bool full;
+    // struct Rect in X coordinates
+    Vector rects;
+};
+
+// The screen damage of the last few frames. A back buffer that is N frames
+// old needs the damage of all N frames painted to be current.
+struct ScreenDamage {
+    // struct PaintedWindow indexed by win_id
+    Vector windows;
+
+    struct DamageFrame frames[DAMAGE_MAX_AGE];
+    size_t cursor;
+    size_t frame;
+
+    // What has to be painted this frame, struct Rect in X coordinates. Only
+    // valid when partial is true
+    Vector region;
+    bool partial;
+};
+
+void damagesystem_init(struct ScreenDamage* damage);
+void damagesystem_delete(struct ScreenDamage* damage);
+
+// Record the damage of the frame we are about to paint. painted has to be
+// every window that is drawn this frame
+void damagesystem_tick(Swiss* em, struct ScreenDamage* damage, Vector* painted, bool full);
+
+// Find the region to paint into a back buffer that is age frames old. Returns
+// false if the whole screen has to be painted
+bool damagesystem_region(struct ScreenDamage* damage, int age);
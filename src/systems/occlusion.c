@@ -0,0 +1,167 @@
+#include "occlusion.h"
+
+#include <math.h>
+
+#include "profiler/zone.h"
+
+#include "window.h"
+#include "systems/shape.h"
+#include "systems/shadow.h"
+
+DECLARE_ZONE(occlusion_cull);
+
+// Give up on proving a window hidden when the visible part is split into
+// more pieces than this. It's most likely visible anyway.
+#define MAX_PIECES 64
+
+static bool rect_empty(const struct Rect* rect) {
+    return rect->size.x <= 0 || rect->size.y <= 0;
+}
+
+static void put_rect(Vector* rects, float x1, float y1, float x2, float y2) {
+    struct Rect rect = {
+        .pos = {{x1, y1}},
+        .size = {{x2 - x1, y2 - y1}},
+    };
+    if(!rect_empty(&rect))
+        vector_putBack(rects, &rect);
+}
+
+// Put what's left of rect after cutting away cut into pieces
+static void subtract_rect(const struct Rect* rect, const struct Rect* cut, Vector* pieces) {
+    float rx1 = rect->pos.x, rx2 = rect->pos.x + rect->size.x;
+    float ry1 = rect->pos.y, ry2 = rect->pos.y + rect->size.y;
+    float cx1 = cut->pos.x, cx2 = cut->pos.x + cut->size.x;
+    float cy1 = cut->pos.y, cy2 = cut->pos.y + cut->size.y;
+
+    if(cx1 >= rx2 || cx2 <= rx1 || cy1 >= ry2 || cy2 <= ry1) {
+        vector_putBack(pieces, rect);
+        return;
+    }
+
+    float ix1 = fmaxf(rx1, cx1), ix2 = fminf(rx2, cx2);
+    float iy1 = fmaxf(ry1, cy1), iy2 = fminf(ry2, cy2);
+
+    // Full width bands above and below, then the sides of the middle band
+    put_rect(pieces, rx1, ry1, rx2, iy1);
+    put_rect(pieces, rx1, iy2, rx2, ry2);
+    put_rect(pieces, rx1, iy1, ix1, iy2);
+    put_rect(pieces, ix2, iy1, rx2, iy2);
+}
+
+// Is the rect off screen or covered by the occluders? pieces and scratch are
+// just working memory
+static bool rect_hidden(const struct Rect* rect, const Vector* occluders, const Vector2* canvas_size, Vector* pieces, Vector* scratch) {
+    vector_clear(pieces);
+
+    // Whatever is off screen is hidden too
+    float x1 = fmaxf(rect->pos.x, 0);
+    float y1 = fmaxf(rect->pos.y, 0);
+    float x2 = fminf(rect->pos.x + rect->size.x, canvas_size->x);
+    float y2 = fminf(rect->pos.y + rect->size.y, canvas_size->y);
+    put_rect(pieces, x1, y1, x2, y2);
+
+    size_t index;
+    const struct Rect* cut = vector_getFirst(occluders, &index);
+    while(cut != NULL) {
+        if(vector_size(pieces) == 0)
+            return true;
+        if(vector_size(pieces) > MAX_PIECES)
+            return false;
+
+        vector_clear(scratch);
+        for(size_t i = 0; i < vector_size(pieces); i++) {
+            subtract_rect(vector_get(pieces, i), cut, scratch);
+        }
+
+        Vector swap = *pieces;
+        *pieces = *scratch;
+        *scratch = swap;
+
+        cut = vector_getNext(occluders, &index);
+    }
+
+    return vector_size(pieces) == 0;
+}
+
+// We only know the visual once the window is bound, until then it could
+// have alpha
+static bool has_alpha(Swiss* em, win_id wid) {
+    if(!swiss_hasComponent(em, COMPONENT_BINDS_TEXTURE, wid))
+        return true;
+
+    struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, wid);
+    return wd_hasAlpha(&bindsTexture->drawable);
+}
+
+void occlusionsystem_tick(Swiss* em, Vector2* canvas_size, Vector* opaque, Vector* transparent) {
+    zone_scope(&ZONE_occlusion_cull);
+
+    swiss_resetComponent(em, COMPONENT_OCCLUDED);
+
+    Vector occluders;
+    vector_init(&occluders, sizeof(struct Rect), 16);
+    Vector pieces;
+    vector_init(&pieces, sizeof(struct Rect), 16);
+    Vector scratch;
+    vector_init(&scratch, sizeof(struct Rect), 16);
+
+    size_t opaque_next = 0;
+    size_t opaque_kept = 0;
+    size_t transparent_kept = 0;
+    for(size_t i = 0; i < vector_size(transparent); i++) {
+        win_id wid = *(win_id*)vector_get(transparent, i);
+        struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, wid);
+
+        bool is_opaque = opaque_next < vector_size(opaque)
+            && *(win_id*)vector_get(opaque, opaque_next) == wid;
+        if(is_opaque)
+            opaque_next++;
+
+        struct Rect body = {
+            .pos = physical->position,
+            .size = physical->size,
+        };
+        bool body_hidden = rect_hidden(&body, &occluders, canvas_size, &pieces, &scratch);
+
+        // The shadow surrounds the body, so it can only be hidden if the
+        // body is
+        bool hidden = body_hidden;
+        if(hidden && swiss_hasComponent(em, COMPONENT_SHADOW, wid)) {
+            struct glx_shadow_cache* shadow = swiss_getComponent(em, COMPONENT_SHADOW, wid);
+            struct Rect extents = body;
+            vec2_sub(&extents.pos, &shadow->border);
+            vec2_add(&extents.size, &shadow->border);
+            vec2_add(&extents.size, &shadow->border);
+            hidden = rect_hidden(&extents, &occluders, canvas_size, &pieces, &scratch);
+        }
+
+        if(is_opaque && !body_hidden) {
+            *(win_id*)vector_get(opaque, opaque_kept++) = wid;
+            // What's below an ARGB window shows through wherever it's
+            // translucent, even if we draw it as opaque
+            if(!has_alpha(em, wid))
+                shapesystem_screenRects(em, wid, &occluders);
+        }
+
+        if(hidden) {
+            swiss_addComponent(em, COMPONENT_OCCLUDED, wid);
+        } else {
+            *(win_id*)vector_get(transparent, transparent_kept++) = wid;
+        }
+    }
+
+    // If the lists disagree on the order we lose track of the opaque windows.
+    // Keep the rest, drawing too much is better than too little.
+    for(; opaque_next < vector_size(opaque); opaque_next++) {
+        win_id wid = *(win_id*)vector_get(opaque, opaque_next);
+        *(win_id*)vector_get(opaque, opaque_kept++) = wid;
+    }
+
+    vector_truncate(opaque, opaque_kept);
+    vector_truncate(transparent, transparent_kept);
+
+    vector_kill(&scratch);
+    vector_kill(&pieces);
+    vector_kill(&occluders);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "swiss.h"
+#include "vector.h"
+#include "vmath.h"
+
+// Both lists have to be sorted front to back, and the opaque windows have to
+// be in the transparent list as well. Windows we can't see are removed from
+// the lists.
+void occlusionsystem_tick(Swiss* em, Vector2* canvas_size, Vector* opaque, Vector* transparent);
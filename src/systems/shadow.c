@@ -1,5 +1,6 @@
 #include "shadow.h"
 
+#include "glstate.h"
 #include "assets/assets.h"
 #include "assets/shader.h"
 #include "textureeffects.h"
@@ -164,16 +165,16 @@ void shadowsystem_updateShadow(session_t* ps, Vector* paints) {
     framebuffer_resetTarget(&framebuffer);
     framebuffer_bind(&framebuffer);
 
-    glDisable(GL_BLEND);
+    glstate_disable(GL_BLEND);
 
-    glStencilMask(0xFF);
+    glstate_stencilMask(0xFF);
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glClearStencil(0);
 
     // Clear all the shadow textures we are about to render into
     for_components(it, &ps->win_list,
         COMPONENT_MUD, COMPONENT_TEXTURED, COMPONENT_PHYSICAL, COMPONENT_SHADOW_DAMAGED, COMPONENT_SHADOW,
-        COMPONENT_SHAPED, CQ_END) {
+        COMPONENT_SHAPED, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
         zone_scope(&ZONE_shadow_clear);
         struct glx_shadow_cache* shadow = swiss_getComponent(&ps->win_list, COMPONENT_SHADOW, it.id);
 
@@ -205,7 +206,7 @@ void shadowsystem_updateShadow(session_t* ps, Vector* paints) {
     // Render into the textures
     for_components(it, &ps->win_list,
         COMPONENT_MUD, COMPONENT_TEXTURED, COMPONENT_PHYSICAL, COMPONENT_SHADOW_DAMAGED, COMPONENT_SHADOW,
-        COMPONENT_SHAPED, CQ_END) {
+        COMPONENT_SHAPED, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
         zone_scope(&ZONE_shadow_copy);
         struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, it.id);
         struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, it.id);
@@ -239,6 +240,7 @@ void shadowsystem_updateShadow(session_t* ps, Vector* paints) {
         COMPONENT_SHADOW_DAMAGED,
         COMPONENT_SHADOW,
         COMPONENT_SHAPED,
+        CQ_NOT, COMPONENT_OCCLUDED,
         CQ_END,
     });
 
@@ -248,7 +250,7 @@ void shadowsystem_updateShadow(session_t* ps, Vector* paints) {
     // Setup the blur request data
     for_components(it, &ps->win_list,
         COMPONENT_MUD, COMPONENT_TEXTURED, COMPONENT_PHYSICAL, COMPONENT_SHADOW_DAMAGED, COMPONENT_SHADOW,
-        COMPONENT_SHAPED, CQ_END) {
+        COMPONENT_SHAPED, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
         zone_scope(&ZONE_shadow_setup_blur);
         struct glx_shadow_cache* shadow = swiss_getComponent(&ps->win_list, COMPONENT_SHADOW, it.id);
 
@@ -261,7 +263,7 @@ void shadowsystem_updateShadow(session_t* ps, Vector* paints) {
     }
     assert(blurDatas.maxSize == textures);
 
-    glDisable(GL_STENCIL_TEST);
+    glstate_disable(GL_STENCIL_TEST);
 
     zone_enter(&ZONE_shadow_blur);
     textures_blur(&blurDatas, &framebuffer, 4, false);
@@ -290,7 +292,7 @@ void shadowsystem_updateShadow(session_t* ps, Vector* paints) {
     old_view = view;
     for_components(it, &ps->win_list,
         COMPONENT_MUD, COMPONENT_TEXTURED, COMPONENT_PHYSICAL, COMPONENT_SHADOW_DAMAGED, COMPONENT_SHADOW,
-        COMPONENT_SHAPED, CQ_END) {
+        COMPONENT_SHAPED, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
         zone_scope(&ZONE_shadow_clip);
         struct glx_shadow_cache* shadow = swiss_getComponent(&ps->win_list, COMPONENT_SHADOW, it.id);
 
@@ -317,7 +319,9 @@ void shadowsystem_updateShadow(session_t* ps, Vector* paints) {
     }
     view = old_view;
 
-    swiss_resetComponent(&ps->win_list, COMPONENT_SHADOW_DAMAGED);
+    // Hidden windows keep their damage until they show up again
+    swiss_removeComponentWhere(&ps->win_list, COMPONENT_SHADOW_DAMAGED,
+            (CType[]){CQ_NOT, COMPONENT_OCCLUDED, CQ_END});
 
     framebuffer_delete(&framebuffer);
 }
@@ -7,9 +7,99 @@
 #include "window.h"
 #include "assert.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 DECLARE_ZONE(commit_reshape);
 DECLARE_ZONE(fetch_shape);
 
+static int compare_rows(const void* a, const void* b) {
+    const XRectangle* rect_a = a;
+    const XRectangle* rect_b = b;
+    if(rect_a->y != rect_b->y)
+        return rect_a->y - rect_b->y;
+    if(rect_a->height != rect_b->height)
+        return rect_a->height - rect_b->height;
+    return rect_a->x - rect_b->x;
+}
+
+static bool same_band(const XRectangle* a, const XRectangle* b) {
+    return a->y == b->y && a->height == b->height;
+}
+
+// How many rectangles from first are in the same band
+static size_t band_length(const XRectangle* rects, size_t first, size_t count) {
+    size_t end = first + 1;
+    while(end < count && same_band(&rects[first], &rects[end]))
+        end++;
+    return end - first;
+}
+
+// Does the band below continue the band above with the exact same spans?
+static bool continues_band(const XRectangle* above, size_t above_len, const XRectangle* below, size_t below_len) {
+    if(above_len != below_len)
+        return false;
+    if(above[0].y + above[0].height != below[0].y)
+        return false;
+
+    for(size_t i = 0; i < above_len; i++) {
+        if(above[i].x != below[i].x || above[i].width != below[i].width)
+            return false;
+    }
+    return true;
+}
+
+// @PERFORMANCE Shapes come to us as rows of rectangles, and nothing
+// guarantees they are as few as they could be. Join the rectangles that touch
+// in a row, and then the rows with the same spans. Returns the new count.
+static size_t merge_bands(XRectangle* rects, size_t count) {
+    if(count <= 1)
+        return count;
+
+    qsort(rects, count, sizeof(XRectangle), compare_rows);
+
+    size_t merged = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(rects[i].width == 0 || rects[i].height == 0)
+            continue;
+
+        if(merged > 0) {
+            XRectangle* last = &rects[merged - 1];
+            if(same_band(last, &rects[i]) && rects[i].x <= last->x + last->width) {
+                int right = rects[i].x + rects[i].width;
+                if(right > last->x + last->width)
+                    last->width = right - last->x;
+                continue;
+            }
+        }
+        rects[merged++] = rects[i];
+    }
+    count = merged;
+
+    // Now every band is a sorted list of separate spans
+    merged = 0;
+    size_t above = 0;
+    size_t above_len = 0;
+    for(size_t i = 0; i < count; ) {
+        size_t len = band_length(rects, i, count);
+
+        if(above_len > 0 && continues_band(&rects[above], above_len, &rects[i], len)) {
+            for(size_t j = 0; j < above_len; j++) {
+                rects[above + j].height += rects[i].height;
+            }
+        } else {
+            memmove(&rects[merged], &rects[i], len * sizeof(XRectangle));
+            above = merged;
+            above_len = len;
+            merged += len;
+        }
+
+        i += len;
+    }
+
+    return merged;
+}
+
 static void convert_xrects_to_relative_rect(XRectangle* rects, size_t rect_count, Vector2* extents, Vector2* offset, Vector* mrects) {
     // Convert the XRectangles into application specific (and non-scaled) rectangles
     for(int i = 0; i < rect_count; i++) {
@@ -73,13 +163,14 @@ void shapesystem_updateShapes(Swiss* em, struct X11Context* xcontext) {
             XRectangle default_clip = {.x = offset.x, .y = offset.y, .width = extents.x, .height = extents.y};
             XserverRegion default_clip_region = XFixesCreateRegionH(xcontext->display, &default_clip, 1);
             XFixesIntersectRegionH(xcontext->display, window_region, window_region, default_clip_region);
-            XFixesDestroyRegion(xcontext->display, default_clip_region);
+            XFixesDestroyRegionH(xcontext->display, default_clip_region);
 
             int rect_count;
             XRectangle* rects = XFixesFetchRegionH(xcontext->display, window_region, &rect_count);
 
             XFixesDestroyRegionH(xcontext->display, window_region);
 
+            rect_count = merge_bands(rects, rect_count);
             vector_init(&shapeDamaged->rects, sizeof(struct Rect), rect_count);
 
             convert_xrects_to_relative_rect(rects, rect_count, &extents, &offset, &shapeDamaged->rects);
@@ -95,22 +186,60 @@ void shapesystem_updateShapes(Swiss* em, struct X11Context* xcontext) {
             struct ShapeDamagedEvent* shapeDamaged = swiss_getComponent(em, COMPONENT_SHAPE_DAMAGED, it.id);
             assert(shapeDamaged->rects.elementSize != 0);
 
-            if(shaped->face != NULL) {
-                face_unload_file(shaped->face);
-                free(shaped->face);
+            // Reshaping keeps the face, so we don't have to make new buffers
+            // every time
+            if(shaped->face == NULL) {
+                shaped->face = malloc(sizeof(struct face));
+                face_init_rects(shaped->face, &shapeDamaged->rects);
+            } else {
+                face_set_rects(shaped->face, &shapeDamaged->rects);
             }
-
-            struct face* face = malloc(sizeof(struct face));
-            // Triangulate the rectangles into a triangle vertex stream
-            face_init_rects(face, &shapeDamaged->rects);
             vector_kill(&shapeDamaged->rects);
-            face_upload(face);
-
-            shaped->face = face;
+            face_upload(shaped->face);
         }
     }
 }
 
+// Does the shape cover the whole window? The face is built from the relative
+// rectangles, so that's a single rectangle from 0 to 1.
+bool shapesystem_isRectangular(Swiss* em, win_id wid) {
+    struct ShapedComponent* shaped = swiss_getComponent(em, COMPONENT_SHAPED, wid);
+    if(shaped->face == NULL)
+        return false;
+
+    // A rectangle is four corners of 3 floats
+    const Vector* vertices = &shaped->face->vertex_buffer;
+    if(vector_size(vertices) != 4 * 3)
+        return false;
+
+    // The first three corners are the upper left, lower left and upper right
+    const float* vertex = vector_get(vertices, 0);
+    return vertex[0] <= 0.0 && vertex[1] >= 1.0
+        && vertex[4] <= 0.0
+        && vertex[6] >= 1.0;
+}
+
+// Put the rectangles of the shape on the screen, in X coordinates. The face
+// stores each rectangle as four corners, flipped and relative to the window.
+void shapesystem_screenRects(Swiss* em, win_id wid, Vector* rects) {
+    struct ShapedComponent* shaped = swiss_getComponent(em, COMPONENT_SHAPED, wid);
+    struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, wid);
+    if(shaped->face == NULL)
+        return;
+
+    const Vector* vertices = &shaped->face->vertex_buffer;
+    for(size_t i = 0; i + 4 * 3 <= vector_size(vertices); i += 4 * 3) {
+        // Upper left, lower left and upper right corner
+        const float* vertex = vector_get(vertices, i);
+
+        struct Rect* rect = vector_reserve(rects, 1);
+        rect->pos.x = physical->position.x + vertex[0] * physical->size.x;
+        rect->pos.y = physical->position.y + (1.0 - vertex[1]) * physical->size.y;
+        rect->size.x = (vertex[6] - vertex[0]) * physical->size.x;
+        rect->size.y = (vertex[1] - vertex[4]) * physical->size.y;
+    }
+}
+
 void shapesystem_finish(Swiss* em) {
     // Destroy shaped components of destroyed windows
     for_components(it, em,
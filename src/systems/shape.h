@@ -4,5 +4,7 @@
 #include "xorg.h"
 
 void shapesystem_updateShapes(Swiss* em, struct X11Context* xcontext);
+bool shapesystem_isRectangular(Swiss* em, win_id wid);
+void shapesystem_screenRects(Swiss* em, win_id wid, Vector* rects);
 void shapesystem_finish(Swiss* em);
 void shapesystem_delete(Swiss* em);
@@ -1,5 +1,6 @@
 #include "systems/texture.h"
 
+#include "glstate.h"
 #include "../texture.h"
 #include "logging.h"
 #include "renderbuffer.h"
@@ -11,10 +12,12 @@
 #include "renderutil.h"
 
 DECLARE_ZONE(texture_tick);
+DECLARE_ZONE(fetch_damage);
 DECLARE_ZONE(x_communication);
 
 DECLARE_ZONE(update_textures);
 DECLARE_ZONE(update_single_texture);
+DECLARE_ZONE(texture_bytes);
 
 static struct Framebuffer fbo;
 
@@ -28,11 +31,24 @@ void texturesystem_delete() {
     framebuffer_delete(&fbo);
 }
 
+// Something is forcing a refresh of the entire window, so the partial damage
+// doesn't matter anymore
+static void damage_whole_window(Swiss* em, win_id wid) {
+    swiss_ensureComponent(em, COMPONENT_CONTENTS_DAMAGED, wid);
+
+    if(swiss_hasComponent(em, COMPONENT_DAMAGED_REGION, wid)) {
+        struct DamagedRegionComponent* region = swiss_getComponent(em, COMPONENT_DAMAGED_REGION, wid);
+        vector_kill(&region->rects);
+        swiss_removeComponent(em, COMPONENT_DAMAGED_REGION, wid);
+    }
+}
+
 static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
     zone_scope(&ZONE_update_textures);
     static const enum ComponentType req_types[] = {
         COMPONENT_BINDS_TEXTURE,
         COMPONENT_TEXTURED,
+        COMPONENT_REDIRECTED,
         COMPONENT_CONTENTS_DAMAGED,
         CQ_END
     };
@@ -44,13 +60,13 @@ static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
     framebuffer_resetTarget(&fbo);
     framebuffer_bind(&fbo);
 
-    glEnable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
-    glDisable(GL_BLEND);
+    glstate_enable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
+    glstate_disable(GL_BLEND);
 
-    glStencilMask(0xFF);
-    glStencilFunc(GL_ALWAYS, 1, 0xFF);
-    glStencilOp(GL_ZERO, GL_ZERO, GL_REPLACE);
+    glstate_stencilMask(0xFF);
+    glstate_stencilFunc(GL_ALWAYS, 1, 0xFF);
+    glstate_stencilOp(GL_ZERO, GL_ZERO, GL_REPLACE);
 
     struct shader_program* program = assets_load("stencil.shader");
     if(program->shader_type_info != &stencil_info) {
@@ -73,6 +89,7 @@ static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
     zone_enter(&ZONE_x_communication);
     // XGrabServer(xcontext->display);
     glXWaitX();
+    xorg_awaitRendering(xcontext);
     zone_leave(&ZONE_x_communication);
 
     struct WindowDrawable** drawables = malloc(sizeof(struct WindowDrawable*) * em->size);
@@ -80,20 +97,15 @@ static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
     {
         for_componentsArr(it2, em, req_types) {
             struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, it2.id);
+            // A pixmap we haven't had before has never been copied, so the
+            // damage since the last copy is meaningless.
+            if(!bindsTexture->drawable.attached)
+                damage_whole_window(em, it2.id);
             drawables[drawable_count] = &bindsTexture->drawable;
             drawable_count++;
         }
     }
 
-    for_componentsArr(it2, em, req_types) {
-        struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, it2.id);
-
-        XSyncFence fence = XSyncCreateFence(xcontext->display, bindsTexture->drawable.wid, false);
-        XSyncTriggerFence(xcontext->display, fence);
-        XSyncAwaitFence(xcontext->display, &fence, 1);
-        XSyncDestroyFence(xcontext->display, fence);
-    }
-
     zone_enter(&ZONE_x_communication);
     if(!wd_bind(xcontext, drawables, drawable_count)) {
         // If we fail to bind we just assume that the window must have been
@@ -107,6 +119,10 @@ static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
 
     glClearColor(0, 0, 0, 0);
 
+    // Texels written by full and partial refreshes, for the profiler
+    size_t full_bytes = 0;
+    size_t partial_bytes = 0;
+
     for_componentsArr(it2, em, req_types) {
         zone_scope(&ZONE_update_single_texture);
 
@@ -118,8 +134,6 @@ static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
         framebuffer_targetRenderBuffer_stencil(&fbo, &textured->stencil);
         framebuffer_rebind(&fbo);
 
-        glClear(GL_COLOR_BUFFER_BIT);
-
         Vector2 offset = textured->texture.size;
         vec2_sub(&offset, &bindsTexture->drawable.texture.size);
 
@@ -132,8 +146,39 @@ static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
             texture_bind(&bindsTexture->drawable.texture, GL_TEXTURE0);
 
             shader_set_uniform_bool(shader_type->flip, bindsTexture->drawable.texture.flipped);
+        }
 
-            draw_rect(shaped->face, shader_type->mvp, (Vector3){{0, offset.y, 0}}, bindsTexture->drawable.texture.size);
+        if(!swiss_hasComponent(em, COMPONENT_DAMAGED_REGION, it2.id)) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            if(bindsTexture->drawable.bound) {
+                draw_rect(shaped->face, shader_type->mvp, (Vector3){{0, offset.y, 0}}, bindsTexture->drawable.texture.size);
+            }
+            full_bytes += textured->texture.size.x * textured->texture.size.y * 4;
+        } else {
+            // Only refresh the parts that changed. The rest of the texture
+            // still has the old (and correct) contents.
+            struct DamagedRegionComponent* region = swiss_getComponent(em, COMPONENT_DAMAGED_REGION, it2.id);
+
+            glstate_enable(GL_SCISSOR_TEST);
+            size_t index;
+            struct Rect* rect = vector_getFirst(&region->rects, &index);
+            while(rect != NULL) {
+                // The region is top-down, the texture is bottom-up
+                glScissor(
+                    rect->pos.x,
+                    textured->texture.size.y - rect->pos.y - rect->size.y,
+                    rect->size.x,
+                    rect->size.y
+                );
+                glClear(GL_COLOR_BUFFER_BIT);
+                if(bindsTexture->drawable.bound) {
+                    draw_rect(shaped->face, shader_type->mvp, (Vector3){{0, offset.y, 0}}, bindsTexture->drawable.texture.size);
+                }
+                partial_bytes += rect->size.x * rect->size.y * 4;
+
+                rect = vector_getNext(&region->rects, &index);
+            }
+            glstate_disable(GL_SCISSOR_TEST);
         }
 
         view = old_view;
@@ -149,8 +194,10 @@ static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
         }
     }
 
-    glDisable(GL_STENCIL_TEST);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    zone_insta_extra(&ZONE_texture_bytes, "full %zu, partial %zu bytes", full_bytes, partial_bytes);
+
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_stencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 
     zone_enter(&ZONE_x_communication);
     // XUngrabServer(xcontext->display);
@@ -158,6 +205,68 @@ static void update_window_textures(Swiss* em, struct X11Context* xcontext) {
     zone_leave(&ZONE_x_communication);
 }
 
+struct DamageRequest {
+    win_id wid;
+    xcb_xfixes_fetch_region_cookie_t cookie;
+};
+
+static void fetch_damage(Swiss* em, struct X11Context* xcontext) {
+    zone_scope(&ZONE_fetch_damage);
+
+    // Send every request before waiting for any of the replies, so we only
+    // wait for a single round trip
+    Vector requests;
+    vector_init(&requests, sizeof(struct DamageRequest), 8);
+    for_components(it, em,
+            COMPONENT_CONTENTS_DAMAGED, COMPONENT_TRACKS_WINDOW, COMPONENT_PHYSICAL, CQ_NOT, COMPONENT_DAMAGED_REGION, CQ_END) {
+        struct TracksWindowComponent* tracksWindow = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, it.id);
+
+        struct DamageRequest request = {.wid = it.id};
+        if(xorg_requestDamage(xcontext, tracksWindow->id, &request.cookie))
+            vector_putBack(&requests, &request);
+    }
+
+    Vector rects;
+    vector_init(&rects, sizeof(XRectangle), 8);
+    for(size_t j = 0; j < vector_size(&requests); j++) {
+        struct DamageRequest* request = vector_get(&requests, j);
+        struct TracksWindowComponent* tracksWindow = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, request->wid);
+        struct PhysicalComponent* phy = swiss_getComponent(em, COMPONENT_PHYSICAL, request->wid);
+
+        if(!xorg_collectDamage(xcontext, request->cookie, &rects)) {
+            // We don't know what was damaged, so we have to assume all of it
+            continue;
+        }
+
+        size_t rect_count = vector_size(&rects);
+        struct DamagedRegionComponent* region = swiss_addComponent(em, COMPONENT_DAMAGED_REGION, request->wid);
+        vector_init(&region->rects, sizeof(struct Rect), rect_count > 0 ? rect_count : 1);
+
+        // The damage is relative to the inside of the border, but our textures
+        // include it.
+        float border = tracksWindow->border_size;
+        for(size_t i = 0; i < rect_count; i++) {
+            XRectangle* damaged = vector_get(&rects, i);
+            Vector2 min = {{damaged->x + border, damaged->y + border}};
+            Vector2 max = {{min.x + damaged->width, min.y + damaged->height}};
+
+            const Vector2 zero = {{0, 0}};
+            vec2_clamp(&min, &zero, &phy->size);
+            vec2_clamp(&max, &zero, &phy->size);
+
+            if(min.x >= max.x || min.y >= max.y)
+                continue;
+
+            struct Rect* rect = vector_reserve(&region->rects, 1);
+            rect->pos = min;
+            rect->size = max;
+            vec2_sub(&rect->size, &min);
+        }
+    }
+    vector_kill(&rects);
+    vector_kill(&requests);
+}
+
 static void delete_textures(Swiss* em, enum ComponentType* query) {
     for_componentsArr(it, em, query) {
         struct BindsTextureComponent* b = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, it.id);
@@ -170,6 +279,8 @@ static void delete_textures(Swiss* em, enum ComponentType* query) {
 void texturesystem_tick(Swiss* em, struct X11Context* xcontext) {
     zone_scope(&ZONE_texture_tick);
 
+    fetch_damage(em, xcontext);
+
     // Mapping a window causes it to bind from X
     for_components(it, em,
             COMPONENT_MAP, COMPONENT_TRACKS_WINDOW, COMPONENT_REDIRECTED, CQ_NOT, COMPONENT_BINDS_TEXTURE, CQ_END) {
@@ -199,6 +310,14 @@ void texturesystem_tick(Swiss* em, struct X11Context* xcontext) {
         COMPONENT_BINDS_TEXTURE, COMPONENT_BYPASS, CQ_END
     });
 
+    // The pixmap stops following the window once it's unredirected, we will
+    // name a new one when it's redirected again
+    for_components(it, em,
+            COMPONENT_BINDS_TEXTURE, COMPONENT_UNREDIRECTED, CQ_END) {
+        struct BindsTextureComponent* b = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, it.id);
+        wd_invalidate(&b->drawable);
+    }
+
     // Resize textures when mapping a window with a texture
     for_components(it, em,
             COMPONENT_MAP, COMPONENT_PHYSICAL, COMPONENT_REDIRECTED, COMPONENT_TEXTURED, CQ_END) {
@@ -240,7 +359,7 @@ void texturesystem_tick(Swiss* em, struct X11Context* xcontext) {
     // We just added a texture, that means we have to refill it
     for_components(it, em,
             COMPONENT_MAP, COMPONENT_TEXTURED, COMPONENT_BINDS_TEXTURE, CQ_END) {
-        swiss_ensureComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+        damage_whole_window(em, it.id);
     }
 
     // Resizing a window requires a new texture
@@ -253,9 +372,18 @@ void texturesystem_tick(Swiss* em, struct X11Context* xcontext) {
         renderbuffer_resize(&textured->stencil, &resize->newSize);
     }
 
+    // The server gives the window a new backing pixmap when it's resized, so
+    // the one we hold on to is stale.
+    for_components(it, em,
+            COMPONENT_RESIZE, COMPONENT_BINDS_TEXTURE, CQ_END) {
+        struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, it.id);
+
+        wd_invalidate(&bindsTexture->drawable);
+    }
+
     for_components(it, em,
             COMPONENT_RESIZE, CQ_END) {
-        swiss_ensureComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+        damage_whole_window(em, it.id);
     }
 
     update_window_textures(em, xcontext);
@@ -4,10 +4,12 @@
 
 #include "logging.h"
 #include "window.h"
+#include "systems/shape.h"
 
 #include <string.h>
 
 DECLARE_ZONE(make_cutout);
+DECLARE_ZONE(unredirect_fullscreen);
 
 static winprop_t wid_get_prop(struct X11Context* xcontext, Window w, Atom atom, long offset, long length, Atom rtype, int rformat) {
     Atom type = None;
@@ -242,7 +244,7 @@ void xorgsystem_fill_wintype(Swiss* em, session_t* ps) {
     }
 }
 
-void xorgsystem_tick(Swiss* em, struct X11Context* xcontext, struct Atoms* atoms, Vector2* canvas_size) {
+void xorgsystem_tick(Swiss* em, struct X11Context* xcontext, struct Atoms* atoms) {
     for_components(it, em,
             COMPONENT_WINTYPE_CHANGE, CQ_END) {
         struct WintypeChangedComponent* wintypeChanged = swiss_getComponent(em, COMPONENT_WINTYPE_CHANGE, it.id);
@@ -253,7 +255,119 @@ void xorgsystem_tick(Swiss* em, struct X11Context* xcontext, struct Atoms* atoms
 
     doMap(em, xcontext, atoms);
     doUnmap(em, xcontext, atoms);
+}
+
+// Windows fading in or out are still on screen
+static bool win_visible(Swiss* em, win_id wid) {
+    struct StatefulComponent* stateful = swiss_getComponent(em, COMPONENT_STATEFUL, wid);
+    return stateful->state != STATE_INVISIBLE && stateful->state != STATE_DESTROYED;
+}
+
+// Can X draw the window directly without anyone noticing? It has to look
+// exactly like it would if we drew it, and hide everything below it.
+static bool can_unredirect(Swiss* em, win_id wid, Vector2* canvas_size) {
+    if(!swiss_hasComponent(em, COMPONENT_TRACKS_WINDOW, wid)
+            || !swiss_hasComponent(em, COMPONENT_PHYSICAL, wid)
+            || !swiss_hasComponent(em, COMPONENT_SHAPED, wid)
+            || !swiss_hasComponent(em, COMPONENT_BINDS_TEXTURE, wid))
+        return false;
+
+    // Windows that bypass us on their own are already unredirected
+    if(!swiss_hasComponent(em, COMPONENT_REDIRECTED, wid)
+            && !swiss_hasComponent(em, COMPONENT_UNREDIRECTED, wid))
+        return false;
+
+    struct StatefulComponent* stateful = swiss_getComponent(em, COMPONENT_STATEFUL, wid);
+    if(stateful->state != STATE_ACTIVE && stateful->state != STATE_INACTIVE)
+        return false;
+
+    if(swiss_hasComponent(em, COMPONENT_OPACITY, wid)
+            || swiss_hasComponent(em, COMPONENT_BGOPACITY, wid)
+            || swiss_hasComponent(em, COMPONENT_TRANSITIONING, wid))
+        return false;
+
+    if(swiss_hasComponent(em, COMPONENT_DIM, wid)) {
+        struct DimComponent* dim = swiss_getComponent(em, COMPONENT_DIM, wid);
+        if(dim->dim < 100.0)
+            return false;
+    }
+
+    // X shows an ARGB window as if it was opaque, while we blend it with
+    // what is below
+    struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, wid);
+    if(wd_hasAlpha(&bindsTexture->drawable))
+        return false;
+
+    struct TracksWindowComponent* tracksWindow = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, wid);
+    if(tracksWindow->border_size != 0)
+        return false;
+
+    struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, wid);
+    if(physical->position.x > 0 || physical->position.y > 0)
+        return false;
+    if(physical->position.x + physical->size.x < canvas_size->x
+            || physical->position.y + physical->size.y < canvas_size->y)
+        return false;
+
+    return shapesystem_isRectangular(em, wid);
+}
+
+// The top window, if it covers the entire screen. -1 otherwise
+static win_id find_fullscreen(Swiss* em, Vector* order, Vector2* canvas_size) {
+    size_t index;
+    win_id* wid = vector_getLast(order, &index);
+    while(wid != NULL) {
+        if(win_visible(em, *wid))
+            break;
+        wid = vector_getPrev(order, &index);
+    }
+
+    // Nothing else can be on top, so it only makes sense for the top window
+    if(wid == NULL || !can_unredirect(em, *wid, canvas_size))
+        return -1;
+
+    return *wid;
+}
+
+void xorgsystem_updateRedirection(Swiss* em, struct X11Context* xcontext, Vector* order, Vector2* canvas_size, bool unredirFullscreen) {
+    {
+        zone_scope(&ZONE_unredirect_fullscreen);
+        win_id fullscreen = unredirFullscreen ? find_fullscreen(em, order, canvas_size) : -1;
+
+        // Take the window back as soon as it stops being the fullscreen
+        // window. Unmapped windows are left alone, they are redirected
+        // again when they map.
+        for_components(it, em,
+                COMPONENT_UNREDIRECTED, CQ_END) {
+            if(it.id == fullscreen)
+                continue;
+
+            if(win_mapped(em, it.id)
+                    && swiss_hasComponent(em, COMPONENT_TRACKS_WINDOW, it.id)
+                    && !swiss_hasComponent(em, COMPONENT_REDIRECTED, it.id)) {
+                struct TracksWindowComponent* tracksWindow = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, it.id);
+
+                XCompositeRedirectWindowH(xcontext->display, tracksWindow->id, CompositeRedirectManual);
+                swiss_addComponent(em, COMPONENT_REDIRECTED, it.id);
+                // We haven't seen any of the contents since we let go
+                swiss_ensureComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+                zone_insta_extra(&ZONE_unredirect_fullscreen, "Redirect %#010lX", tracksWindow->id);
+            }
+            swiss_removeComponent(em, COMPONENT_UNREDIRECTED, it.id);
+        }
+
+        if(fullscreen != -1 && swiss_hasComponent(em, COMPONENT_REDIRECTED, fullscreen)) {
+            struct TracksWindowComponent* tracksWindow = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, fullscreen);
+
+            XCompositeUnredirectWindowH(xcontext->display, tracksWindow->id, CompositeRedirectManual);
+            swiss_removeComponent(em, COMPONENT_REDIRECTED, fullscreen);
+            swiss_addComponent(em, COMPONENT_UNREDIRECTED, fullscreen);
+            zone_insta_extra(&ZONE_unredirect_fullscreen, "Unredirect %#010lX", tracksWindow->id);
+        }
+    }
 
+    // The overlay covers everything we don't redirect, which includes the
+    // fullscreen window. With that on top there's nothing left of it.
     {
         zone_scope(&ZONE_make_cutout);
         XserverRegion newShape = XFixesCreateRegionH(xcontext->display, NULL, 0);
@@ -263,7 +377,7 @@ void xorgsystem_tick(Swiss* em, struct X11Context* xcontext, struct Atoms* atoms
             struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, it.id);
 
             if(win_mapped(em, it.id)) {
-                XserverRegion windowRegion = XFixesCreateRegionFromWindow(xcontext->display, tracksWindow->id, ShapeBounding);
+                XserverRegion windowRegion = XFixesCreateRegionFromWindowH(xcontext->display, tracksWindow->id, ShapeBounding);
                 // @HACK: I'm not quite sure why I need to add 2 times the
                 // border here. One makes sense since i'm subtracting that
                 // from the positioin in the X11 layer.
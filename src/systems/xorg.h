@@ -8,4 +8,5 @@
 struct _session_t;
 
 void xorgsystem_fill_wintype(Swiss* em, struct _session_t* ps);
-void xorgsystem_tick(Swiss* em, struct X11Context* xcontext, struct Atoms* atoms, Vector2* canvas_size);
+void xorgsystem_tick(Swiss* em, struct X11Context* xcontext, struct Atoms* atoms);
+void xorgsystem_updateRedirection(Swiss* em, struct X11Context* xcontext, Vector* order, Vector2* canvas_size, bool unredirFullscreen);
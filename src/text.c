@@ -1,5 +1,6 @@
 #include "text.h"
 
+#include "glstate.h"
 #include "assets/assets.h"
 #include "assets/shader.h"
 
@@ -106,9 +107,9 @@ void text_draw(const struct Font* font, const char* text, const Vector2* positio
 
 void text_draw_colored(const struct Font* font, const char* text, const Vector2* position, const Vector2* scale, const Vector3* color) {
     zone_enter(&ZONE_paint_text);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+    glstate_enable(GL_BLEND);
+    glstate_blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glstate_blendEquationSeparate(GL_FUNC_ADD, GL_MAX);
     struct face* face = assets_load("window.face");
 
     struct shader_program* text_program = assets_load("text.shader");
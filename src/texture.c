@@ -1,5 +1,7 @@
 #include "texture.h"
 
+#include "glstate.h"
+
 #include <stdio.h>
 #include <assert.h>
 
@@ -16,7 +18,7 @@ static GLuint generate_texture(GLenum tex_tgt, GLint format, const Vector2* size
     if (!tex)
         return 0;
 
-    glBindTexture(tex_tgt, tex);
+    glstate_bindTexture(GL_TEXTURE0, tex_tgt, tex);
     glTexParameteri(tex_tgt, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(tex_tgt, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(tex_tgt, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -44,7 +46,7 @@ int texture_init_noise(struct Texture* texture, GLenum target) {
     glGenTextures(1, &texture->gl_texture);
     if(!texture->gl_texture)
         return 1;
-    glBindTexture(target, texture->gl_texture);
+    glstate_bindTexture(GL_TEXTURE0, target, texture->gl_texture);
     glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -133,9 +135,9 @@ void texture_resize(struct Texture* texture, const Vector2* size) {
     zone_scope(&ZONE_texture_resize);
     assert(texture_initialized(texture));
 
-    glBindTexture(texture->target, texture->gl_texture);
+    glstate_bindTexture(GL_TEXTURE0, texture->target, texture->gl_texture);
     glTexImage2D(texture->target, 0, GL_RGBA, size->x, size->y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glBindTexture(texture->target, 0);
+    glstate_bindTexture(GL_TEXTURE0, texture->target, 0);
 
     texture->hasSpace = true;
     texture->size = *size;
@@ -143,6 +145,7 @@ void texture_resize(struct Texture* texture, const Vector2* size) {
 
 void texture_delete(struct Texture* texture) {
     glDeleteTextures(1, &texture->gl_texture);
+    glstate_forgetTexture(texture->gl_texture);
     texture->gl_texture = 0;
     texture->target = 0;
     texture->size.x = 0;
@@ -160,11 +163,10 @@ int texture_read_from(struct Texture* texture, GLuint framebuffer,
         return 1;
     }
 
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glstate_bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
     glReadBuffer(buffer);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(texture->target, texture->gl_texture);
+    glstate_bindTexture(GL_TEXTURE0, texture->target, texture->gl_texture);
 
     if (size->x <= 0 && size->y <= 0) {
         return 1;
@@ -180,7 +182,7 @@ int texture_read_from(struct Texture* texture, GLuint framebuffer,
 int texture_bind_to_framebuffer(struct Texture* texture, GLuint framebuffer,
         GLenum buffer) {
     assert(texture->hasSpace);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glstate_bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
     glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
             texture->target, texture->gl_texture, 0);
 
@@ -207,6 +209,5 @@ void texture_bind(const struct Texture* texture, GLenum unit) {
     assert(texture != NULL);
     assert(texture_initialized(texture));
 
-    glActiveTexture(unit);
-    glBindTexture(texture->target, texture->gl_texture);
+    glstate_bindTexture(unit, texture->target, texture->gl_texture);
 }
@@ -3,6 +3,7 @@
 
 #include "textureeffects.h"
 
+#include "glstate.h"
 #include "framebuffer.h"
 
 #include "renderutil.h"
@@ -34,9 +35,9 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
     shader_use(downscale_program);
 
     // Disable the options. We will restore later
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
+    glstate_disable(GL_DEPTH_TEST);
 
     Matrix old_view = view;
     view = mat4_orthogonal(0, 1, 0, 1, -1, 1);
@@ -126,8 +127,8 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
     struct shader_program* upsample_program = assets_load("upsample.shader");
     if(upsample_program->shader_type_info != &upsample_info) {
         printf("Shader was not a upsample shader");
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        glstate_bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glstate_bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
         view = old_view;
         return false;
     }
@@ -199,8 +200,8 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
         }
     }
 
-    glDepthMask(GL_TRUE);
-    glStencilMask(255);
+    glstate_depthMask(GL_TRUE);
+    glstate_stencilMask(255);
 
     view = old_view;
     return true;
@@ -252,9 +253,9 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
     framebuffer_bind(buffer);
 
     // Disable the options. We will restore later
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
+    glstate_disable(GL_DEPTH_TEST);
 
     struct shader_program* downscale_program = assets_load("downscale.shader");
     if(downscale_program->shader_type_info != &downsample_info) {
@@ -336,8 +337,8 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
     struct shader_program* upsample_program = assets_load("upsample.shader");
     if(upsample_program->shader_type_info != &upsample_info) {
         printf("Shader was not a upsample shader");
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        glstate_bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glstate_bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
         vector_kill(&otherBlurVec);
         return false;
     }
@@ -19,3 +19,7 @@ double timeDiff(timestamp* t1, timestamp* t2) {
 
     return ms;
 }
+
+uint64_t timeInMicros(timestamp* stamp) {
+    return (uint64_t)stamp->tv_sec * 1000000 + stamp->tv_nsec / 1000;
+}
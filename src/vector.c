@@ -106,6 +106,13 @@ void vector_clear(Vector* vector)
     vector->size = 0;
 }
 
+void vector_truncate(Vector* vector, size_t size)
+{
+    assert(vector->elementSize != 0);
+    assert(size <= vector->size);
+    vector->size = size;
+}
+
 void vector_qsort(Vector* vector, int (*compar)(const void *, const void*, void*), void* userdata) {
     assert(vector->elementSize != 0);
     qsort_r(vector->data, vector->size, vector->elementSize, compar, userdata);
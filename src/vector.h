@@ -28,6 +28,8 @@ void* vector_get(const Vector* vector, const size_t count);
 
 void vector_remove(Vector* vector, size_t count);
 void vector_clear(Vector* vector);
+// Drop everything from index size and up
+void vector_truncate(Vector* vector, size_t size);
 void vector_qsort(Vector* vector, int (*compar)(const void *, const void*, void*), void* userdata);
 
 int vector_foreach(Vector* vector, int (*callback)(void* elem, void* userdata), void* userdata);
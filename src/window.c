@@ -1,6 +1,8 @@
 #define _GNU_SOURCE
 #include "window.h"
 
+#include "glstate.h"
+
 #include "X11/Xlib-xcb.h"
 #include "xcb/composite.h"
 
@@ -21,6 +23,7 @@
 DECLARE_ZONE(poll_visual);
 DECLARE_ZONE(name_pixmap);
 DECLARE_ZONE(bind_pixmap);
+DECLARE_ZONE(rebind_pixmap);
 
 int window_zcmp(const void* a, const void* b, void* userdata) {
     const win_id *a_wid = a;
@@ -128,7 +131,7 @@ static void win_draw_debug(session_t* ps, win* w) {
     struct face* face = assets_load("window.face");
     Vector2 scale = {{1, 1}};
 
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_DEPTH_TEST);
     Vector2 winPos;
     Vector2 pen;
     {
@@ -310,7 +313,7 @@ static void win_draw_debug(session_t* ps, win* w) {
         free(text);
     }
 
-    glEnable(GL_DEPTH_TEST);
+    glstate_enable(GL_DEPTH_TEST);
 }
 #endif
 
@@ -335,13 +338,31 @@ bool wd_bind(struct X11Context* xctx, struct WindowDrawable* drawables[], size_t
 
     xcb_connection_t* xcb = XGetXCBConnection(xctx->display);
 
+    bool success = true;
+
+    // Drawables that still hold on to their pixmap from an earlier frame just
+    // have to be rebound to get the new contents. Naming and creating the
+    // pixmaps is only needed after the drawable has been invalidated.
     xcb_pixmap_t *pixmaps = malloc(sizeof(xcb_pixmap_t) * cnt);
+    zone_enter(&ZONE_rebind_pixmap);
+    for(size_t i = 0; i < cnt; i++) {
+        pixmaps[i] = 0;
+        if(drawables[i]->attached) {
+            success &= xtexture_rebind(&drawables[i]->xtexture);
+        }
+    }
+    zone_leave(&ZONE_rebind_pixmap);
+
     zone_enter(&ZONE_name_pixmap);
     for(size_t i = 0; i < cnt; i++) {
+        if(drawables[i]->attached)
+            continue;
         pixmaps[i] = xcb_generate_id(xcb);
     }
 
     for(size_t i = 0; i < cnt; i++) {
+        if(pixmaps[i] == 0)
+            continue;
         xcb_void_cookie_t cookie = xcb_composite_name_window_pixmap_checked(xcb, drawables[i]->wid, pixmaps[i]);
         if (xcb_request_check(xcb, cookie)) {
             printf_dbgf("Can't name window pixmap. We will try to unbind the texture");
@@ -364,14 +385,14 @@ bool wd_bind(struct X11Context* xctx, struct WindowDrawable* drawables[], size_t
         }
     }
 
-    bool success = true;
     zone_enter(&ZONE_bind_pixmap);
-    success = xtexture_bind(xctx, texs, texinfos, pixmaps, cnt);
+    success &= xtexture_bind(xctx, texs, texinfos, pixmaps, cnt);
     zone_leave(&ZONE_bind_pixmap);
 
-    // We can free the pixmaps since the xtexture doesn't need it.
+    // The pixmap is kept alive along with the GLX pixmap until the drawable
+    // is invalidated. If we didn't manage to attach it we free it right away.
     for(size_t i = 0; i < cnt; i++) {
-        if(pixmaps[i] != 0) {
+        if(pixmaps[i] != 0 && !drawables[i]->attached) {
             xcb_free_pixmap(xcb, pixmaps[i]);
         }
     }
@@ -385,10 +406,30 @@ bool wd_bind(struct X11Context* xctx, struct WindowDrawable* drawables[], size_t
 bool wd_unbind(struct WindowDrawable* drawable) {
     assert(drawable != NULL);
 
-    xtexture_unbind(&drawable->xtexture);
+    xtexture_release(&drawable->xtexture);
     return true;
 }
 
+void wd_invalidate(struct WindowDrawable* drawable) {
+    assert(drawable != NULL);
+
+    if(!drawable->attached)
+        return;
+
+    xcb_connection_t* xcb = XGetXCBConnection(drawable->context->display);
+    xcb_pixmap_t pixmap = drawable->pixmap;
+    xtexture_unbind(&drawable->xtexture);
+    xcb_free_pixmap(xcb, pixmap);
+}
+
+bool wd_hasAlpha(const struct WindowDrawable* drawable) {
+    assert(drawable != NULL);
+
+    // The same test xtexture_bind uses to pick an RGBA texture format
+    return (drawable->texinfo.hasRGBA && drawable->texinfo.rgbAlpha != 0)
+        || drawable->depth == 32;
+}
+
 void wd_delete(struct WindowDrawable* drawable) {
     assert(drawable != NULL);
     // In debug mode we want to crash if we do this.
@@ -396,5 +437,6 @@ void wd_delete(struct WindowDrawable* drawable) {
     if(drawable->bound) {
         wd_unbind(drawable);
     }
+    wd_invalidate(drawable);
     texture_delete(&drawable->texture);
 }
@@ -158,6 +158,15 @@ struct ShapeDamagedEvent {
     Vector rects;
 };
 
+// The parts of a window that changed this frame. Only present next to
+// COMPONENT_CONTENTS_DAMAGED, and only when we know the damage is partial.
+// Without it the entire window is damaged.
+struct DamagedRegionComponent {
+    // struct Rect in pixels from the top left corner of the window, including
+    // the border
+    Vector rects;
+};
+
 extern const char* const StateNames[];
 
 enum WindowState {
@@ -213,3 +222,8 @@ void wd_delete(struct WindowDrawable* drawable);
 
 bool wd_bind(struct X11Context* xctx, struct WindowDrawable* drawables[], size_t cnt);
 bool wd_unbind(struct WindowDrawable* drawable);
+// Drop the pixmap kept alive between binds. It has to be named again next time
+// the drawable is bound.
+void wd_invalidate(struct WindowDrawable* drawable);
+// Does the visual of the window carry alpha? Known before the first bind.
+bool wd_hasAlpha(const struct WindowDrawable* drawable);
@@ -1,16 +1,19 @@
 #include "windowlist.h"
 
+#include "glstate.h"
 #include "profiler/zone.h"
 
 #include "assets/shader.h"
 #include "assets/assets.h"
 
 #include "systems/blur.h"
+#include "systems/shape.h"
 
 #include "textureeffects.h"
 
 #include "window.h"
 #include "renderutil.h"
+#include "buffer.h"
 
 DECLARE_ZONE(paint_backgrounds);
 DECLARE_ZONE(paint_tints);
@@ -18,11 +21,56 @@ DECLARE_ZONE(paint_windows);
 DECLARE_ZONE(paint_transparents);
 
 DECLARE_ZONE(paint_window);
+DECLARE_ZONE(paint_batch);
 
 DECLARE_ZONE(paint_debug);
 DECLARE_ZONE(paint_debugFaders);
 DECLARE_ZONE(paint_debugProps);
 
+// Windows drawn by a single instanced draw. Unit 0 holds the instance buffer
+// and the rest hold the window textures. GL 3.2 only promises 16 units in the
+// fragment shader.
+#define BATCH_TEXTURES 15
+
+// The layout has to match batch.vs
+struct WindowInstance {
+    // x, y, z and the texture slot
+    Vector4 place;
+    Vector4 size;
+    // opacity, dim and flip
+    Vector4 params;
+};
+
+// The instances are written into the stream buffer. When that's full we fall
+// back to respecifying a buffer of our own.
+static struct BufferObject instance_bo;
+static struct Texture instance_tex;
+static struct Texture stream_tex;
+static Vector instances;
+
+void windowlist_init(struct RingBuffer* stream) {
+    vector_init(&instances, sizeof(struct WindowInstance), 64);
+    if(bo_init(&instance_bo, sizeof(struct WindowInstance) * 64) != 0) {
+        printf_errf("Failed initializing the window instance buffer");
+        return;
+    }
+    if(texture_init_buffer(&instance_tex, 0, &instance_bo, GL_RGBA32F) != 0) {
+        printf_errf("Failed initializing the window instance texture");
+        return;
+    }
+    if(texture_init_buffer(&stream_tex, 0, &stream->bo, GL_RGBA32F) != 0) {
+        printf_errf("Failed initializing the stream texture");
+        return;
+    }
+}
+
+void windowlist_delete() {
+    vector_kill(&instances);
+    texture_delete(&stream_tex);
+    texture_delete(&instance_tex);
+    bo_delete(&instance_bo);
+}
+
 Vector2 X11_rectpos_to_gl(Vector2 *canvas, const Vector2* xpos, const Vector2* size) {
     Vector2 glpos = {{
         xpos->x, canvas->y - xpos->y - size->y
@@ -32,8 +80,8 @@ Vector2 X11_rectpos_to_gl(Vector2 *canvas, const Vector2* xpos, const Vector2* s
 
 void windowlist_drawBackground(session_t* ps, Vector* opaque) {
     zone_enter(&ZONE_paint_backgrounds);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
+    glstate_enable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_TRUE);
 
     struct shader_program* shader = assets_load("bgblit.shader");
     if(shader->shader_type_info != &bgblit_info) {
@@ -76,19 +124,94 @@ void windowlist_drawBackground(session_t* ps, Vector* opaque) {
         }
     }
 
-    glDepthMask(GL_FALSE);
-    glDisable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_FALSE);
+    glstate_disable(GL_DEPTH_TEST);
     zone_leave(&ZONE_paint_backgrounds);
 }
 
+uint32_t windowlist_features(Swiss* em, win_id wid) {
+    uint32_t features = 0;
+    bool textured = swiss_hasComponent(em, COMPONENT_TEXTURED, wid);
+    // Windows without a background opacity are fading, and we only draw
+    // their shadow
+    bool render_content = swiss_hasComponent(em, COMPONENT_BGOPACITY, wid);
+
+    if(textured && render_content && swiss_hasComponent(em, COMPONENT_BLUR, wid))
+        features |= WINDOW_FEATURE_BACKGROUND;
+    if(render_content && swiss_hasComponent(em, COMPONENT_TINT, wid))
+        features |= WINDOW_FEATURE_TINT;
+    if(render_content && textured)
+        features |= WINDOW_FEATURE_CONTENT;
+
+    return features;
+}
+
+// Background, tint and content of a window in a single pass. Drawing them one
+// after the other fills the whole window up to three times.
+static void draw_window_combined(session_t* ps, struct shader_program* program, win_id wid, uint32_t features) {
+    struct WindowShader* shader_type = program->shader_type;
+
+    struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, wid);
+    struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, wid);
+    struct ZComponent* z = swiss_getComponent(&ps->win_list, COMPONENT_Z, wid);
+    struct OpacityComponent* opacity = swiss_godComponent(&ps->win_list, COMPONENT_OPACITY, wid);
+    double effective_opacity = (opacity != NULL ? opacity->opacity : 100.0) / 100.0;
+
+    zone_enter_extra(&ZONE_paint_window, "%s", "<unknown>");
+
+    shader_set_future_uniform_int(shader_type->features, features);
+    shader_set_future_uniform_sampler(shader_type->bg_tex, 0);
+    shader_set_future_uniform_sampler(shader_type->win_tex, 1);
+    shader_set_future_uniform_float(shader_type->opacity, effective_opacity);
+
+    if(features & WINDOW_FEATURE_BACKGROUND) {
+        struct glx_blur_cache* blur = swiss_getComponent(&ps->win_list, COMPONENT_BLUR, wid);
+        struct OpacityComponent* bgOpacity = swiss_getComponent(&ps->win_list, COMPONENT_BGOPACITY, wid);
+
+        shader_set_future_uniform_bool(shader_type->bg_flip, blur->texture[0].flipped);
+        shader_set_future_uniform_float(shader_type->bg_opacity, bgOpacity->opacity / 100.0);
+        texture_bind(&blur->texture[0], GL_TEXTURE0);
+    }
+
+    if(features & WINDOW_FEATURE_TINT) {
+        struct TintComponent* tint = swiss_getComponent(&ps->win_list, COMPONENT_TINT, wid);
+
+        Vector3 color = tint->color.rgb;
+        vec3_imul(&color, effective_opacity);
+        shader_set_future_uniform_vec2(shader_type->window, &physical->size);
+        shader_set_future_uniform_vec3(shader_type->tint, &color);
+        shader_set_future_uniform_float(shader_type->tint_opacity, tint->color.w * effective_opacity);
+    }
+
+    // The window texture is already bound to GL_TEXTURE1
+    if(features & WINDOW_FEATURE_CONTENT) {
+        struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, wid);
+        struct DimComponent* dim = swiss_getComponent(&ps->win_list, COMPONENT_DIM, wid);
+
+        shader_set_future_uniform_bool(shader_type->flip, textured->texture.flipped);
+        shader_set_future_uniform_float(shader_type->dim, dim->dim / 100.0);
+    }
+
+    shader_use(program);
+
+    {
+        Vector2 glRectPos = X11_rectpos_to_gl(&ps->root_size, &physical->position, &physical->size);
+        Vector3 winpos = vec3_from_vec2(&glRectPos, z->z);
+
+        draw_rect(shaped->face, shader_type->mvp, winpos, physical->size);
+    }
+
+    zone_leave(&ZONE_paint_window);
+}
+
 void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
     zone_enter(&ZONE_paint_transparents);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_FALSE);
-    glEnable(GL_BLEND);
+    glstate_enable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_FALSE);
+    glstate_enable(GL_BLEND);
 
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+    glstate_blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glstate_blendEquationSeparate(GL_FUNC_ADD, GL_MAX);
 
     struct face* face = assets_load("window.face");
 
@@ -115,6 +238,12 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
 
     struct Global* global_shader_type = global_shader->shader_type;
 
+    struct shader_program* window_shader = assets_load("window.shader");
+    if(window_shader->shader_type_info != &window_info) {
+        printf_errf("Shader was not a window shader");
+        return;
+    }
+
     size_t index;
     win_id* w_id = vector_getLast(transparent, &index);
     while(w_id != NULL) {
@@ -168,9 +297,20 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
         }
 
         struct OpacityComponent* bgOpacity = swiss_godComponent(&ps->win_list, COMPONENT_BGOPACITY, *w_id);
+        uint32_t features = windowlist_features(&ps->win_list, *w_id);
+
+        // The window shader draws everything over the window rectangle, so
+        // the content has to fill exactly that.
+        if(features != 0 && (textured == NULL
+                    || (textured->texture.size.x == physical->size.x
+                        && textured->texture.size.y == physical->size.y))) {
+            draw_window_combined(ps, window_shader, *w_id, features);
+            w_id = vector_getPrev(transparent, &index);
+            continue;
+        }
 
         // Background
-        if(textured != NULL && bgOpacity != NULL && swiss_hasComponent(&ps->win_list, COMPONENT_BLUR, *w_id)) {
+        if(features & WINDOW_FEATURE_BACKGROUND) {
             struct glx_blur_cache* blur = swiss_getComponent(&ps->win_list, COMPONENT_BLUR, *w_id);
             Vector3 dglPos = vec3_from_vec2(&glPos, z->z + 0.00001);
 
@@ -191,11 +331,10 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
 
         struct OpacityComponent* opacity = swiss_godComponent(&ps->win_list, COMPONENT_OPACITY, *w_id);
 
-        bool render_content = bgOpacity != NULL;
         double effective_opacity = opacity != NULL ? opacity->opacity : 100.0;
 
         // Tint
-        if(render_content && swiss_hasComponent(&ps->win_list, COMPONENT_TINT, *w_id)) {
+        if(features & WINDOW_FEATURE_TINT) {
             struct TintComponent* tint = swiss_getComponent(&ps->win_list, COMPONENT_TINT, *w_id);
 
             {
@@ -221,7 +360,7 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
         }
 
         // Content
-        if(render_content && textured != NULL) {
+        if(features & WINDOW_FEATURE_CONTENT) {
             struct DimComponent* dim = swiss_getComponent(&ps->win_list, COMPONENT_DIM, *w_id);
 
             shader_set_future_uniform_sampler(global_shader_type->tex_scr, 1);
@@ -251,27 +390,27 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
         w_id = vector_getPrev(transparent, &index);
     }
 
-    glDisable(GL_BLEND);
-    glDepthMask(GL_TRUE);
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_BLEND);
+    glstate_depthMask(GL_TRUE);
+    glstate_disable(GL_DEPTH_TEST);
     zone_leave(&ZONE_paint_transparents);
 }
 
 void windowlist_drawTint(session_t* ps) {
     zone_enter(&ZONE_paint_tints);
-    glEnable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_FALSE);
+    glstate_enable(GL_BLEND);
+    glstate_enable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_FALSE);
 
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+    glstate_blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glstate_blendEquationSeparate(GL_FUNC_ADD, GL_MAX);
 
     struct shader_program* program = assets_load("tint.shader");
     if(program->shader_type_info != &colored_info) {
         printf_errf("Shader was not a colored shader");
-        glDepthMask(GL_TRUE);
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
+        glstate_depthMask(GL_TRUE);
+        glstate_disable(GL_DEPTH_TEST);
+        glstate_disable(GL_BLEND);
         return;
     }
     struct Colored* shader_type = program->shader_type;
@@ -282,7 +421,8 @@ void windowlist_drawTint(session_t* ps) {
 
     for_components(it, &ps->win_list,
             COMPONENT_MUD, COMPONENT_TINT, COMPONENT_PHYSICAL, COMPONENT_Z,
-            CQ_NOT, COMPONENT_OPACITY, CQ_NOT, COMPONENT_BGOPACITY, CQ_END) {
+            CQ_NOT, COMPONENT_OPACITY, CQ_NOT, COMPONENT_BGOPACITY,
+            CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
         struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, it.id);
         struct TintComponent* tint = swiss_getComponent(&ps->win_list, COMPONENT_TINT, it.id);
         struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, it.id);
@@ -302,27 +442,17 @@ void windowlist_drawTint(session_t* ps) {
         }
     }
 
-    glDepthMask(GL_TRUE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    glstate_depthMask(GL_TRUE);
+    glstate_disable(GL_DEPTH_TEST);
+    glstate_disable(GL_BLEND);
     zone_leave(&ZONE_paint_tints);
 }
 
-void windowlist_draw(session_t* ps, Vector* order) {
-    zone_enter(&ZONE_paint_windows);
-    glEnable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
-
+// Shaped windows each have their own face, so they can't share a draw
+static void draw_shaped_windows(session_t* ps, Vector* shaped_windows) {
     struct shader_program* global_program = assets_load("global.shader");
     if(global_program->shader_type_info != &global_info) {
         printf_errf("Shader was not a global shader");
-        glDepthMask(GL_TRUE);
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
         return;
     }
 
@@ -333,7 +463,7 @@ void windowlist_draw(session_t* ps, Vector* order) {
     shader_use(global_program);
 
     size_t index;
-    win_id* w_id = vector_getFirst(order, &index);
+    win_id* w_id = vector_getFirst(shaped_windows, &index);
     while(w_id != NULL) {
         struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, *w_id);
         struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, *w_id);
@@ -354,19 +484,117 @@ void windowlist_draw(session_t* ps, Vector* order) {
             Vector2 glRectPos = X11_rectpos_to_gl(&ps->root_size, &physical->position, &textured->texture.size);
             Vector3 winpos = vec3_from_vec2(&glRectPos, z->z);
 
-            /* Vector4 color = {{0.0, 1.0, 0.4, 1.0}}; */
-            /* draw_colored_rect(w->face, &winpos, &textured->texture.size, &color); */
             draw_rect(shaped->face, global_type->mvp, winpos, physical->size);
         }
 
         zone_leave(&ZONE_paint_window);
 
-        w_id = vector_getNext(order, &index);
+        w_id = vector_getNext(shaped_windows, &index);
+    }
+}
+
+// Opaque windows are depth tested against each other, so the order we draw
+// them in doesn't matter. That lets us draw all the rectangular ones with
+// one instanced draw per BATCH_TEXTURES windows.
+static void draw_window_batches(session_t* ps, Vector* batched) {
+    size_t count = vector_size(batched);
+    if(count == 0)
+        return;
+
+    struct shader_program* program = assets_load("batch.shader");
+    if(program->shader_type_info != &batch_info) {
+        printf_errf("Shader was not a batch shader");
+        return;
+    }
+    struct Batch* batch_type = program->shader_type;
+
+    struct face* face = assets_load("window.face");
+
+    vector_clear(&instances);
+    struct WindowInstance* instance = vector_reserve(&instances, count);
+    for(size_t i = 0; i < count; i++) {
+        win_id wid = *(win_id*)vector_get(batched, i);
+        struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, wid);
+        struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, wid);
+        struct DimComponent* dim = swiss_getComponent(&ps->win_list, COMPONENT_DIM, wid);
+        struct ZComponent* z = swiss_getComponent(&ps->win_list, COMPONENT_Z, wid);
+
+        Vector2 glRectPos = X11_rectpos_to_gl(&ps->root_size, &physical->position, &textured->texture.size);
+        instance[i].place = (Vector4){{glRectPos.x, glRectPos.y, z->z, i % BATCH_TEXTURES}};
+        instance[i].size = (Vector4){{physical->size.x, physical->size.y, 0, 0}};
+        instance[i].params = (Vector4){{1.0, dim->dim/100.0, textured->texture.flipped, 0}};
     }
+    // The shader finds the instances by their index, so they have to start
+    // on a whole instance
+    size_t offset;
+    size_t base = 0;
+    if(ringbuffer_write(&ps->stream, instances.data, sizeof(struct WindowInstance) * count,
+                sizeof(struct WindowInstance), &offset)) {
+        base = offset / sizeof(struct WindowInstance);
+        texture_bind(&stream_tex, GL_TEXTURE0);
+    } else {
+        bo_replace(&instance_bo, sizeof(struct WindowInstance) * count, instances.data);
+        texture_bind(&instance_tex, GL_TEXTURE0);
+    }
+
+    for(size_t first = 0; first < count; first += BATCH_TEXTURES) {
+        size_t batch_size = count - first;
+        if(batch_size > BATCH_TEXTURES)
+            batch_size = BATCH_TEXTURES;
+
+        zone_scope_extra(&ZONE_paint_batch, "%zu windows", batch_size);
+
+        for(size_t i = 0; i < batch_size; i++) {
+            win_id wid = *(win_id*)vector_get(batched, first + i);
+            struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, wid);
+            texture_bind(&textured->texture, GL_TEXTURE1 + i);
+        }
+
+        shader_set_future_uniform_sampler(batch_type->instances, 0);
+        shader_set_future_uniform_samplers(batch_type->windows, 1);
+        shader_set_future_uniform_int(batch_type->first, base + first);
+        shader_use(program);
+
+        draw_rect_instanced(face, batch_type->view, batch_size);
+    }
+}
+
+void windowlist_draw(session_t* ps, Vector* order) {
+    zone_enter(&ZONE_paint_windows);
+    glstate_enable(GL_BLEND);
+    glstate_enable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_TRUE);
+
+    glstate_blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glstate_blendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+
+    Vector batched;
+    vector_init(&batched, sizeof(win_id), 16);
+    Vector shaped;
+    vector_init(&shaped, sizeof(win_id), 8);
+
+    {
+        size_t index;
+        win_id* w_id = vector_getFirst(order, &index);
+        while(w_id != NULL) {
+            if(shapesystem_isRectangular(&ps->win_list, *w_id)) {
+                vector_putBack(&batched, w_id);
+            } else {
+                vector_putBack(&shaped, w_id);
+            }
+            w_id = vector_getNext(order, &index);
+        }
+    }
+
+    draw_window_batches(ps, &batched);
+    draw_shaped_windows(ps, &shaped);
+
+    vector_kill(&shaped);
+    vector_kill(&batched);
 
-    glDepthMask(GL_TRUE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    glstate_depthMask(GL_TRUE);
+    glstate_disable(GL_DEPTH_TEST);
+    glstate_disable(GL_BLEND);
     zone_leave(&ZONE_paint_windows);
 }
 
@@ -3,6 +3,19 @@
 #include "common.h"
 #include "swiss.h"
 
+void windowlist_init(struct RingBuffer* stream);
+void windowlist_delete();
+
+// The passes a transparent window needs on top of its shadow. The window
+// shader does all of them at once.
+enum WindowFeature {
+    WINDOW_FEATURE_BACKGROUND = 1 << 0,
+    WINDOW_FEATURE_TINT       = 1 << 1,
+    WINDOW_FEATURE_CONTENT    = 1 << 2,
+};
+
+uint32_t windowlist_features(Swiss* em, win_id wid);
+
 void windowlist_drawBackground(session_t* ps, Vector* opaque);
 void windowlist_drawTransparent(session_t* ps, Vector* transparent);
 void windowlist_drawTint(session_t* ps);
@@ -0,0 +1,54 @@
+#include "winindex.h"
+
+#include "logging.h"
+
+#include <assert.h>
+
+void winindex_init(struct WinIndex* index) {
+    index->map = NULL;
+}
+
+void winindex_delete(struct WinIndex* index) {
+    Word_t rc;
+    JLFA(rc, index->map);
+}
+
+void winindex_add(struct WinIndex* index, Window xid, win_id wid) {
+    assert(xid != 0);
+
+    Word_t* value;
+    JLI(value, index->map, xid);
+    if(value == PJERR) {
+        printf_errf("Failed allocating space for the window index");
+        return;
+    }
+    *value = wid;
+}
+
+void winindex_remove(struct WinIndex* index, Window xid, win_id wid) {
+    Word_t* value;
+    JLG(value, index->map, xid);
+    if(value == NULL || *value != wid)
+        return;
+
+    int rc;
+    JLD(rc, index->map, xid);
+}
+
+win_id winindex_find(const struct WinIndex* index, Window xid) {
+    if(xid == 0)
+        return -1;
+
+    Word_t* value;
+    JLG(value, index->map, xid);
+    if(value == NULL)
+        return -1;
+
+    return *value;
+}
+
+size_t winindex_size(const struct WinIndex* index) {
+    Word_t count;
+    JLC(count, index->map, 0, -1);
+    return count;
+}
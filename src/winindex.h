@@ -0,0 +1,27 @@
+#pragma once
+
+#include "swiss.h"
+
+#include <X11/X.h>
+#include <Judy.h>
+
+#include <stdbool.h>
+
+// Maps an X window id to the entity tracking it. Every X event we handle
+// carries an XID, so this is hit for pretty much every event. It has to stay
+// flat regardless of how many windows are open.
+struct WinIndex {
+    Pvoid_t map;
+};
+
+void winindex_init(struct WinIndex* index);
+void winindex_delete(struct WinIndex* index);
+
+// Track xid as wid. If X reused the id for a new window the old mapping is
+// overwritten.
+void winindex_add(struct WinIndex* index, Window xid, win_id wid);
+// Stop tracking xid, but only if it's still owned by wid. The id might already
+// have been reused by X.
+void winindex_remove(struct WinIndex* index, Window xid, win_id wid);
+win_id winindex_find(const struct WinIndex* index, Window xid);
+size_t winindex_size(const struct WinIndex* index);
@@ -19,9 +19,79 @@ DECLARE_ZONE(select_config);
 DECLARE_ZONE(select_config_visual);
 DECLARE_ZONE(select_config_attribs);
 DECLARE_ZONE(event_preprocess);
+DECLARE_ZONE(fill_buffer);
+DECLARE_ZONE(fill_request);
+DECLARE_ZONE(fill_resolve);
+DECLARE_ZONE(fill_batch);
+DECLARE_ZONE(coalesce);
+DECLARE_ZONE(begin_events);
+DECLARE_ZONE(scan_tree);
+DECLARE_ZONE(scan_level);
+DECLARE_ZONE(scan_build);
+DECLARE_ZONE(scan_bypass);
+DECLARE_ZONE(scan_emit);
+DECLARE_ZONE(await_fence);
 
 struct X11Context* current_xctx = NULL;
 
+enum WindowFlags {
+    // The window is a toplevel we emit events for
+    WF_ACTIVE        = 1 << 0,
+    WF_MAPPED        = 1 << 1,
+    WF_BYPASSED      = 1 << 2,
+    // The window has the client (WM_STATE) atom
+    WF_CLIENT        = 1 << 3,
+    // The client field holds the closest client in the subtree
+    WF_CLIENT_CACHED = 1 << 4,
+    // The window was configured since its last damage, see isMoveDamage
+    WF_MOVED         = 1 << 5,
+};
+
+// All the state we track for a single window. We used to keep a Judy array
+// per property, which meant a handful of lookups for every event.
+struct WindowRecord {
+    uint32_t flags;
+    // The window we are a subwindow of, 0 for toplevels
+    Window parent;
+    // Only valid while the window is active
+    Damage damage;
+    // The damage we have subtracted but the compositor hasn't fetched yet
+    XserverRegion repair;
+    // Geometry of the window in the last damage event, see isMoveDamage
+    XRectangle damageGeometry;
+    // Judy1 set of the subwindows parented to us
+    void* children;
+    // Cached result of findClosestClient, None if there's no client
+    Window client;
+};
+
+struct WindowGeometry {
+    int16_t x;
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t border;
+};
+
+enum PendingRequests {
+    PENDING_BYPASS = 1 << 0,
+    PENDING_GEOMETRY = 1 << 1,
+};
+
+// An event read from X along with the replies for the requests it needs
+// before we can process it.
+struct PendingEvent {
+    XEvent raw;
+
+    uint32_t requests;
+    xcb_get_property_cookie_t bypassCookie;
+    xcb_get_geometry_cookie_t geometryCookie;
+
+    int32_t bypass;
+    bool hasGeometry;
+    struct WindowGeometry geometry;
+};
+
 static char* eventName(struct X11Capabilities* caps, XErrorEvent* ev) {
     int o = 0;
 #define CASESTRRET2(s)   case s: return #s; break
@@ -369,14 +439,14 @@ bool xorgContext_init(struct X11Context* context, Display* display, int screen,
 
     xorgContext_capabilities(&context->capabilities, context);
 
-    context->winParent = NULL;
-    context->client = NULL;
-    context->damage = NULL;
-    context->mapped = NULL;
-    context->active = NULL;
-    context->bypassed = NULL;
+    context->windows = NULL;
     vector_init(&context->eventBuf, sizeof(struct Event), 64);
+    vector_init(&context->batch, sizeof(struct PendingEvent), 64);
     context->readCursor = 0;
+    context->coalesced = 0;
+    context->damageParts = XFixesCreateRegionH(display, NULL, 0);
+    // Fences are per screen, so any window will do
+    context->renderFence = XSyncCreateFenceH(display, context->root, false);
 
     context->atoms = atoms;
     atoms_init(atoms, context->display);
@@ -465,54 +535,149 @@ void xorgContext_delete(struct X11Context* context) {
     current_xctx = NULL;
 
     free(context->configs);
+    vector_kill(&context->batch);
+    XFixesDestroyRegionH(context->display, context->damageParts);
+    XSyncDestroyFenceH(context->display, context->renderFence);
+
+    Word_t index = 0;
+    struct WindowRecord** rec;
+    JLF(rec, context->windows, index);
+    while(rec != NULL) {
+        Word_t rc;
+        J1FA(rc, (*rec)->children);
+        if((*rec)->repair != None)
+            XFixesDestroyRegionH(context->display, (*rec)->repair);
+        free(*rec);
+        JLN(rec, context->windows, index);
+    }
+    Word_t rc;
+    JLFA(rc, context->windows);
+}
+
+static struct WindowRecord* getRecord(const struct X11Context* xctx, Window xid) {
+    struct WindowRecord** rec;
+    JLG(rec, xctx->windows, xid);
+    if(rec == NULL)
+        return NULL;
+    return *rec;
+}
+
+static struct WindowRecord* ensureRecord(struct X11Context* xctx, Window xid) {
+    struct WindowRecord** rec;
+    JLI(rec, xctx->windows, xid);
+    if(rec == PJERR) {
+        printf_errf("Malloc failed");
+        return NULL;
+    }
+
+    if(*rec == NULL) {
+        *rec = calloc(1, sizeof(struct WindowRecord));
+        if(*rec == NULL) {
+            printf_errf("Malloc failed");
+            int rc_int;
+            JLD(rc_int, xctx->windows, xid);
+            return NULL;
+        }
+    }
+
+    return *rec;
+}
+
+// Forget about a window if there's nothing left we need to remember
+static void releaseRecord(struct X11Context* xctx, Window xid, struct WindowRecord* rec) {
+    if((rec->flags & ~WF_CLIENT_CACHED) != 0)
+        return;
+    if(rec->parent != 0 || rec->children != NULL)
+        return;
+
+    free(rec);
+    int rc_int;
+    JLD(rc_int, xctx->windows, xid);
+}
+
+// The closest client of a window depends on the entire subtree below it, so
+// any change to the subtree has to invalidate the cache of every ancestor.
+static void invalidateClient(const struct X11Context* xctx, Window xid) {
+    struct WindowRecord* rec = getRecord(xctx, xid);
+    while(rec != NULL) {
+        rec->flags &= ~WF_CLIENT_CACHED;
+
+        if(rec->parent == 0)
+            break;
+        rec = getRecord(xctx, rec->parent);
+    }
 }
 
 static bool isWindowActive(const struct X11Context* xctx, Window w) {
-    Word_t rc;
-    J1T(rc, xctx->active, w);
-    return rc != 0;
+    struct WindowRecord* rec = getRecord(xctx, w);
+    return rec != NULL && (rec->flags & WF_ACTIVE) != 0;
 }
 
 static bool isWindowMapped(const struct X11Context* xctx, Window w) {
-    Word_t rc;
-    J1T(rc, xctx->mapped, w);
-    return rc != 0;
+    struct WindowRecord* rec = getRecord(xctx, w);
+    return rec != NULL && (rec->flags & WF_MAPPED) != 0;
+}
+
+static bool isWindowClient(const struct X11Context* xctx, Window w) {
+    struct WindowRecord* rec = getRecord(xctx, w);
+    return rec != NULL && (rec->flags & WF_CLIENT) != 0;
 }
 
 static bool detachSubtree(struct X11Context* xctx, Window xid) {
-    int rc_int;
-    JLD(rc_int, xctx->winParent, xid);
-    if(rc_int == JERR) {
-        printf_errf("Malloc error");
+    struct WindowRecord* rec = getRecord(xctx, xid);
+    if(rec == NULL || rec->parent == 0) {
         return false;
     }
 
-    return rc_int == 1;
+    Window parent = rec->parent;
+    rec->parent = 0;
+
+    // Remove the window from the childset of the parent
+    struct WindowRecord* parentRec = getRecord(xctx, parent);
+    if(parentRec != NULL) {
+        Word_t rc;
+        J1U(rc, parentRec->children, xid);
+        invalidateClient(xctx, parent);
+        releaseRecord(xctx, parent, parentRec);
+    }
+
+    return true;
 }
 
 static void attachSubtree(struct X11Context* xctx, Window xid, Window client_xid) {
     // Add the client->frame association
-    Window* value;
-    JLI(value, xctx->winParent, client_xid);
-    if(value == PJERR){
-        printf_errf("Malloc failed");
+    struct WindowRecord* rec = ensureRecord(xctx, client_xid);
+    if(rec == NULL) {
         return;
-    } else if(*value != 0) {
+    } else if(rec->parent != 0) {
         printf_errf("Client already had a frame?");
         return;
     }
 
-    *value = xid;
+    // And the frame->client association
+    struct WindowRecord* parentRec = ensureRecord(xctx, xid);
+    if(parentRec == NULL) {
+        return;
+    }
+
+    int rc;
+    J1S(rc, parentRec->children, client_xid);
+    if(rc == JERR) {
+        printf_errf("Malloc failed");
+        return;
+    }
+    rec->parent = xid;
+
+    invalidateClient(xctx, xid);
 }
 
 static Window findRoot(const struct X11Context* xctx, Window xid) {
-    // Add the client->frame association
-    Window* next = &xid;
-    Window last;
-    do {
-        last = *next;
-        JLG(next, xctx->winParent, last);
-    } while(next != NULL);
+    Window last = xid;
+    struct WindowRecord* rec = getRecord(xctx, xid);
+    while(rec != NULL && rec->parent != 0) {
+        last = rec->parent;
+        rec = getRecord(xctx, last);
+    }
 
     return last;
 }
@@ -522,9 +687,12 @@ static void pushEvent(struct X11Context* xctx, const struct Event event) {
 }
 
 static void windowCreate(struct X11Context* xctx, Window xid, int x, int y, int border, int width, int height) {
-    Word_t rc;
-    J1S(rc, xctx->active, xid);
-    if(rc == 0) {
+    struct WindowRecord* rec = ensureRecord(xctx, xid);
+    if(rec == NULL) {
+        return;
+    }
+
+    if((rec->flags & WF_ACTIVE) != 0) {
         // @CLEANUP @CONSISTENCY: I really want to assert here, but during
         // initialization someone might create a window in between our calls to
         // subscribe to window create events and bootstrap the state
@@ -532,15 +700,11 @@ static void windowCreate(struct X11Context* xctx, Window xid, int x, int y, int
         // For now just do nothing
         return;
     }
+    rec->flags |= WF_ACTIVE;
 
-    Damage damage = XDamageCreateH(xctx->display, xid, XDamageReportNonEmpty);
-    uint64_t* pValue;
-    JLI(pValue, xctx->damage, xid);
-    if(pValue == PJERR) {
-        printf_errf("Allocation error");
-        return;
-    }
-    *pValue = damage;
+    rec->damage = XDamageCreateH(xctx->display, xid, XDamageReportNonEmpty);
+    rec->repair = XFixesCreateRegionH(xctx->display, NULL, 0);
+    rec->damageGeometry = (XRectangle){0};
 
     if (xorgContext_version(&xctx->capabilities, PROTO_SHAPE) >= XVERSION_YES) {
         // Subscribe to events when the window shape changes
@@ -562,60 +726,90 @@ static void windowCreate(struct X11Context* xctx, Window xid, int x, int y, int
 }
 
 static bool findClosestClient(const struct X11Context* xctx, const Window top, Window* client) {
-    Word_t rc;
+    struct WindowRecord* topRec = getRecord(xctx, top);
+    if(topRec == NULL) {
+        return false;
+    }
+
+    if((topRec->flags & WF_CLIENT_CACHED) != 0) {
+        if(topRec->client == None)
+            return false;
+
+        *client = topRec->client;
+        return true;
+    }
 
+    int rc;
+
+    // Breadth first search of the subtree below top. We only ever look at the
+    // children of the current frontier, so this is bounded by the size of the
+    // subtree, not the amount of windows we know about.
     void* next = NULL;
     void* current = NULL;
     J1S(rc, current, top);
     Word_t count = 1;
 
+    Window found = None;
     while(count > 0) {
-        Word_t index = 0;
-        Window* value;
-        JLF(value, xctx->winParent, index);
-        while(value != NULL) {
-            J1T(rc, current, *value);
-            if(rc == 0) {
-                // This window is not a child of the
-                // current frontier
-                JLN(value, xctx->winParent, index);
-                continue;
+        Word_t parent = 0;
+        J1F(rc, current, parent);
+        while(rc != 0) {
+            struct WindowRecord* parentRec = getRecord(xctx, parent);
+            if(parentRec != NULL) {
+                Word_t child = 0;
+                int childRc;
+                J1F(childRc, parentRec->children, child);
+                while(childRc != 0) {
+                    int setRc;
+                    J1S(setRc, next, child);
+                    J1N(childRc, parentRec->children, child);
+                }
             }
+            J1N(rc, current, parent);
+        }
 
-            J1T(rc, xctx->client, index);
-            if(rc == 0) {
-                // The window is not a client, so we have
-                // to continue the search
-                J1S(rc, next, index);
-                JLN(value, xctx->winParent, index);
-                continue;
+        // Take the lowest client of this level, the same order we'd get from
+        // walking the children directly.
+        Word_t index = 0;
+        J1F(rc, next, index);
+        while(rc != 0) {
+            if(isWindowClient(xctx, index)) {
+                found = index;
+                break;
             }
-
-            // The window was a client and our search is done
-
-            J1FA(rc, next);
-            J1FA(rc, current);
-            *client = index;
-            return true;
+            J1N(rc, next, index);
         }
 
+        if(found != None)
+            break;
+
+        // None of the windows in this level were clients, so we have to
+        // continue the search one level down
         void* tmp = next;
         next = current;
         current = tmp;
-        J1FA(rc, next);
+        Word_t freed;
+        J1FA(freed, next);
         J1C(count, current, 0, -1);
     }
 
-    return false;
+    Word_t freed;
+    J1FA(freed, next);
+    J1FA(freed, current);
+
+    topRec->client = found;
+    topRec->flags |= WF_CLIENT_CACHED;
+
+    if(found == None)
+        return false;
+
+    *client = found;
+    return true;
 }
 
 static bool isWindowBypassed(struct X11Context* xctx, Window xid) {
-    Word_t rc;
-    J1T(rc, xctx->bypassed, xid);
-    if(rc == 1) {
-        return true;
-    }
-    return false;
+    struct WindowRecord* rec = getRecord(xctx, xid);
+    return rec != NULL && (rec->flags & WF_BYPASSED) != 0;
 }
 
 static bool isFrameBypassed(struct X11Context* xctx, Window xid) {
@@ -635,12 +829,22 @@ static bool isFrameBypassed(struct X11Context* xctx, Window xid) {
     return false;
 }
 
+static void forgetDamageGeometry(struct WindowRecord* rec) {
+    rec->damageGeometry = (XRectangle){0};
+    rec->flags &= ~WF_MOVED;
+}
+
 static void windowMap(struct X11Context* xctx, Window xid) {
-    Word_t rc;
-    J1S(rc, xctx->mapped, xid);
-    assert(rc == 1);
+    struct WindowRecord* rec = ensureRecord(xctx, xid);
+    if(rec == NULL) {
+        return;
+    }
+    assert((rec->flags & WF_MAPPED) == 0);
+    rec->flags |= WF_MAPPED;
+    // The first paint after mapping is real, wherever the window was before
+    forgetDamageGeometry(rec);
 
-    if(!isWindowActive(xctx, xid))
+    if((rec->flags & WF_ACTIVE) == 0)
         return;
 
     struct Event event;
@@ -659,30 +863,22 @@ static void windowMap(struct X11Context* xctx, Window xid) {
 }
 
 static void createDestroyWin(struct X11Context* xctx, Window xid) {
-    int rc_int;
-    JLD(rc_int, xctx->winParent, xid);
-    if(rc_int == JERR) {
-        printf_errf("Malloc error");
-        return;
-    } else if(rc_int == 1) {
+    if(detachSubtree(xctx, xid)) {
         // Window was framed which means it won't be active
         return;
     }
 
-    Word_t rc;
-    J1U(rc, xctx->active, xid);
-    if(rc == 0) {
+    struct WindowRecord* rec = getRecord(xctx, xid);
+    if(rec == NULL || (rec->flags & WF_ACTIVE) == 0) {
         // The window wasn't active, so we swallow the destroy
         return;
     }
-
-    JLD(rc_int, xctx->damage, xid);
-    if(rc_int == JERR) {
-        printf_errf("Alloc error");
-        return;
-    } else if(rc_int == 0) {
-        printf_errf("WARN Window didn't have damage");
-    }
+    rec->flags &= ~WF_ACTIVE;
+    // The damage dies with the window
+    rec->damage = None;
+    // The region doesn't
+    XFixesDestroyRegionH(xctx->display, rec->repair);
+    rec->repair = None;
 
     // Framed window destroy causes all the subwindows to be destroyed which
     // should cause the client to be removed from clientMap
@@ -735,8 +931,6 @@ static void createMandr(struct X11Context* xctx, Window xid, float x, float y, f
 }
 
 static bool findAffectedWindow(const struct X11Context* xctx, const Window win, Window* affected) {
-    Word_t rc;
-
     Window frame = findRoot(xctx, win);
     // If the frame isn't active dont emit
     if(!isWindowActive(xctx, frame)) {
@@ -752,8 +946,7 @@ static bool findAffectedWindow(const struct X11Context* xctx, const Window win,
 
     // If the window isn't a client it can't affect the
     // frame
-    J1T(rc, xctx->client, win);
-    if(rc == 0) {
+    if(!isWindowClient(xctx, win)) {
         return false;
     }
 
@@ -769,6 +962,129 @@ static bool findAffectedWindow(const struct X11Context* xctx, const Window win,
     return true;
 }
 
+bool xorg_requestDamage(struct X11Context* xctx, Window xid, xcb_xfixes_fetch_region_cookie_t* cookie) {
+    struct WindowRecord* rec = getRecord(xctx, xid);
+    if(rec == NULL || rec->repair == None)
+        return false;
+
+    xcb_connection_t* xcb = XGetXCBConnectionH(xctx->display);
+    *cookie = xcb_xfixes_fetch_regionH(xcb, rec->repair);
+    // Xlib flushes its own requests when xcb sends one, so the server sees
+    // the fetch before we empty the region
+    XFixesSetRegionH(xctx->display, rec->repair, NULL, 0);
+    return true;
+}
+
+bool xorg_collectDamage(struct X11Context* xctx, xcb_xfixes_fetch_region_cookie_t cookie, Vector* rects) {
+    xcb_connection_t* xcb = XGetXCBConnectionH(xctx->display);
+
+    xcb_generic_error_t* error;
+    xcb_xfixes_fetch_region_reply_t* reply = xcb_xfixes_fetch_region_replyH(xcb, cookie, &error);
+    if(reply == NULL) {
+        free(error);
+        return false;
+    }
+
+    int count = xcb_xfixes_fetch_region_rectangles_lengthH(reply);
+    xcb_rectangle_t* region = xcb_xfixes_fetch_region_rectanglesH(reply);
+    vector_clear(rects);
+    XRectangle* out = vector_reserve(rects, count);
+    for(int i = 0; i < count; i++) {
+        out[i] = (XRectangle){region[i].x, region[i].y, region[i].width, region[i].height};
+    }
+
+    free(reply);
+    return true;
+}
+
+void xorg_awaitRendering(struct X11Context* xctx) {
+    zone_scope(&ZONE_await_fence);
+
+    // The fence triggers once everything queued on the screen before it has
+    // been rendered, which covers all the windows at once. Resetting it after
+    // the wait means we can trigger it again next frame.
+    XSyncTriggerFenceH(xctx->display, xctx->renderFence);
+    XSyncAwaitFenceH(xctx->display, &xctx->renderFence, 1);
+    XSyncResetFenceH(xctx->display, xctx->renderFence);
+}
+
+uint64_t xorg_modePeriod(const XRRModeInfo* mode) {
+    double lines = mode->vTotal;
+    if(mode->modeFlags & RR_DoubleScan)
+        lines *= 2;
+    if(mode->modeFlags & RR_Interlace)
+        lines /= 2;
+
+    if(mode->dotClock == 0 || mode->hTotal == 0 || lines == 0)
+        return 0;
+
+    return (double)mode->hTotal * lines * 1000000.0 / mode->dotClock;
+}
+
+uint64_t xorg_refreshPeriod(struct X11Context* xctx) {
+    if(xorgContext_version(&xctx->capabilities, PROTO_RANDR) < XVERSION_YES)
+        return 0;
+
+    // We need 1.3 to get the resources without making the server poll the
+    // outputs, which can stall it for a long time.
+    int major = 0, minor = 0;
+    if(!XRRQueryVersionH(xctx->display, &major, &minor)
+            || major < 1 || (major == 1 && minor < 3))
+        return 0;
+
+    XRRScreenResources* resources = XRRGetScreenResourcesCurrentH(xctx->display, xctx->root);
+    if(resources == NULL)
+        return 0;
+
+    // With several monitors we can only line up with one of them. Take the
+    // fastest, so we never hold back frames it could show.
+    uint64_t period = 0;
+    for(int i = 0; i < resources->ncrtc; i++) {
+        XRRCrtcInfo* crtc = XRRGetCrtcInfoH(xctx->display, resources, resources->crtcs[i]);
+        if(crtc == NULL)
+            continue;
+
+        for(int j = 0; crtc->mode != None && j < resources->nmode; j++) {
+            if(resources->modes[j].id != crtc->mode)
+                continue;
+
+            uint64_t modePeriod = xorg_modePeriod(&resources->modes[j]);
+            if(modePeriod != 0 && (period == 0 || modePeriod < period))
+                period = modePeriod;
+        }
+        XRRFreeCrtcInfo(crtc);
+    }
+    XRRFreeScreenResources(resources);
+
+    return period;
+}
+
+// X reports the entire window as damaged when it moves, even though the
+// contents are the same. We recognize that as damage covering the whole
+// window when a ConfigureNotify moved the window, but kept its size, since the
+// last damage.
+static bool isMoveDamage(const struct WindowRecord* rec, const XDamageNotifyEvent* ev) {
+    const XRectangle* last = &rec->damageGeometry;
+    const XRectangle* now = &ev->geometry;
+
+    if((rec->flags & WF_MOVED) == 0)
+        return false;
+
+    // We haven't seen the window before
+    if(last->width == 0 || last->height == 0)
+        return false;
+
+    if(last->width != now->width || last->height != now->height)
+        return false;
+
+    if(last->x == now->x && last->y == now->y)
+        return false;
+
+    return ev->area.x <= 0 && ev->area.y <= 0
+        && ev->area.x + ev->area.width >= now->width
+        && ev->area.y + ev->area.height >= now->height;
+}
+
 // @HACK @CLEANUP: calling this mans the caller is doing some Xorg stuff, which
 // we really don't want them to. We should wrap the individual call instead, but
 // this seems like a good transition
@@ -894,10 +1210,13 @@ static void refreshRoot(struct X11Context* xctx) {
     }
 }
 
-static int32_t xBypassState(const struct X11Context* xctx, const Window win) {
+static xcb_get_property_cookie_t xBypassRequest(const struct X11Context* xctx, const Window win) {
     xcb_connection_t* xcb = XGetXCBConnectionH(xctx->display);
+    return xcb_get_propertyH(xcb, false, win, xctx->atoms->atom_bypass, XA_CARDINAL, 0, 1);
+}
 
-    xcb_get_property_cookie_t cookie = xcb_get_propertyH(xcb, false, win, xctx->atoms->atom_bypass, XA_CARDINAL, 0, 1);
+static int32_t xBypassReply(const struct X11Context* xctx, xcb_get_property_cookie_t cookie) {
+    xcb_connection_t* xcb = XGetXCBConnectionH(xctx->display);
 
     xcb_generic_error_t *error;
     xcb_get_property_reply_t *reply = xcb_get_property_replyH(xcb, cookie, &error);
@@ -935,9 +1254,90 @@ static int32_t xBypassState(const struct X11Context* xctx, const Window win) {
     return bypass;
 }
 
-static void fillBuffer(struct X11Context* xctx) {
-    XEvent raw = {};
-    XNextEventH(xctx->display, &raw);
+static int32_t xBypassState(const struct X11Context* xctx, const Window win) {
+    return xBypassReply(xctx, xBypassRequest(xctx, win));
+}
+
+static xcb_get_geometry_cookie_t xGeometryRequest(const struct X11Context* xctx, const Window win) {
+    xcb_connection_t* xcb = XGetXCBConnectionH(xctx->display);
+    return xcb_get_geometryH(xcb, win);
+}
+
+static bool xGeometryReply(const struct X11Context* xctx, xcb_get_geometry_cookie_t cookie, struct WindowGeometry* geometry) {
+    xcb_connection_t* xcb = XGetXCBConnectionH(xctx->display);
+
+    xcb_generic_error_t *error;
+    xcb_get_geometry_reply_t *reply = xcb_get_geometry_replyH(xcb, cookie, &error);
+    if(reply == NULL) {
+        // The window is probably gone already
+        free(error);
+        return false;
+    }
+
+    geometry->x = reply->x;
+    geometry->y = reply->y;
+    geometry->width = reply->width;
+    geometry->height = reply->height;
+    geometry->border = reply->border_width;
+    free(reply);
+
+    return true;
+}
+
+// Send off the requests we are going to need to handle this event. We do this
+// for the entire batch before waiting for any replies, which means we only pay
+// for a single round trip per batch instead of one per event.
+static void requestEvent(struct X11Context* xctx, struct PendingEvent* pending) {
+    pending->requests = 0;
+
+    switch (pending->raw.type) {
+        case CreateNotify: {
+            XCreateWindowEvent* ev = (XCreateWindowEvent *)&pending->raw;
+            if(ev->window == xctx->overlay) break;
+            if(ev->window == xctx->reg) break;
+
+            // We need to select input before we ask for the bypass property,
+            // otherwise we might miss a change in between.
+            // Watch for possible WM_STATE
+            XSelectInputH(xctx->display, ev->window, PropertyChangeMask);
+
+            pending->bypassCookie = xBypassRequest(xctx, ev->window);
+            pending->requests |= PENDING_BYPASS;
+            break;
+        }
+        case ReparentNotify: {
+            XReparentEvent* ev = (XReparentEvent *)&pending->raw;
+            if(ev->parent != xctx->root) break;
+
+            pending->geometryCookie = xGeometryRequest(xctx, ev->window);
+            pending->requests |= PENDING_GEOMETRY;
+            break;
+        }
+        case PropertyNotify: {
+            XPropertyEvent* ev = (XPropertyEvent *)&pending->raw;
+            if(ev->window == xctx->root) break;
+            if(ev->atom != xctx->atoms->atom_bypass) break;
+            if(ev->state != PropertyNewValue) break;
+
+            pending->bypassCookie = xBypassRequest(xctx, ev->window);
+            pending->requests |= PENDING_BYPASS;
+            break;
+        }
+    }
+}
+
+static void resolveEvent(struct X11Context* xctx, struct PendingEvent* pending) {
+    if((pending->requests & PENDING_BYPASS) != 0) {
+        pending->bypass = xBypassReply(xctx, pending->bypassCookie);
+    }
+
+    if((pending->requests & PENDING_GEOMETRY) != 0) {
+        pending->hasGeometry = xGeometryReply(xctx, pending->geometryCookie, &pending->geometry);
+    }
+}
+
+static void processEvent(struct X11Context* xctx, const struct PendingEvent* pending) {
+    XEvent raw = pending->raw;
 
     switch (raw.type) {
         case CreateNotify: {
@@ -946,13 +1346,12 @@ static void fillBuffer(struct X11Context* xctx) {
             if(ev->window == xctx->overlay) break;
             if(ev->window == xctx->reg) break;
             zone_scope_extra(&ZONE_event_preprocess, "Create");
+            // The input mask was already selected when we requested the bypass
+            // state
             if(ev->parent == xctx->root) {
                 windowCreate(xctx, ev->window, ev->x, ev->y, ev->border_width, ev->width, ev->height);
-                XSelectInputH(xctx->display, ev->window, PropertyChangeMask);
             } else {
                 attachSubtree(xctx, ev->parent, ev->window);
-                // Watch for possible WM_STATE
-                XSelectInputH(xctx->display, ev->window, PropertyChangeMask);
             }
 
             // If the frame was bypassed before we got to call SelectInput, we
@@ -966,12 +1365,12 @@ static void fillBuffer(struct X11Context* xctx) {
                 break;
             }
 
-            if(xBypassState(xctx, ev->window) == 1) {
-                Word_t rc;
-                J1S(rc, xctx->bypassed, ev->window);
-                if(rc == 0) {
+            if(pending->bypass == 1) {
+                struct WindowRecord* rec = ensureRecord(xctx, ev->window);
+                if(rec == NULL || (rec->flags & WF_BYPASSED) != 0) {
                     break;
                 }
+                rec->flags |= WF_BYPASSED;
 
                 if(isWindowMapped(xctx, affected)) {
                     struct Event event = {
@@ -991,9 +1390,13 @@ static void fillBuffer(struct X11Context* xctx) {
             Window frame = findRoot(xctx, ev->window);
             bool old_bypassed = isFrameBypassed(xctx, frame);
 
-            Word_t rc;
-            J1U(rc, xctx->bypassed, ev->window);
-            J1U(rc, xctx->mapped, ev->window);
+            // Nothing we know about the window outlives it, and X can hand
+            // out the id again
+            struct WindowRecord* rec = getRecord(xctx, ev->window);
+            if(rec != NULL) {
+                rec->flags &= ~(WF_BYPASSED | WF_MAPPED | WF_CLIENT | WF_MOVED);
+                invalidateClient(xctx, ev->window);
+            }
 
             createDestroyWin(xctx, ev->window);
             detachSubtree(xctx, ev->window);
@@ -1012,6 +1415,9 @@ static void fillBuffer(struct X11Context* xctx) {
                 }
             }
 
+            if(rec != NULL) {
+                releaseRecord(xctx, ev->window, rec);
+            }
             break;
         }
         case ReparentNotify: {
@@ -1020,16 +1426,14 @@ static void fillBuffer(struct X11Context* xctx) {
             // Since we only composite top level windows, reparenting to the
             // root looks like an new window to us.
             if (ev->parent == xctx->root) {
-                XWindowAttributes attribs;
-                if(!XGetWindowAttributesH(xctx->display, ev->window, &attribs)) {
+                if(!pending->hasGeometry) {
                     break;
                 }
-                windowCreate(xctx, ev->window, attribs.x, attribs.y, attribs.border_width, attribs.width, attribs.height);
+                const struct WindowGeometry* geometry = &pending->geometry;
+                windowCreate(xctx, ev->window, geometry->x, geometry->y, geometry->border, geometry->width, geometry->height);
 
                 if(isFrameBypassed(xctx, ev->window)) {
-                    Word_t rc;
-                    J1T(rc, xctx->mapped, ev->window);
-                    if(rc == 1) {
+                    if(isWindowMapped(xctx, ev->window)) {
                         struct Event event = {
                             .type = ET_BYPASS,
                             .bypass.xid = ev->window,
@@ -1037,9 +1441,7 @@ static void fillBuffer(struct X11Context* xctx) {
                         pushEvent(xctx, event);
                     }
                 } else {
-                    Word_t rc;
-                    J1T(rc, xctx->mapped, ev->window);
-                    if(rc == 1) {
+                    if(isWindowMapped(xctx, ev->window)) {
                         struct Event map = {
                             .type = ET_MAP,
                             .map.xid = ev->window,
@@ -1051,9 +1453,8 @@ static void fillBuffer(struct X11Context* xctx) {
                 detachSubtree(xctx, ev->window);
             } else {
                 // DestroyWin expects the damage to already be freed.
-                Damage* damage;
-                JLG(damage, xctx->damage, ev->window);
-                if(damage != NULL) {
+                struct WindowRecord* rec = getRecord(xctx, ev->window);
+                if(rec != NULL && (rec->flags & WF_ACTIVE) != 0) {
                     // @HACK @COMPLETENESS: We have some tests that reparent
                     // windows from one subwindow to another. This doesn't
                     // actually occur, since we don't subscribe to substructure
@@ -1061,7 +1462,7 @@ static void fillBuffer(struct X11Context* xctx) {
                     // problems though, so we will have to fix that at some
                     // point. For that reason i'm keeping the tests and keeping
                     // this code even though it will never be hit.
-                    XDamageDestroyH(xctx->display, *damage);
+                    XDamageDestroyH(xctx->display, rec->damage);
                 }
 
                 createDestroyWin(xctx, ev->window);
@@ -1099,6 +1500,9 @@ static void fillBuffer(struct X11Context* xctx) {
                 };
                 pushEvent(xctx, event);
             } else {
+                struct WindowRecord* rec = getRecord(xctx, ev->window);
+                if(rec != NULL && (rec->flags & WF_ACTIVE) != 0)
+                    rec->flags |= WF_MOVED;
                 createMandr(xctx, ev->window, ev->x, ev->y, ev->border_width, ev->override_redirect, ev->width, ev->height, ev->above);
             }
             break;
@@ -1132,12 +1536,13 @@ static void fillBuffer(struct X11Context* xctx) {
             if(ev->send_event == true)
                 break;
 
-            if(!isWindowActive(xctx, ev->window))
+            struct WindowRecord* rec = getRecord(xctx, ev->window);
+            if(rec == NULL || (rec->flags & WF_ACTIVE) == 0)
                 break;
 
-            Word_t rc;
-            J1U(rc, xctx->mapped, ev->window);
-            assert(rc == 1);
+            assert((rec->flags & WF_MAPPED) != 0);
+            rec->flags &= ~WF_MAPPED;
+            forgetDamageGeometry(rec);
 
             XSelectInputH(xctx->display, ev->window, PropertyChangeMask);
 
@@ -1168,13 +1573,14 @@ static void fillBuffer(struct X11Context* xctx) {
                         Window oldClient;
                         bool hasOldClient = findClosestClient(xctx, frame, &oldClient);
 
-                        Word_t rc;
-                        J1S(rc, xctx->client, ev->window);
-                        if(rc != 1) { // The window was already a client
+                        struct WindowRecord* rec = ensureRecord(xctx, ev->window);
+                        if(rec == NULL || (rec->flags & WF_CLIENT) != 0) { // The window was already a client
                             break;
                         }
+                        rec->flags |= WF_CLIENT;
+                        invalidateClient(xctx, ev->window);
 
-                        if(isWindowActive(xctx, ev->window)) {
+                        if((rec->flags & WF_ACTIVE) != 0) {
                             // The window is a frame, which means we don't need
                             // to process the client (frames can't be clients).
                             // We still track client status if this get's
@@ -1194,11 +1600,14 @@ static void fillBuffer(struct X11Context* xctx) {
                         Window oldClient;
                         bool hasOldClient = findClosestClient(xctx, frame, &oldClient);
 
-                        Word_t rc;
-                        J1U(rc, xctx->client, ev->window);
-                        assert(rc == 1); // The window is not a client
+                        struct WindowRecord* rec = getRecord(xctx, ev->window);
+                        if(rec == NULL || (rec->flags & WF_CLIENT) == 0) { // The window is not a client
+                            break;
+                        }
+                        rec->flags &= ~WF_CLIENT;
+                        invalidateClient(xctx, ev->window);
 
-                        if(isWindowActive(xctx, ev->window)) {
+                        if((rec->flags & WF_ACTIVE) != 0) {
                             // The window is a frame, which means we don't need
                             // to process the client (frames can't be clients).
                             // We still track client status if this get's
@@ -1252,13 +1661,19 @@ static void fillBuffer(struct X11Context* xctx) {
                         break;
                     }
 
+                    // Affected windows are either frames or clients, so we
+                    // should know about them
+                    struct WindowRecord* rec = getRecord(xctx, ev->window);
+                    if(rec == NULL) {
+                        break;
+                    }
+
                     if(ev->state == PropertyNewValue) {
-                        if(xBypassState(xctx, ev->window) == 1) {
-                            Word_t rc;
-                            J1S(rc, xctx->bypassed, ev->window);
-                            if(rc == 0) {
+                        if(pending->bypass == 1) {
+                            if((rec->flags & WF_BYPASSED) != 0) {
                                 break;
                             }
+                            rec->flags |= WF_BYPASSED;
 
                             if(isWindowMapped(xctx, affected)) {
                                 struct Event event = {
@@ -1267,10 +1682,9 @@ static void fillBuffer(struct X11Context* xctx) {
                                 };
                                 pushEvent(xctx, event);
                             }
-                        } else {
-                            Word_t rc;
-                            J1U(rc, xctx->bypassed, ev->window);
-                            if(rc == 1 && isWindowMapped(xctx, affected)) {
+                        } else if((rec->flags & WF_BYPASSED) != 0) {
+                            rec->flags &= ~WF_BYPASSED;
+                            if(isWindowMapped(xctx, affected)) {
                                 struct Event event = {
                                     .type = ET_MAP,
                                     .map.xid = affected,
@@ -1279,9 +1693,11 @@ static void fillBuffer(struct X11Context* xctx) {
                             }
                         }
                     } else if(ev->state == PropertyDelete) {
-                        Word_t rc;
-                        J1U(rc, xctx->bypassed, ev->window);
-                        if(rc == 1 && isWindowMapped(xctx, affected)) {
+                        if((rec->flags & WF_BYPASSED) == 0) {
+                            break;
+                        }
+                        rec->flags &= ~WF_BYPASSED;
+                        if(isWindowMapped(xctx, affected)) {
                             struct Event event = {
                                 .type = ET_MAP,
                                 .bypass.xid = affected,
@@ -1300,21 +1716,41 @@ static void fillBuffer(struct X11Context* xctx) {
                 XDamageNotifyEvent* ev = (XDamageNotifyEvent*)&raw;
                 zone_scope_extra(&ZONE_event_preprocess, "Damage(%#010X)", ev->drawable);
 
-                assert(isWindowActive(xctx, ev->drawable));
+                // Damage can still be queued for a window we just destroyed
+                struct WindowRecord* rec = getRecord(xctx, ev->drawable);
+                if(rec == NULL || (rec->flags & WF_ACTIVE) == 0) {
+                    break;
+                }
 
                 // We need to subtract the damage, even if we aren't mapped. If we don't
                 // subtract the damage, we won't be notified of any new damage in the
                 // future.
-                Damage* damage;
-                JLG(damage, xctx->damage, ev->drawable);
-                XDamageSubtractH(xctx->display, *damage, None, None);
+                XDamageSubtractH(xctx->display, rec->damage, None, xctx->damageParts);
 
-                if(isWindowBypassed(xctx, ev->drawable))
+                if((rec->flags & WF_BYPASSED) != 0)
                     break;
 
-                if(!isWindowMapped(xctx, ev->drawable))
+                if((rec->flags & WF_MAPPED) == 0)
                     break;
 
+                // Keep the damaged area around until the compositor asks for
+                // it. Everything here is async, so it doesn't cost a round
+                // trip per damage.
+                XFixesUnionRegionH(xctx->display, rec->repair, rec->repair, xctx->damageParts);
+
+                bool moved = isMoveDamage(rec, ev);
+                rec->damageGeometry = ev->geometry;
+                rec->flags &= ~WF_MOVED;
+                if(moved) {
+                    // The contents didn't change, so we don't tell anyone.
+                    // The damage is still in the repair region, so if we
+                    // raced some actual drawing it gets redrawn with the next
+                    // real damage. Only the damage right after a move is
+                    // dropped like this.
+                    zone_insta_extra(&ZONE_event_preprocess, "Move damage(%#010X)", ev->drawable);
+                    break;
+                }
+
                 struct Event event = {
                     .type = ET_DAMAGE,
                     .damage.xid = ev->drawable,
@@ -1343,6 +1779,146 @@ static void fillBuffer(struct X11Context* xctx) {
     }
 }
 
+// The window an event is about, None for the events that affect everything
+static Window eventWindow(const struct Event* event) {
+    switch(event->type) {
+        case ET_ADD: return event->add.xid;
+        case ET_DESTROY: return event->des.xid;
+        case ET_MAP: return event->map.xid;
+        case ET_UNMAP: return event->unmap.xid;
+        case ET_CLIENT: return event->cli.xid;
+        case ET_MANDR: return event->mandr.xid;
+        case ET_RESTACK: return event->restack.xid;
+        case ET_FOCUS: return event->focus.xid;
+        case ET_WINCLASS: return event->winclass.xid;
+        case ET_WINTYPE: return event->wintype.xid;
+        case ET_DAMAGE: return event->damage.xid;
+        case ET_SHAPE: return event->shape.xid;
+        case ET_BYPASS: return event->bypass.xid;
+        default: return None;
+    }
+}
+
+enum CoalesceKind {
+    COALESCE_MANDR,
+    COALESCE_DAMAGE,
+    COALESCE_SHAPE,
+    COALESCE_WINTYPE,
+    COALESCE_COUNT,
+};
+
+static int coalesceKind(enum EventType type) {
+    switch(type) {
+        case ET_MANDR: return COALESCE_MANDR;
+        case ET_DAMAGE: return COALESCE_DAMAGE;
+        case ET_SHAPE: return COALESCE_SHAPE;
+        case ET_WINTYPE: return COALESCE_WINTYPE;
+        default: return -1;
+    }
+}
+
+// Drop the events that are made redundant by a later event of the same kind
+// for the same window. Only the last MANDR, DAMAGE, SHAPE and WINTYPE for a
+// window survives. Most other events for a window are a barrier, so we never
+// move state across an ADD/DESTROY (XID reuse) or a MAP/UNMAP. Events are
+// only ever dropped, never reordered, so the ADD/DESTROY/RESTACK order is
+// kept.
+static void coalesceEvents(struct X11Context* xctx) {
+    zone_scope(&ZONE_coalesce);
+
+    size_t size = vector_size(&xctx->eventBuf);
+    if(size < 2)
+        return;
+
+    // Judy1 sets of the windows that already have a later event of the kind
+    void* seen[COALESCE_COUNT] = {};
+    bool* keep = malloc(size * sizeof(bool));
+
+    int rc;
+    for(size_t i = size; i-- > 0;) {
+        const struct Event* event = vector_get(&xctx->eventBuf, i);
+        Window xid = eventWindow(event);
+        int kind = coalesceKind(event->type);
+
+        keep[i] = true;
+        if(kind != -1) {
+            J1S(rc, seen[kind], xid);
+            // If the bit was already set there's a later one
+            keep[i] = rc == 1;
+        } else if(event->type == ET_RESTACK || event->type == ET_FOCUS) {
+            // Stacking and focus don't depend on the geometry or contents, so
+            // these are free to move past them. A drag is a stream of
+            // MANDR/RESTACK pairs.
+        } else if(xid != None) {
+            for(int j = 0; j < COALESCE_COUNT; j++) {
+                J1U(rc, seen[j], xid);
+            }
+        } else {
+            for(int j = 0; j < COALESCE_COUNT; j++) {
+                Word_t freed;
+                J1FA(freed, seen[j]);
+            }
+        }
+    }
+
+    for(int j = 0; j < COALESCE_COUNT; j++) {
+        Word_t freed;
+        J1FA(freed, seen[j]);
+    }
+
+    size_t write = 0;
+    for(size_t i = 0; i < size; i++) {
+        if(!keep[i])
+            continue;
+        if(write != i) {
+            *(struct Event*)vector_get(&xctx->eventBuf, write) = *(struct Event*)vector_get(&xctx->eventBuf, i);
+        }
+        write++;
+    }
+    free(keep);
+
+    size_t dropped = size - write;
+    xctx->coalesced += dropped;
+    vector_truncate(&xctx->eventBuf, write);
+    zone_insta_extra(&ZONE_coalesce, "%zu dropped", dropped);
+}
+
+static void fillBuffer(struct X11Context* xctx) {
+    zone_scope(&ZONE_fill_buffer);
+
+    // Take everything that's already been read from the connection
+    int queued = XEventsQueuedH(xctx->display, QueuedAlready);
+    if(queued <= 0)
+        return;
+
+    vector_clear(&xctx->batch);
+    struct PendingEvent* batch = vector_reserve(&xctx->batch, queued);
+    for(int i = 0; i < queued; i++) {
+        XNextEventH(xctx->display, &batch[i].raw);
+    }
+
+    {
+        zone_scope(&ZONE_fill_request);
+        for(int i = 0; i < queued; i++) {
+            requestEvent(xctx, &batch[i]);
+        }
+    }
+
+    {
+        zone_scope(&ZONE_fill_resolve);
+        for(int i = 0; i < queued; i++) {
+            resolveEvent(xctx, &batch[i]);
+        }
+    }
+
+    for(int i = 0; i < queued; i++) {
+        processEvent(xctx, &batch[i]);
+    }
+    zone_insta_extra(&ZONE_fill_batch, "%d events", queued);
+
+    coalesceEvents(xctx);
+}
+
 void xorg_nextEvent(struct X11Context* xctx, struct Event* event) {
     while(true) {
         if(xctx->readCursor < vector_size(&xctx->eventBuf)) {
@@ -1363,123 +1939,240 @@ void xorg_nextEvent(struct X11Context* xctx, struct Event* event) {
     }
 }
 
-static bool hasProperty(xcb_connection_t* xcb, Atom atom, Window xid) {
-    xcb_get_property_cookie_t cookie = xcb_get_propertyH(xcb, false, xid, atom, XA_CARDINAL, 0, 1);
+// A window found during the initial scan, and the requests in flight for it
+struct ScanWindow {
+    Window xid;
+    // None for the toplevel windows
+    Window parent;
 
-    xcb_generic_error_t *error;
-    xcb_get_property_reply_t *reply = xcb_get_property_replyH(xcb, cookie, &error);
-    if(reply == NULL) {
-        printf_errf("Failed initializing window: code %d", error->error_code);
-        free(error);
-        return false;
+    xcb_get_window_attributes_cookie_t attrCookie;
+    xcb_get_geometry_cookie_t geometryCookie;
+    xcb_query_tree_cookie_t treeCookie;
+    xcb_get_property_cookie_t clientCookie;
+    xcb_get_property_cookie_t bypassCookie;
+
+    // We got the attributes and it's not InputOnly
+    bool valid;
+    bool viewable;
+    bool hasClientAtom;
+    struct WindowGeometry geometry;
+
+    Window client;
+    bool hasClient;
+};
+
+static void scanRequest(struct X11Context* xctx, xcb_connection_t* xcb, struct ScanWindow* win) {
+    if(win->parent != None) {
+        // Watch for possible WM_STATE
+        XSelectInputH(xctx->display, win->xid, PropertyChangeMask);
     }
 
-    bool ret = reply->type != None;
-    free(reply);
-    return ret;
-}
+    win->attrCookie = xcb_get_window_attributesH(xcb, win->xid);
+    // We don't know if we are going to need the children yet, but asking is
+    // cheaper than waiting for the attributes before we do.
+    win->treeCookie = xcb_query_treeH(xcb, win->xid);
 
-static void recurseWindow(struct X11Context* xctx, Window xid);
+    if(win->parent == None) {
+        win->geometryCookie = xcb_get_geometryH(xcb, win->xid);
+    } else {
+        win->clientCookie = xcb_get_propertyH(xcb, false, win->xid, xctx->atoms->atom_client, XA_CARDINAL, 0, 1);
+    }
+}
 
-static void beginSubWindow(struct X11Context* xctx, Window xid, Window parent) {
-    attachSubtree(xctx, parent, xid);
-    XSelectInputH(xctx->display, xid, PropertyChangeMask);
+// Collect the replies for a single window, queueing its children for the next
+// level
+static void scanReply(struct X11Context* xctx, xcb_connection_t* xcb, Vector* windows, size_t index) {
+    struct ScanWindow* win = vector_get(windows, index);
+    xcb_generic_error_t *error;
 
-    XWindowAttributes attribs;
-    if (!XGetWindowAttributesH(xctx->display, xid, &attribs)) {
+    win->valid = false;
+    xcb_get_window_attributes_reply_t* attribs = xcb_get_window_attributes_replyH(xcb, win->attrCookie, &error);
+    if(attribs == NULL) {
         // Failed to get window attributes probably means the window is gone
         // already.
-        return;
+        free(error);
+    } else {
+        win->valid = attribs->_class != XCB_WINDOW_CLASS_INPUT_ONLY;
+        win->viewable = attribs->map_state == XCB_MAP_STATE_VIEWABLE;
+        free(attribs);
     }
 
-    if(attribs.class == InputOnly) {
-        return;
+    if(win->parent == None) {
+        if(!xGeometryReply(xctx, win->geometryCookie, &win->geometry)) {
+            win->valid = false;
+        }
+
+        if(win->valid) {
+            XSelectInputH(xctx->display, win->xid, PropertyChangeMask);
+        }
+    } else {
+        xcb_get_property_reply_t *reply = xcb_get_property_replyH(xcb, win->clientCookie, &error);
+        if(reply == NULL) {
+            if(win->valid)
+                printf_errf("Failed initializing window: code %d", error->error_code);
+            free(error);
+        } else {
+            win->hasClientAtom = win->valid && reply->type != None;
+            free(reply);
+        }
     }
 
-    recurseWindow(xctx, xid);
+    xcb_query_tree_reply_t* tree = xcb_query_tree_replyH(xcb, win->treeCookie, &error);
+    if(tree == NULL) {
+        free(error);
+        return;
+    }
 
-    if(attribs.map_state == IsViewable) {
-        windowMap(xctx, xid);
+    if(win->valid) {
+        Window parent = win->xid;
+        xcb_window_t* children = xcb_query_tree_childrenH(tree);
+        int numChildren = xcb_query_tree_children_lengthH(tree);
+        // Careful, this invalidates win
+        for(int i = 0; i < numChildren; i++) {
+            struct ScanWindow child = {
+                .xid = children[i],
+                .parent = parent,
+            };
+            vector_putBack(windows, &child);
+        }
     }
+    free(tree);
+}
 
+// Walk the window tree one level at a time. All the requests for a level are
+// sent before we wait for any of the replies, so the whole tree costs a round
+// trip per level instead of a handful per window.
+static void scanTree(struct X11Context* xctx, Vector* windows) {
+    zone_scope(&ZONE_scan_tree);
     xcb_connection_t* xcb = XGetXCBConnectionH(xctx->display);
 
-    if(hasProperty(xcb, xctx->atoms->atom_client, xid)) {
-        Word_t rc;
-        J1S(rc, xctx->client, xid);
-        assert(rc == 1);
+    xcb_generic_error_t *error;
+    xcb_query_tree_reply_t* tree = xcb_query_tree_replyH(xcb, xcb_query_treeH(xcb, xctx->root), &error);
+    if(tree == NULL) {
+        printf_errf("Failed querying the root window: code %d", error->error_code);
+        free(error);
+        return;
     }
 
-}
+    xcb_window_t* children = xcb_query_tree_childrenH(tree);
+    int numChildren = xcb_query_tree_children_lengthH(tree);
+    for(int i = 0; i < numChildren; i++) {
+        // Ignore our overlay and reg window.
+        if(children[i] == xctx->overlay || children[i] == xctx->reg)
+            continue;
 
-static void recurseWindow(struct X11Context* xctx, Window xid) {
-    Window root_return, parent_return;
-    Window *children;
-    unsigned int nchildren;
+        struct ScanWindow win = {
+            .xid = children[i],
+            .parent = None,
+        };
+        vector_putBack(windows, &win);
+    }
+    free(tree);
 
-    XQueryTree(xctx->display, xid, &root_return, &parent_return,
-            &children, &nchildren);
+    size_t levelStart = 0;
+    int depth = 0;
+    while(levelStart < vector_size(windows)) {
+        size_t levelEnd = vector_size(windows);
+        zone_scope_extra(&ZONE_scan_level, "depth %d, %zu windows", depth, levelEnd - levelStart);
 
-    for (unsigned i = 0; i < nchildren; i++) {
-        beginSubWindow(xctx, children[i], xid);
-    }
-}
+        for(size_t i = levelStart; i < levelEnd; i++) {
+            scanRequest(xctx, xcb, vector_get(windows, i));
+        }
 
+        for(size_t i = levelStart; i < levelEnd; i++) {
+            scanReply(xctx, xcb, windows, i);
+        }
 
-static void beginTopWindow(struct X11Context* xctx, Window xid) {
-    if(xid == xctx->overlay || xid == xctx->reg) {
-        // Ignore our overlay and reg window.
-        return;
+        levelStart = levelEnd;
+        depth++;
     }
+}
 
-    XWindowAttributes attribs;
-    if (!XGetWindowAttributesH(xctx->display, xid, &attribs)) {
-        // Failed to get window attributes probably means the window is gone
-        // already.
-        return;
-    }
+// Synthesize events for the initial state
+void xorg_beginEvents(struct X11Context* xctx) {
+    zone_scope(&ZONE_begin_events);
 
-    if(attribs.class == InputOnly) {
-        return;
-    }
+    Vector windows;
+    vector_init(&windows, sizeof(struct ScanWindow), 64);
 
-    windowCreate(xctx, xid, attribs.x, attribs.y, attribs.border_width, attribs.width, attribs.height);
-    XSelectInputH(xctx->display, xid, PropertyChangeMask);
+    scanTree(xctx, &windows);
 
-    recurseWindow(xctx, xid);
+    {
+        zone_scope(&ZONE_scan_build);
+        size_t index;
+        struct ScanWindow* win = vector_getFirst(&windows, &index);
+        while(win != NULL) {
+            if(win->parent != None) {
+                attachSubtree(xctx, win->parent, win->xid);
+
+                if(win->valid && win->viewable) {
+                    windowMap(xctx, win->xid);
+                }
 
-    Window client;
-    if(findClosestClient(xctx, xid, &client)) {
-        createGetsClient(xctx, xid, client);
-    } else {
-        client = xid;
+                if(win->hasClientAtom) {
+                    struct WindowRecord* rec = ensureRecord(xctx, win->xid);
+                    assert(rec != NULL && (rec->flags & WF_CLIENT) == 0);
+                    rec->flags |= WF_CLIENT;
+                    invalidateClient(xctx, win->xid);
+                }
+            }
+            win = vector_getNext(&windows, &index);
+        }
     }
 
-    if(xBypassState(xctx, client) == 1) {
-        Word_t rc;
-        J1S(rc, xctx->bypassed, client);
-        assert(rc != 0);
-    }
+    // The bypass state lives on the client, so we can only ask once the
+    // whole tree is known.
+    {
+        zone_scope(&ZONE_scan_bypass);
+        size_t index;
+        struct ScanWindow* win = vector_getFirst(&windows, &index);
+        while(win != NULL) {
+            if(win->parent == None && win->valid) {
+                win->hasClient = findClosestClient(xctx, win->xid, &win->client);
+                if(!win->hasClient) {
+                    win->client = win->xid;
+                }
+                win->bypassCookie = xBypassRequest(xctx, win->client);
+            }
+            win = vector_getNext(&windows, &index);
+        }
 
-    if(attribs.map_state == IsViewable) {
-        windowMap(xctx, xid);
+        win = vector_getFirst(&windows, &index);
+        while(win != NULL) {
+            if(win->parent == None && win->valid) {
+                if(xBypassReply(xctx, win->bypassCookie) == 1) {
+                    struct WindowRecord* rec = ensureRecord(xctx, win->client);
+                    assert(rec != NULL && (rec->flags & WF_BYPASSED) == 0);
+                    rec->flags |= WF_BYPASSED;
+                }
+            }
+            win = vector_getNext(&windows, &index);
+        }
     }
-}
-
-// Synthesize events for the initial state
-void xorg_beginEvents(struct X11Context* xctx) {
-    Window root_return, parent_return;
-    Window *children;
-    unsigned int nchildren;
 
-    XQueryTree(xctx->display, xctx->root, &root_return,
-            &parent_return, &children, &nchildren);
+    // Toplevels are first in the list, in stacking order
+    {
+        zone_scope(&ZONE_scan_emit);
+        size_t index;
+        struct ScanWindow* win = vector_getFirst(&windows, &index);
+        while(win != NULL && win->parent == None) {
+            if(win->valid) {
+                const struct WindowGeometry* geometry = &win->geometry;
+                windowCreate(xctx, win->xid, geometry->x, geometry->y, geometry->border, geometry->width, geometry->height);
+
+                if(win->hasClient) {
+                    createGetsClient(xctx, win->xid, win->client);
+                }
 
-    for (unsigned i = 0; i < nchildren; i++) {
-        beginTopWindow(xctx, children[i]);
+                if(win->viewable) {
+                    windowMap(xctx, win->xid);
+                }
+            }
+            win = vector_getNext(&windows, &index);
+        }
     }
 
-    XFree(children);
+    vector_kill(&windows);
 
     refreshFocus(xctx);
     refreshRoot(xctx);
@@ -23,6 +23,8 @@
 #include <X11/extensions/Xinerama.h>
 #include <X11/extensions/sync.h>
 
+#include <xcb/xfixes.h>
+
 #include <Judy.h>
 
 struct _session_t;
@@ -198,15 +200,24 @@ struct X11Context {
     // @CLEANUP: This should be internal but currently it lives in the session
     struct Atoms* atoms;
 
-    void* winParent;
-    void* client;
-    void* damage;
-    void* mapped;
-    void* bypassed;
+    // Everything we know about a window, keyed by XID. See struct
+    // WindowRecord in xorg.c
+    void* windows;
 
-    void* active;
     Vector eventBuf;
     size_t readCursor;
+    // Number of events dropped by coalescing, since the context was created
+    size_t coalesced;
+
+    // Scratch region for subtracting damage
+    XserverRegion damageParts;
+
+    // Reused every frame to wait for X to finish rendering, see
+    // xorg_awaitRendering
+    XSyncFence renderFence;
+
+    // The raw X events we are currently turning into events, see fillBuffer
+    Vector batch;
 };
 
 struct WinVis {
@@ -237,6 +248,22 @@ void xorg_nextEvent(struct X11Context* xcontext, struct Event* event);
 void xorg_beginEvents(struct X11Context* xcontext);
 
 Window xorg_get_client(struct X11Context* xctx, Window frame);
+// Get the damage accumulated for the window since the last fetch, in window
+// coordinates (excluding the border). Fetching is split in two so the round
+// trips for all the windows overlap: request the damage of every window
+// first, then collect the replies. Request returns false if we don't track
+// damage for the window.
+bool xorg_requestDamage(struct X11Context* xctx, Window xid, xcb_xfixes_fetch_region_cookie_t* cookie);
+// Fills rects with XRectangles. Returns false if the fetch failed.
+bool xorg_collectDamage(struct X11Context* xctx, xcb_xfixes_fetch_region_cookie_t cookie, Vector* rects);
+// Block further X requests until X has finished rendering everything queued
+// so far, so window pixmaps are complete when we bind them.
+void xorg_awaitRendering(struct X11Context* xctx);
+
+// The time between vblanks in microseconds for a mode, 0 if it doesn't say
+uint64_t xorg_modePeriod(const XRRModeInfo* mode);
+// The refresh period of the fastest active monitor, 0 if we can't tell
+uint64_t xorg_refreshPeriod(struct X11Context* xctx);
 
 struct AtomEntry {
     Atom atom;
@@ -16,13 +16,15 @@ bool xtexture_init(struct XTexture* tex, struct X11Context* context) {
 
     tex->context = context;
     tex->pixmap = 0;
+    tex->attached = false;
+    tex->bound = false;
     texture_init_nospace(&tex->texture, GL_TEXTURE_2D, NULL);
     return true;
 }
 
 void xtexture_delete(struct XTexture* tex) {
     assert(tex != NULL);
-    if(tex->bound) {
+    if(tex->attached) {
         xtexture_unbind(tex);
     }
     texture_delete(&tex->texture);
@@ -77,7 +79,7 @@ bool xtexture_bind(struct X11Context* xctx, struct XTexture* tex[], struct XText
     for(size_t i = 0; i < cnt; i++) {
         if(pixmap[i] == 0)
             continue;
-        assert(!tex[i]->bound);
+        assert(!tex[i]->attached);
     }
 
     for(size_t i = 0; i < cnt; i++) {
@@ -216,6 +218,7 @@ bool xtexture_bind(struct X11Context* xctx, struct XTexture* tex[], struct XText
     for(size_t i = 0; i < cnt; i++) {
         if(pixmap[i] == 0)
             continue;
+        tex[i]->attached = tex[i]->depth != 0;
         tex[i]->bound = tex[i]->depth != 0;
     }
 
@@ -223,7 +226,20 @@ bool xtexture_bind(struct X11Context* xctx, struct XTexture* tex[], struct XText
     return true;
 }
 
-bool xtexture_unbind(struct XTexture* tex) {
+bool xtexture_rebind(struct XTexture* tex) {
+    assert(tex != NULL);
+    assert(tex->attached);
+    assert(!tex->bound);
+
+    zone_scope(&ZONE_bind_tex_image);
+    texture_bind(&tex->texture, GL_TEXTURE0);
+    glXBindTexImageEXT(tex->context->display, tex->glxPixmap, GLX_FRONT_LEFT_EXT, NULL);
+
+    tex->bound = true;
+    return true;
+}
+
+bool xtexture_release(struct XTexture* tex) {
     assert(tex != NULL);
     assert(tex->bound);
 
@@ -231,9 +247,21 @@ bool xtexture_unbind(struct XTexture* tex) {
     glXReleaseTexImageEXT(tex->context->display, tex->glxPixmap,
             GLX_FRONT_LEFT_EXT);
 
+    tex->bound = false;
+    return true;
+}
+
+bool xtexture_unbind(struct XTexture* tex) {
+    assert(tex != NULL);
+    assert(tex->attached);
+
+    if(tex->bound) {
+        xtexture_release(tex);
+    }
+
     tex->pixmap = 0;
     glXDestroyPixmap(tex->context->display, tex->glxPixmap);
 
-    tex->bound = false;
+    tex->attached = false;
     return true;
 }
@@ -11,6 +11,9 @@
 struct XTexture {
     struct X11Context* context;
 
+    // The GLX pixmap exists
+    bool attached;
+    // The GLX pixmap is bound to the texture
     bool bound;
     int depth;
     Pixmap pixmap;
@@ -37,5 +40,13 @@ void xtexinfo_delete(struct XTextureInformation* texinfo);
 bool xtexture_init(struct XTexture* tex, struct X11Context* context);
 void xtexture_delete(struct XTexture* tex);
 
+// Create the GLX pixmaps and bind them
 bool xtexture_bind(struct X11Context* xctx, struct XTexture* tex[], struct XTextureInformation* texinfo[], xcb_pixmap_t pixmap[], size_t cnt);
+// Release and destroy the GLX pixmap
 bool xtexture_unbind(struct XTexture* tex);
+
+// Bind and release an already attached pixmap. The texture contents are only
+// guaranteed to be up to date right after binding, so this is the minimum we
+// have to do for every refresh.
+bool xtexture_rebind(struct XTexture* tex);
+bool xtexture_release(struct XTexture* tex);
@@ -129,6 +129,16 @@ struct TestResult assertEvents_internal(Vector* events, struct Event match[], si
 #define assertNotEq(var, val)               \
     return GET_ASSERT_FUNCTION(var)(#var, true, var, val)
 
+// Like assertEq, but only returns when the check fails. For the checks
+// leading up to the final assert.
+#define expectEq(var, val)                                                  \
+    do {                                                                    \
+        struct TestResult expectResult =                                    \
+            GET_ASSERT_FUNCTION(var)(#var, false, var, val);                \
+        if(!expectResult.success)                                           \
+            return expectResult;                                            \
+    } while(0)
+
 #define assertEqArray(var, val, len) \
     return assertEqArray_internal(#var, false, var, val, len)
 
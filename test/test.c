@@ -9,10 +9,22 @@
 #include "systems/physical.h"
 #include "systems/state.h"
 #include "systems/blur.h"
+#include "systems/xorg.h"
+#include "systems/occlusion.h"
+#include "systems/damage.h"
+#include "systems/shadow.h"
+#include "systems/shape.h"
 #include "windowlist.h"
+#include "winindex.h"
+#include "framesched.h"
+#include "assets/shadercache.h"
+#include "ringbuffer.h"
+#include "framegraph.h"
+#include "glstate.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <X11/Xlib-xcb.h>
 
@@ -598,6 +610,837 @@ static struct TestResult swiss__count_components__there_are_2() {
 }
 
 
+static struct TestResult winindex__find_the_window__window_is_tracked() {
+    struct WinIndex index;
+    winindex_init(&index);
+
+    winindex_add(&index, 2, 1);
+    winindex_add(&index, 3, 7);
+
+    win_id wid = winindex_find(&index, 3);
+    winindex_delete(&index);
+    assertEq(wid, 7);
+}
+
+static struct TestResult winindex__not_find_the_window__window_is_removed() {
+    struct WinIndex index;
+    winindex_init(&index);
+
+    winindex_add(&index, 2, 1);
+    winindex_remove(&index, 2, 1);
+
+    win_id wid = winindex_find(&index, 2);
+    winindex_delete(&index);
+    assertEq(wid, -1);
+}
+
+static struct TestResult winindex__find_the_new_window__xid_is_reused() {
+    struct WinIndex index;
+    winindex_init(&index);
+
+    winindex_add(&index, 2, 1);
+    winindex_add(&index, 2, 5);
+    // The old entity getting destroyed late mustn't remove the new one
+    winindex_remove(&index, 2, 1);
+
+    win_id wid = winindex_find(&index, 2);
+    winindex_delete(&index);
+    assertEq(wid, 5);
+}
+
+static struct TestResult winindex__find_every_window__2000_windows_are_tracked() {
+    struct WinIndex index;
+    winindex_init(&index);
+
+    for(win_id i = 0; i < 2000; i++) {
+        winindex_add(&index, 0x400000 + i * 3, i);
+    }
+
+    for(win_id i = 0; i < 2000; i++) {
+        if(winindex_find(&index, 0x400000 + i * 3) != i) {
+            winindex_delete(&index);
+            assertNo();
+        }
+    }
+
+    winindex_delete(&index);
+    assertYes();
+}
+
+static struct TestResult framesched__start_immediately__nothing_was_painted_yet() {
+    struct FrameScheduler sched;
+    framesched_init(&sched, NULL, 0, NULL, 16667);
+
+    uint64_t deadline = framesched_deadline(&sched, 1000000);
+    assertEq(deadline, (uint64_t)1000000);
+}
+
+static struct TestResult framesched__wait_for_next_vblank__painting_continuously() {
+    struct FrameScheduler sched;
+    framesched_init(&sched, NULL, 0, NULL, 16667);
+
+    framesched_begin(&sched, 1000000);
+    framesched_end(&sched, 1002000);
+
+    uint64_t deadline = framesched_deadline(&sched, 1003000);
+    // We have to start later, but still within the refresh
+    bool inRefresh = deadline > 1003000 && deadline < 1002000 + 16667;
+    assertEq(inRefresh, true);
+}
+
+static struct TestResult framesched__wait_for_estimated_vblank__painting_after_idle() {
+    struct FrameScheduler sched;
+    framesched_init(&sched, NULL, 0, NULL, 16667);
+
+    framesched_begin(&sched, 1000000);
+    framesched_end(&sched, 1002000);
+
+    uint64_t deadline = framesched_deadline(&sched, 5000000);
+    bool inRefresh = deadline >= 5000000 && deadline < 5000000 + 16667;
+    assertEq(inRefresh, true);
+}
+
+static struct TestResult framesched__wait_for_next_vblank__frames_are_not_submitted() {
+    struct FrameScheduler sched;
+    framesched_init(&sched, NULL, 0, NULL, 16667);
+
+    framesched_begin(&sched, 1000000);
+    framesched_end(&sched, 1002000);
+
+    // Nothing is submitted while X draws a fullscreen window, but we still
+    // have to wait for the vblanks we estimate
+    uint64_t deadline = framesched_deadline(&sched, 1026002);
+    assertEq(deadline, (uint64_t)(1002000 + 3 * 16667 - 9333));
+}
+
+static struct TestResult framesched__start_immediately__refresh_rate_is_unknown() {
+    struct FrameScheduler sched;
+    framesched_init(&sched, NULL, 0, NULL, 0);
+
+    framesched_begin(&sched, 1000000);
+    framesched_end(&sched, 1002000);
+
+    uint64_t deadline = framesched_deadline(&sched, 1003000);
+    assertEq(deadline, (uint64_t)1003000);
+}
+
+static struct TestResult framesched__leave_out_the_wait__frame_was_throttled() {
+    struct FrameScheduler sched;
+    framesched_init(&sched, NULL, 0, NULL, 16667);
+    for(size_t i = 0; i < FRAMESCHED_HISTORY; i++) {
+        framesched_begin(&sched, 1000000);
+        framesched_pause(&sched, 1001000);
+        framesched_resume(&sched, 1015000);
+        framesched_end(&sched, 1016000);
+    }
+
+    // The frames cost 2ms of work, plus the margin, to make the vblank at
+    // 1016000 + 16667
+    uint64_t deadline = framesched_deadline(&sched, 1017000);
+    assertEq(deadline, (uint64_t)(1016000 + 16667 - 3000));
+}
+
+static struct TestResult xorg__mode_period__mode_is_1080p60() {
+    XRRModeInfo mode = {
+        .dotClock = 148500000,
+        .hTotal = 2200,
+        .vTotal = 1125,
+    };
+
+    uint64_t period = xorg_modePeriod(&mode);
+    assertEq(period, (uint64_t)16666);
+}
+
+// Room for every component the system tests below put on their windows
+static void windowSwiss(Swiss* em, size_t count) {
+    swiss_clearComponentSizes(em);
+    swiss_setComponentSize(em, COMPONENT_MUD, sizeof(win));
+    swiss_setComponentSize(em, COMPONENT_PHYSICAL, sizeof(struct PhysicalComponent));
+    swiss_setComponentSize(em, COMPONENT_TRACKS_WINDOW, sizeof(struct TracksWindowComponent));
+    swiss_setComponentSize(em, COMPONENT_STATEFUL, sizeof(struct StatefulComponent));
+    swiss_setComponentSize(em, COMPONENT_SHAPED, sizeof(struct ShapedComponent));
+    swiss_setComponentSize(em, COMPONENT_SHAPE_DAMAGED, sizeof(struct ShapeDamagedEvent));
+    swiss_setComponentSize(em, COMPONENT_BINDS_TEXTURE, sizeof(struct BindsTextureComponent));
+    swiss_setComponentSize(em, COMPONENT_TEXTURED, sizeof(struct TexturedComponent));
+    swiss_setComponentSize(em, COMPONENT_Z, sizeof(struct ZComponent));
+    swiss_setComponentSize(em, COMPONENT_OPACITY, sizeof(struct OpacityComponent));
+    swiss_setComponentSize(em, COMPONENT_BGOPACITY, sizeof(struct OpacityComponent));
+    swiss_setComponentSize(em, COMPONENT_DAMAGED_REGION, sizeof(struct DamagedRegionComponent));
+    swiss_setComponentSize(em, COMPONENT_SHADOW, sizeof(struct glx_shadow_cache));
+    swiss_setComponentSize(em, COMPONENT_BLUR, sizeof(struct glx_blur_cache));
+    swiss_setComponentSize(em, COMPONENT_TINT, sizeof(struct TintComponent));
+    swiss_init(em, count);
+}
+
+static win_id addRedirectedWindow(Swiss* em, Vector* order, Vector2 pos, Vector2 size) {
+    win_id wid = swiss_allocate(em);
+    swiss_addComponent(em, COMPONENT_MUD, wid);
+    swiss_addComponent(em, COMPONENT_REDIRECTED, wid);
+
+    struct PhysicalComponent* physical = swiss_addComponent(em, COMPONENT_PHYSICAL, wid);
+    physical->position = pos;
+    physical->size = size;
+
+    struct TracksWindowComponent* tracksWindow = swiss_addComponent(em, COMPONENT_TRACKS_WINDOW, wid);
+    tracksWindow->id = wid + 1;
+    tracksWindow->border_size = 0;
+
+    struct StatefulComponent* stateful = swiss_addComponent(em, COMPONENT_STATEFUL, wid);
+    stateful->state = STATE_ACTIVE;
+
+    // A plain 24 bit visual
+    struct BindsTextureComponent* bindsTexture = swiss_addComponent(em, COMPONENT_BINDS_TEXTURE, wid);
+    bindsTexture->drawable = (struct WindowDrawable){0};
+    bindsTexture->drawable.texinfo.hasRGB = true;
+    bindsTexture->drawable.texinfo.rgbDepth = 24;
+    bindsTexture->drawable.depth = 24;
+
+    Vector rects;
+    vector_init(&rects, sizeof(struct Rect), 1);
+    vector_putBack(&rects, &(struct Rect){.pos = {{0, 1}}, .size = {{1, 1}}});
+    struct ShapedComponent* shaped = swiss_addComponent(em, COMPONENT_SHAPED, wid);
+    shaped->face = malloc(sizeof(struct face));
+    face_init_rects(shaped->face, &rects);
+    vector_kill(&rects);
+
+    vector_putBack(order, &wid);
+    return wid;
+}
+
+static struct TestResult xorgsystem__unredirect__opaque_window_covers_screen() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    struct X11Context xctx = {0};
+    Vector order;
+    vector_init(&order, sizeof(win_id), 1);
+    Vector2 canvas = {{1920, 1080}};
+
+    win_id wid = addRedirectedWindow(&em, &order, (Vector2){{0, 0}}, canvas);
+
+    xorgsystem_updateRedirection(&em, &xctx, &order, &canvas, true);
+
+    assertEq(swiss_hasComponent(&em, COMPONENT_UNREDIRECTED, wid), true);
+}
+
+static struct TestResult xorgsystem__keep_redirected__window_above_is_visible() {
+    Swiss em;
+    windowSwiss(&em, 2);
+    struct X11Context xctx = {0};
+    Vector order;
+    vector_init(&order, sizeof(win_id), 2);
+    Vector2 canvas = {{1920, 1080}};
+
+    win_id wid = addRedirectedWindow(&em, &order, (Vector2){{0, 0}}, canvas);
+    addRedirectedWindow(&em, &order, (Vector2){{100, 100}}, (Vector2){{200, 200}});
+
+    xorgsystem_updateRedirection(&em, &xctx, &order, &canvas, true);
+
+    assertEq(swiss_hasComponent(&em, COMPONENT_UNREDIRECTED, wid), false);
+}
+
+static struct TestResult xorgsystem__redirect_again__fullscreen_window_turns_transparent() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    swiss_setComponentSize(&em, COMPONENT_OPACITY, sizeof(struct OpacityComponent));
+    struct X11Context xctx = {0};
+    Vector order;
+    vector_init(&order, sizeof(win_id), 1);
+    Vector2 canvas = {{1920, 1080}};
+
+    win_id wid = addRedirectedWindow(&em, &order, (Vector2){{0, 0}}, canvas);
+    xorgsystem_updateRedirection(&em, &xctx, &order, &canvas, true);
+
+    swiss_addComponent(&em, COMPONENT_OPACITY, wid);
+    xorgsystem_updateRedirection(&em, &xctx, &order, &canvas, true);
+
+    bool redirected = swiss_hasComponent(&em, COMPONENT_REDIRECTED, wid)
+        && !swiss_hasComponent(&em, COMPONENT_UNREDIRECTED, wid);
+    assertEq(redirected, true);
+}
+
+static struct TestResult xorgsystem__keep_redirected__fullscreen_window_has_alpha() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    struct X11Context xctx = {0};
+    Vector order;
+    vector_init(&order, sizeof(win_id), 1);
+    Vector2 canvas = {{1920, 1080}};
+
+    win_id wid = addRedirectedWindow(&em, &order, (Vector2){{0, 0}}, canvas);
+    struct BindsTextureComponent* bindsTexture = swiss_getComponent(&em, COMPONENT_BINDS_TEXTURE, wid);
+    bindsTexture->drawable.texinfo.hasRGBA = true;
+    bindsTexture->drawable.texinfo.rgbDepth = 32;
+    bindsTexture->drawable.texinfo.rgbAlpha = 8;
+    bindsTexture->drawable.depth = 32;
+
+    xorgsystem_updateRedirection(&em, &xctx, &order, &canvas, true);
+
+    assertEq(swiss_hasComponent(&em, COMPONENT_UNREDIRECTED, wid), false);
+}
+
+static struct TestResult xorgsystem__keep_redirected__fullscreen_window_is_shaped() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    struct X11Context xctx = {0};
+    Vector order;
+    vector_init(&order, sizeof(win_id), 1);
+    Vector2 canvas = {{1920, 1080}};
+
+    win_id wid = addRedirectedWindow(&em, &order, (Vector2){{0, 0}}, canvas);
+    struct ShapedComponent* shaped = swiss_getComponent(&em, COMPONENT_SHAPED, wid);
+    Vector rects;
+    vector_init(&rects, sizeof(struct Rect), 2);
+    vector_putBack(&rects, &(struct Rect){.pos = {{0, 1}}, .size = {{.5, 1}}});
+    vector_putBack(&rects, &(struct Rect){.pos = {{.5, .5}}, .size = {{.5, .5}}});
+    face_init_rects(shaped->face, &rects);
+    vector_kill(&rects);
+
+    xorgsystem_updateRedirection(&em, &xctx, &order, &canvas, true);
+
+    assertEq(swiss_hasComponent(&em, COMPONENT_UNREDIRECTED, wid), false);
+}
+
+// The windows are added front to back, and all of them are opaque
+static win_id addOpaqueWindow(Swiss* em, Vector* opaque, Vector* transparent, Vector2 pos, Vector2 size) {
+    win_id wid = addRedirectedWindow(em, transparent, pos, size);
+    vector_putBack(opaque, &wid);
+    return wid;
+}
+
+static struct TestResult occlusionsystem__cull__window_is_behind_opaque_window() {
+    Swiss em;
+    Vector opaque, transparent;
+    windowSwiss(&em, 2);
+    vector_init(&opaque, sizeof(win_id), 2);
+    vector_init(&transparent, sizeof(win_id), 2);
+    Vector2 canvas = {{1920, 1080}};
+
+    addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{0, 0}}, (Vector2){{800, 600}});
+    win_id wid = addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{100, 100}}, (Vector2){{200, 200}});
+
+    occlusionsystem_tick(&em, &canvas, &opaque, &transparent);
+
+    expectEq(swiss_hasComponent(&em, COMPONENT_OCCLUDED, wid), true);
+    expectEq(opaque.size, 1);
+    assertEq(transparent.size, 1);
+}
+
+static struct TestResult occlusionsystem__keep__window_sticks_out() {
+    Swiss em;
+    Vector opaque, transparent;
+    windowSwiss(&em, 3);
+    vector_init(&opaque, sizeof(win_id), 3);
+    vector_init(&transparent, sizeof(win_id), 3);
+    Vector2 canvas = {{1920, 1080}};
+
+    // Two windows side by side, with a single pixel between them
+    addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{0, 0}}, (Vector2){{400, 600}});
+    addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{401, 0}}, (Vector2){{400, 600}});
+    win_id wid = addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{100, 100}}, (Vector2){{500, 200}});
+
+    occlusionsystem_tick(&em, &canvas, &opaque, &transparent);
+
+    expectEq(swiss_hasComponent(&em, COMPONENT_OCCLUDED, wid), false);
+    assertEq(opaque.size, 3);
+}
+
+static struct TestResult occlusionsystem__keep_shadow__shadow_sticks_out() {
+    Swiss em;
+    Vector opaque, transparent;
+    windowSwiss(&em, 2);
+    vector_init(&opaque, sizeof(win_id), 2);
+    vector_init(&transparent, sizeof(win_id), 2);
+    Vector2 canvas = {{1920, 1080}};
+
+    addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{0, 0}}, (Vector2){{800, 600}});
+    win_id wid = addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{100, 100}}, (Vector2){{700, 200}});
+    struct glx_shadow_cache* shadow = swiss_addComponent(&em, COMPONENT_SHADOW, wid);
+    shadow->border = (Vector2){{64, 64}};
+
+    occlusionsystem_tick(&em, &canvas, &opaque, &transparent);
+
+    // The body is hidden so it isn't drawn as opaque, but the shadow still is
+    expectEq(swiss_hasComponent(&em, COMPONENT_OCCLUDED, wid), false);
+    expectEq(opaque.size, 1);
+    assertEq(transparent.size, 2);
+}
+
+static struct TestResult occlusionsystem__keep__window_above_has_alpha() {
+    Swiss em;
+    Vector opaque, transparent;
+    windowSwiss(&em, 2);
+    vector_init(&opaque, sizeof(win_id), 2);
+    vector_init(&transparent, sizeof(win_id), 2);
+    Vector2 canvas = {{1920, 1080}};
+
+    win_id argb = addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{0, 0}}, (Vector2){{800, 600}});
+    struct BindsTextureComponent* bindsTexture = swiss_getComponent(&em, COMPONENT_BINDS_TEXTURE, argb);
+    bindsTexture->drawable.texinfo.hasRGBA = true;
+    bindsTexture->drawable.texinfo.rgbDepth = 32;
+    bindsTexture->drawable.texinfo.rgbAlpha = 8;
+    bindsTexture->drawable.depth = 32;
+    win_id wid = addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{100, 100}}, (Vector2){{200, 200}});
+
+    occlusionsystem_tick(&em, &canvas, &opaque, &transparent);
+
+    assertEq(swiss_hasComponent(&em, COMPONENT_OCCLUDED, wid), false);
+}
+
+static struct TestResult occlusionsystem__cull__window_is_off_screen() {
+    Swiss em;
+    Vector opaque, transparent;
+    windowSwiss(&em, 1);
+    vector_init(&opaque, sizeof(win_id), 1);
+    vector_init(&transparent, sizeof(win_id), 1);
+    Vector2 canvas = {{1920, 1080}};
+
+    win_id wid = addOpaqueWindow(&em, &opaque, &transparent, (Vector2){{2000, 0}}, (Vector2){{200, 200}});
+
+    occlusionsystem_tick(&em, &canvas, &opaque, &transparent);
+
+    assertEq(swiss_hasComponent(&em, COMPONENT_OCCLUDED, wid), true);
+}
+
+static win_id addPaintedWindow(Swiss* em, Vector* painted, Vector2 pos, Vector2 size) {
+    win_id wid = swiss_allocate(em);
+    struct PhysicalComponent* physical = swiss_addComponent(em, COMPONENT_PHYSICAL, wid);
+    physical->position = pos;
+    physical->size = size;
+    struct TexturedComponent* textured = swiss_addComponent(em, COMPONENT_TEXTURED, wid);
+    textured->texture.size = size;
+    struct ZComponent* z = swiss_addComponent(em, COMPONENT_Z, wid);
+    z->z = 0.5;
+
+    vector_putBack(painted, &wid);
+    return wid;
+}
+
+static struct TestResult damagesystem__damage_old_and_new_position__window_moves() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    struct ScreenDamage damage;
+    damagesystem_init(&damage);
+    Vector painted;
+    vector_init(&painted, sizeof(win_id), 1);
+
+    win_id wid = addPaintedWindow(&em, &painted, (Vector2){{0, 0}}, (Vector2){{100, 100}});
+    damagesystem_tick(&em, &damage, &painted, true);
+
+    struct PhysicalComponent* physical = swiss_getComponent(&em, COMPONENT_PHYSICAL, wid);
+    physical->position = (Vector2){{200, 0}};
+    damagesystem_tick(&em, &damage, &painted, false);
+
+    damagesystem_region(&damage, 1);
+    expectEq(damage.region.size, 2);
+    struct Rect* old = vector_get(&damage.region, 0);
+    struct Rect* new = vector_get(&damage.region, 1);
+    expectEq(old->pos, ((Vector2){{0, 0}}));
+    assertEq(new->pos, ((Vector2){{200, 0}}));
+}
+
+static struct TestResult damagesystem__damage_region__contents_are_partially_damaged() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    struct ScreenDamage damage;
+    damagesystem_init(&damage);
+    Vector painted;
+    vector_init(&painted, sizeof(win_id), 1);
+
+    win_id wid = addPaintedWindow(&em, &painted, (Vector2){{100, 100}}, (Vector2){{100, 100}});
+    damagesystem_tick(&em, &damage, &painted, true);
+
+    swiss_addComponent(&em, COMPONENT_CONTENTS_DAMAGED, wid);
+    struct DamagedRegionComponent* region = swiss_addComponent(&em, COMPONENT_DAMAGED_REGION, wid);
+    vector_init(&region->rects, sizeof(struct Rect), 1);
+    vector_putBack(&region->rects, &(struct Rect){.pos = {{10, 20}}, .size = {{8, 16}}});
+    damagesystem_tick(&em, &damage, &painted, false);
+
+    damagesystem_region(&damage, 1);
+    expectEq(damage.region.size, 1);
+    struct Rect* rect = vector_get(&damage.region, 0);
+    expectEq(rect->pos, ((Vector2){{110, 120}}));
+    assertEq(rect->size, ((Vector2){{8, 16}}));
+}
+
+static struct TestResult damagesystem__damage_old_position__window_stops_being_painted() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    struct ScreenDamage damage;
+    damagesystem_init(&damage);
+    Vector painted;
+    vector_init(&painted, sizeof(win_id), 1);
+
+    addPaintedWindow(&em, &painted, (Vector2){{0, 0}}, (Vector2){{100, 100}});
+    damagesystem_tick(&em, &damage, &painted, true);
+
+    vector_clear(&painted);
+    damagesystem_tick(&em, &damage, &painted, false);
+
+    damagesystem_region(&damage, 1);
+    assertEq(damage.region.size, 1);
+}
+
+static struct TestResult damagesystem__paint_everything__buffer_is_older_than_the_damage() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    struct ScreenDamage damage;
+    damagesystem_init(&damage);
+    Vector painted;
+    vector_init(&painted, sizeof(win_id), 1);
+
+    addPaintedWindow(&em, &painted, (Vector2){{0, 0}}, (Vector2){{100, 100}});
+    damagesystem_tick(&em, &damage, &painted, true);
+    damagesystem_tick(&em, &damage, &painted, false);
+
+    // The full repaint is part of what a two frame old buffer missed
+    bool partial = damagesystem_region(&damage, 2);
+    assertEq(partial, false);
+}
+
+static struct TestResult damagesystem__paint_nothing__nothing_changed() {
+    Swiss em;
+    windowSwiss(&em, 1);
+    struct ScreenDamage damage;
+    damagesystem_init(&damage);
+    Vector painted;
+    vector_init(&painted, sizeof(win_id), 1);
+
+    addPaintedWindow(&em, &painted, (Vector2){{0, 0}}, (Vector2){{100, 100}});
+    damagesystem_tick(&em, &damage, &painted, true);
+    damagesystem_tick(&em, &damage, &painted, false);
+    damagesystem_tick(&em, &damage, &painted, false);
+
+    bool partial = damagesystem_region(&damage, 2);
+    expectEq(partial, true);
+    assertEq(damage.region.size, 0);
+}
+
+static struct TestResult shadercache__read_binary__driver_is_the_same() {
+    char path[] = "/tmp/neocomp-shadercache-XXXXXX";
+    close(mkstemp(path));
+
+    const char binary[] = "not really a program";
+    shadercache_write_file(path, "vendor\nrenderer\n4.6", 0x1234, binary, sizeof(binary));
+
+    GLenum format;
+    void* read;
+    size_t length;
+    bool found = shadercache_read_file(path, "vendor\nrenderer\n4.6", &format, &read, &length);
+    unlink(path);
+
+    expectEq(found, true);
+    // The assert returns, so free the binary before comparing
+    char contents[sizeof(binary)] = {0};
+    memcpy(contents, read, length < sizeof(contents) ? length : sizeof(contents));
+    free(read);
+
+    expectEq((uint64_t)format, 0x1234);
+    expectEq(length, sizeof(binary));
+    assertEqString(contents, binary, sizeof(binary));
+}
+
+static struct TestResult shadercache__reject_binary__driver_changed() {
+    char path[] = "/tmp/neocomp-shadercache-XXXXXX";
+    close(mkstemp(path));
+
+    const char binary[] = "not really a program";
+    shadercache_write_file(path, "vendor\nrenderer\n4.6", 0x1234, binary, sizeof(binary));
+
+    GLenum format;
+    void* read;
+    size_t length;
+    bool found = shadercache_read_file(path, "vendor\nrenderer\n4.7", &format, &read, &length);
+    unlink(path);
+
+    assertEq(found, false);
+}
+
+static struct TestResult shadercache__change_key__source_changes() {
+    const char source[] = "void main() {}";
+    const char edited[] = "void main() { }";
+
+    uint64_t key = shadercache_hash(SHADERCACHE_HASH_SEED, source, sizeof(source));
+    uint64_t edited_key = shadercache_hash(SHADERCACHE_HASH_SEED, edited, sizeof(edited));
+
+    assertNotEq(key, edited_key);
+}
+
+static struct TestResult ringbuffer__wrap_around__oldest_frame_finished() {
+    struct RingBuffer ring;
+    ringbuffer_reset(&ring, 100, 2);
+    size_t offset;
+
+    bool reserved;
+    ringbuffer_beginFrame(&ring, 0);
+    reserved = ringbuffer_reserve(&ring, 60, 4, &offset);
+    expectEq(reserved, true);
+    ringbuffer_beginFrame(&ring, 1);
+    reserved = ringbuffer_reserve(&ring, 30, 4, &offset);
+    expectEq(reserved, true);
+    // Frame 0 is done when we reuse its slot
+    ringbuffer_beginFrame(&ring, 0);
+    reserved = ringbuffer_reserve(&ring, 40, 4, &offset);
+    expectEq(reserved, true);
+
+    assertEq(offset, 0);
+}
+
+static struct TestResult ringbuffer__refuse__frames_in_flight_fill_it() {
+    struct RingBuffer ring;
+    ringbuffer_reset(&ring, 100, 2);
+    size_t offset;
+
+    ringbuffer_beginFrame(&ring, 0);
+    bool reserved = ringbuffer_reserve(&ring, 60, 4, &offset);
+    expectEq(reserved, true);
+    ringbuffer_beginFrame(&ring, 1);
+
+    // Only 40 bytes are free, and frame 0 is still in flight
+    reserved = ringbuffer_reserve(&ring, 50, 4, &offset);
+    assertEq(reserved, false);
+}
+
+static struct TestResult ringbuffer__align_offset__previous_write_is_unaligned() {
+    struct RingBuffer ring;
+    ringbuffer_reset(&ring, 100, 2);
+    size_t offset;
+
+    bool reserved;
+    ringbuffer_beginFrame(&ring, 0);
+    reserved = ringbuffer_reserve(&ring, 5, 1, &offset);
+    expectEq(reserved, true);
+    reserved = ringbuffer_reserve(&ring, 8, 16, &offset);
+    expectEq(reserved, true);
+
+    assertEq(offset, 16);
+}
+
+static struct TestResult glstate__select_unit__texture_is_already_bound_there() {
+    glstate_invalidate();
+    glstate_bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 5);
+    glstate_bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, 6);
+    struct GLStateCounts counts;
+    glstate_takeCounts(&counts);
+
+    // Only the texture is known, the active unit still has to change
+    glstate_bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, 5);
+    glstate_takeCounts(&counts);
+
+    assertEq(counts.issued, 1);
+}
+
+static void nopPass(struct FrameGraph* graph, void* userdata) {
+}
+
+static struct TestResult framegraph__cull_pass__nothing_reads_its_output() {
+    struct FrameGraph graph;
+    framegraph_init(&graph);
+    size_t back = framegraph_resource(&graph, "back", FRAMEGRAPH_COLOR, FRAMEGRAPH_OUTPUT);
+    size_t shadows = framegraph_resource(&graph, "shadows", FRAMEGRAPH_COLOR, FRAMEGRAPH_IMPORTED);
+
+    size_t shadow = framegraph_pass(&graph, "shadow", nopPass, NULL);
+    framegraph_write(&graph, shadow, shadows);
+    size_t draw = framegraph_pass(&graph, "draw", nopPass, NULL);
+    framegraph_write(&graph, draw, back);
+
+    framegraph_compile(&graph);
+
+    expectEq(graph.passes[draw].culled, false);
+    assertEq(graph.passes[shadow].culled, true);
+}
+
+static struct TestResult framegraph__keep_pass__a_kept_pass_reads_its_output() {
+    struct FrameGraph graph;
+    framegraph_init(&graph);
+    size_t back = framegraph_resource(&graph, "back", FRAMEGRAPH_COLOR, FRAMEGRAPH_OUTPUT);
+    size_t shadows = framegraph_resource(&graph, "shadows", FRAMEGRAPH_COLOR, FRAMEGRAPH_IMPORTED);
+
+    size_t shadow = framegraph_pass(&graph, "shadow", nopPass, NULL);
+    framegraph_write(&graph, shadow, shadows);
+    size_t draw = framegraph_pass(&graph, "draw", nopPass, NULL);
+    framegraph_read(&graph, draw, shadows);
+    framegraph_write(&graph, draw, back);
+
+    framegraph_compile(&graph);
+
+    uint64_t barriers = graph.passes[draw].barriers;
+    expectEq(barriers, 1u << shadows);
+    assertEq(graph.passes[shadow].culled, false);
+}
+
+static struct TestResult framegraph__alias_transients__lifetimes_dont_overlap() {
+    struct FrameGraph graph;
+    framegraph_init(&graph);
+    Vector2 size = {{64, 64}};
+    size_t back = framegraph_resource(&graph, "back", FRAMEGRAPH_COLOR, FRAMEGRAPH_OUTPUT);
+    size_t first = framegraph_transient(&graph, "first", &size);
+    size_t second = framegraph_transient(&graph, "second", &size);
+
+    size_t pass = framegraph_pass(&graph, "make first", nopPass, NULL);
+    framegraph_write(&graph, pass, first);
+    pass = framegraph_pass(&graph, "use first", nopPass, NULL);
+    framegraph_read(&graph, pass, first);
+    framegraph_write(&graph, pass, back);
+    pass = framegraph_pass(&graph, "make second", nopPass, NULL);
+    framegraph_write(&graph, pass, second);
+    pass = framegraph_pass(&graph, "use second", nopPass, NULL);
+    framegraph_read(&graph, pass, second);
+    framegraph_write(&graph, pass, back);
+
+    framegraph_compile(&graph);
+
+    long firstSlot = graph.resources[first].slot;
+    expectEq(firstSlot, 0);
+    long slot = graph.resources[second].slot;
+    assertEq(slot, 0);
+}
+
+static struct TestResult framegraph__separate_transients__lifetimes_overlap() {
+    struct FrameGraph graph;
+    framegraph_init(&graph);
+    Vector2 size = {{64, 64}};
+    size_t back = framegraph_resource(&graph, "back", FRAMEGRAPH_COLOR, FRAMEGRAPH_OUTPUT);
+    size_t first = framegraph_transient(&graph, "first", &size);
+    size_t second = framegraph_transient(&graph, "second", &size);
+
+    size_t pass = framegraph_pass(&graph, "make both", nopPass, NULL);
+    framegraph_write(&graph, pass, first);
+    framegraph_write(&graph, pass, second);
+    pass = framegraph_pass(&graph, "use both", nopPass, NULL);
+    framegraph_read(&graph, pass, first);
+    framegraph_read(&graph, pass, second);
+    framegraph_write(&graph, pass, back);
+
+    framegraph_compile(&graph);
+
+    long firstSlot = graph.resources[first].slot;
+    expectEq(firstSlot, 0);
+    long slot = graph.resources[second].slot;
+    assertEq(slot, 1);
+}
+
+static win_id shapedWindow(Swiss* em, XWindowAttributes* attrs) {
+    windowSwiss(em, 1);
+
+    win_id wid = swiss_allocate(em);
+    swiss_addComponent(em, COMPONENT_NEW, wid);
+    swiss_addComponent(em, COMPONENT_PHYSICAL, wid);
+    struct TracksWindowComponent* tracksWindow = swiss_addComponent(em, COMPONENT_TRACKS_WINDOW, wid);
+    tracksWindow->id = 1;
+
+    *attrs = (XWindowAttributes){.width = 64, .height = 64};
+    setWindowAttr(tracksWindow->id, attrs);
+    return wid;
+}
+
+static struct TestResult shapesystem__merge_into_one_rect__shape_is_split_into_pixels() {
+    Swiss em;
+    XWindowAttributes attrs;
+    win_id wid = shapedWindow(&em, &attrs);
+    struct X11Context xctx = {0};
+
+    // Every pixel of the window as its own rectangle, backwards
+    XRectangle pixels[64 * 64];
+    for(int i = 0; i < 64 * 64; i++) {
+        int pixel = 64 * 64 - 1 - i;
+        pixels[i] = (XRectangle){.x = pixel % 64, .y = pixel / 64, .width = 1, .height = 1};
+    }
+    setRegion(pixels, 64 * 64);
+
+    shapesystem_updateShapes(&em, &xctx);
+    setRegion(NULL, 0);
+
+    bool rectangular = shapesystem_isRectangular(&em, wid);
+    assertEq(rectangular, true);
+}
+
+static struct TestResult shapesystem__keep_rows_apart__spans_differ() {
+    Swiss em;
+    XWindowAttributes attrs;
+    win_id wid = shapedWindow(&em, &attrs);
+    struct X11Context xctx = {0};
+
+    // A rounded top: a narrow row over a wide body, each as a stack of
+    // single pixel rows
+    XRectangle rows[64];
+    for(int i = 0; i < 64; i++) {
+        if(i < 4) {
+            rows[i] = (XRectangle){.x = 4, .y = i, .width = 56, .height = 1};
+        } else {
+            rows[i] = (XRectangle){.x = 0, .y = i, .width = 64, .height = 1};
+        }
+    }
+    setRegion(rows, 64);
+
+    shapesystem_updateShapes(&em, &xctx);
+    setRegion(NULL, 0);
+
+    Vector rects;
+    vector_init(&rects, sizeof(struct Rect), 2);
+    shapesystem_screenRects(&em, wid, &rects);
+    assertEq(rects.size, 2);
+}
+
+static struct TestResult shapesystem__draw_two_triangles_per_rect__shape_is_indexed() {
+    Swiss em;
+    XWindowAttributes attrs;
+    win_id wid = shapedWindow(&em, &attrs);
+    struct X11Context xctx = {0};
+
+    XRectangle rect = {.x = 0, .y = 0, .width = 64, .height = 64};
+    setRegion(&rect, 1);
+
+    shapesystem_updateShapes(&em, &xctx);
+    setRegion(NULL, 0);
+
+    struct ShapedComponent* shaped = swiss_getComponent(&em, COMPONENT_SHAPED, wid);
+    expectEq(shaped->face->vertex_buffer.size, 4 * 3);
+    assertEq(shaped->face->index_buffer.size, 6);
+}
+
+static win_id featuredWindow(Swiss* em) {
+    windowSwiss(em, 1);
+
+    win_id wid = swiss_allocate(em);
+    swiss_addComponent(em, COMPONENT_TEXTURED, wid);
+    swiss_addComponent(em, COMPONENT_BGOPACITY, wid);
+    return wid;
+}
+
+static struct TestResult windowlist__combine_all_passes__window_is_blurred_and_tinted() {
+    Swiss swiss;
+    win_id wid = featuredWindow(&swiss);
+    swiss_addComponent(&swiss, COMPONENT_BLUR, wid);
+    swiss_addComponent(&swiss, COMPONENT_TINT, wid);
+
+    uint64_t features = windowlist_features(&swiss, wid);
+
+    assertEq(features, WINDOW_FEATURE_BACKGROUND | WINDOW_FEATURE_TINT | WINDOW_FEATURE_CONTENT);
+}
+
+static struct TestResult windowlist__skip_background__window_is_not_textured() {
+    Swiss swiss;
+    win_id wid = featuredWindow(&swiss);
+    swiss_addComponent(&swiss, COMPONENT_BLUR, wid);
+    swiss_addComponent(&swiss, COMPONENT_TINT, wid);
+    swiss_removeComponent(&swiss, COMPONENT_TEXTURED, wid);
+
+    uint64_t features = windowlist_features(&swiss, wid);
+
+    assertEq(features, WINDOW_FEATURE_TINT);
+}
+
+static struct TestResult windowlist__draw_nothing__window_has_no_background_opacity() {
+    Swiss swiss;
+    win_id wid = featuredWindow(&swiss);
+    swiss_addComponent(&swiss, COMPONENT_BLUR, wid);
+    swiss_removeComponent(&swiss, COMPONENT_BGOPACITY, wid);
+
+    uint64_t features = windowlist_features(&swiss, wid);
+
+    assertEq(features, 0);
+}
+
 struct TestResult bezier__not_crash__initializing_bezier_curve() {
     struct Bezier b;
 
@@ -1384,6 +2227,58 @@ struct TestResult xorg__emit_add_win_event__inactive_window_gets_reparented_to_r
     );
 }
 
+struct TestResult xorg__emit_add_win_with_geometry__window_gets_created_and_reparented_to_root_together() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+        .x = 10,
+        .y = 20,
+        .width = 100,
+        .height = 200,
+    };
+    setWindowAttr(2, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .serial = 1,
+        .parent = 10,
+        .window = 2,
+    });
+    vector_putBack(&eventQ, &(XReparentEvent){
+        .type = ReparentNotify,
+        .serial = 2,
+        .parent = 0,
+        .window = 2,
+    });
+
+    Vector* events = readAllEvents(&ctx);
+    if(vector_size(events) != 1)
+        assertNo();
+    struct Event* event = vector_get(events, 0);
+    assertEq(event->add.size, ((Vector2){{100, 200}}));
+}
+
+struct TestResult xorg__emit_nothing__unknown_window_gets_reparented_to_root() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    vector_putBack(&eventQ, &(XReparentEvent){
+        .type = ReparentNotify,
+        .serial = 2,
+        .parent = 0,
+        .window = 77,
+    });
+
+    Vector* events = readAllEvents(&ctx);
+    assertEvents(events,
+    );
+}
+
 struct TestResult xorg__emit_destroy_win_event__active_window_gets_reparented_to_other_window() {
     struct X11Context ctx;
     struct Atoms atoms;
@@ -1524,6 +2419,57 @@ struct TestResult xorg__emit_get_client__child_window_gets_client_atom() {
     );
 }
 
+struct TestResult xorg__emit_get_client__destroyed_client_id_is_reused() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    setWindowAttr(2, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 2,
+        .parent = 1,
+    });
+    vector_putBack(&eventQ, &(XPropertyEvent){
+        .type = PropertyNotify,
+        .window = 2,
+        .atom = atoms.atom_client,
+        .state = PropertyNewValue,
+    });
+    vector_putBack(&eventQ, &(XDestroyWindowEvent){
+        .type = DestroyNotify,
+        .window = 2,
+    });
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 2,
+        .parent = 1,
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XPropertyEvent){
+        .type = PropertyNotify,
+        .window = 2,
+        .atom = atoms.atom_client,
+        .state = PropertyNewValue,
+    });
+    Vector* events = readAllEvents(&ctx);
+
+    assertEvents(events,
+        (struct Event){.type = ET_CLIENT, .cli.xid = 1, .cli.client_xid = 2}
+    );
+}
+
 struct TestResult xorg__emit_get_client__client_window_becomes_child_of_frame() {
     struct X11Context ctx;
     struct Atoms atoms;
@@ -1608,6 +2554,60 @@ struct TestResult xorg__emit_get_client__subsubwindow_becomes_client() {
     );
 }
 
+struct TestResult xorg__emit_get_client__closer_client_appears_after_distant_client() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    setWindowAttr(2, &attr);
+    setWindowAttr(3, &attr);
+    setWindowAttr(4, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 2,
+        .parent = 1,
+    });
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 3,
+        .parent = 2,
+    });
+    vector_putBack(&eventQ, &(XPropertyEvent){
+        .type = PropertyNotify,
+        .window = 3,
+        .atom = atoms.atom_client,
+        .state = PropertyNewValue,
+    });
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 4,
+        .parent = 1,
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XPropertyEvent){
+        .type = PropertyNotify,
+        .window = 4,
+        .atom = atoms.atom_client,
+        .state = PropertyNewValue,
+    });
+    Vector* events = readAllEvents(&ctx);
+
+    assertEvents(events,
+        (struct Event){.type = ET_CLIENT, .cli.xid = 1, .cli.client_xid = 4}
+    );
+}
+
 struct TestResult xorg__emit_get_client__client_reparents_to_subwindow() {
     struct X11Context ctx;
     struct Atoms atoms;
@@ -2132,28 +3132,153 @@ struct TestResult xorg__adjust_window_for_border__window_is_configured_with_bord
     vector_putBack(&eventQ, &(XCreateWindowEvent){
         .type = CreateNotify,
         .window = 1,
-        .parent = 0,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = ConfigureNotify,
+        .window = 1,
+        .border_width = 10,
+        .x = 10,
+        .y = 20,
+        .width = 100,
+        .height = 200,
+    });
+    Vector* events = readAllEvents(&ctx);
+
+    assertEvents(events,
+        (struct Event){.type = ET_MANDR, .mandr.xid=1, .mandr.pos=(Vector2){{0, 10}}, .mandr.size=(Vector2){{120, 220}}},
+        (struct Event){.type = ET_RESTACK, .restack.xid=1, .restack.loc=LOC_BELOW, .restack.above=0}
+    );
+}
+
+struct TestResult xorg__coalesce_mandr__window_is_configured_twice() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XConfigureEvent){
+        .type = ConfigureNotify,
+        .window = 1,
+        .width = 100,
+        .height = 200,
+    });
+    vector_putBack(&eventQ, &(XConfigureEvent){
+        .type = ConfigureNotify,
+        .window = 1,
+        .x = 10,
+        .y = 20,
+        .width = 300,
+        .height = 400,
+    });
+    Vector* events = readAllEvents(&ctx);
+
+    assertEvents(events,
+        (struct Event){.type = ET_RESTACK, .restack.xid=1, .restack.loc=LOC_BELOW, .restack.above=0},
+        (struct Event){.type = ET_MANDR, .mandr.xid=1, .mandr.pos=(Vector2){{10, 20}}, .mandr.size=(Vector2){{300, 400}}},
+        (struct Event){.type = ET_RESTACK, .restack.xid=1, .restack.loc=LOC_BELOW, .restack.above=0},
+    );
+}
+
+struct TestResult xorg__coalesce_damage__mapped_window_is_damaged_twice() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+    });
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+    });
+    readAllEvents(&ctx);
+
+    assertEq(ctx.coalesced, 1);
+}
+
+struct TestResult xorg__not_coalesce_damage__window_is_remapped_between_damage() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+    });
+    vector_putBack(&eventQ, &(XUnmapEvent){
+        .type = UnmapNotify,
+        .window = 1,
     });
     vector_putBack(&eventQ, &(XMapEvent){
         .type = MapNotify,
         .window = 1,
     });
-    readAllEvents(&ctx);
-
-    vector_putBack(&eventQ, &(XCreateWindowEvent){
-        .type = ConfigureNotify,
-        .window = 1,
-        .border_width = 10,
-        .x = 10,
-        .y = 20,
-        .width = 100,
-        .height = 200,
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
     });
     Vector* events = readAllEvents(&ctx);
 
     assertEvents(events,
-        (struct Event){.type = ET_MANDR, .mandr.xid=1, .mandr.pos=(Vector2){{0, 10}}, .mandr.size=(Vector2){{120, 220}}},
-        (struct Event){.type = ET_RESTACK, .restack.xid=1, .restack.loc=LOC_BELOW, .restack.above=0}
+        (struct Event){.type = ET_DAMAGE, .damage.xid = 1},
+        (struct Event){.type = ET_UNMAP, .unmap.xid = 1},
+        (struct Event){.type = ET_MAP, .map.xid = 1},
+        (struct Event){.type = ET_DAMAGE, .damage.xid = 1},
     );
 }
 
@@ -2960,6 +4085,222 @@ struct TestResult xorg__emit_damage__mapped_window_is_damaged() {
     );
 }
 
+struct TestResult xorg__emit_nothing__mapped_window_is_damaged_by_move() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+        .area = {0, 0, 100, 100},
+        .geometry = {0, 0, 100, 100},
+    });
+    vector_putBack(&eventQ, &(XConfigureEvent){
+        .type = ConfigureNotify,
+        .window = 1,
+        .x = 50,
+        .width = 100,
+        .height = 100,
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+        .area = {0, 0, 100, 100},
+        .geometry = {50, 0, 100, 100},
+    });
+    Vector* events = readAllEvents(&ctx);
+
+    assertEvents(events,
+    );
+}
+
+struct TestResult xorg__emit_damage__window_is_fully_damaged_without_configure() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+        .area = {0, 0, 100, 100},
+        .geometry = {0, 0, 100, 100},
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+        .area = {0, 0, 100, 100},
+        .geometry = {50, 0, 100, 100},
+    });
+    Vector* events = readAllEvents(&ctx);
+
+    assertEvents(events,
+        (struct Event){.type = ET_DAMAGE, .damage.xid = 1}
+    );
+}
+
+struct TestResult xorg__emit_damage__window_is_remapped_somewhere_else() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+        .area = {0, 0, 100, 100},
+        .geometry = {0, 0, 100, 100},
+    });
+    vector_putBack(&eventQ, &(XUnmapEvent){
+        .type = UnmapNotify,
+        .window = 1,
+    });
+    vector_putBack(&eventQ, &(XConfigureEvent){
+        .type = ConfigureNotify,
+        .window = 1,
+        .x = 50,
+        .width = 100,
+        .height = 100,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+        .area = {0, 0, 100, 100},
+        .geometry = {50, 0, 100, 100},
+    });
+    Vector* events = readAllEvents(&ctx);
+
+    assertEvents(events,
+        (struct Event){.type = ET_DAMAGE, .damage.xid = 1}
+    );
+}
+
+struct TestResult xorg__emit_damage__moved_window_is_partially_damaged() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+        .area = {0, 0, 100, 100},
+        .geometry = {0, 0, 100, 100},
+    });
+    readAllEvents(&ctx);
+
+    vector_putBack(&eventQ, &(XDamageNotifyEvent){
+        .type = ctx.capabilities.event[PROTO_DAMAGE] - XDamageNotify,
+        .drawable = 1,
+        .area = {10, 10, 20, 20},
+        .geometry = {50, 0, 100, 100},
+    });
+    Vector* events = readAllEvents(&ctx);
+
+    assertEvents(events,
+        (struct Event){.type = ET_DAMAGE, .damage.xid = 1}
+    );
+}
+
+struct TestResult xorg__collect_damage__damage_was_requested() {
+    struct X11Context ctx;
+    struct Atoms atoms;
+    Display* dpy = (void*)0x01;
+    xorgContext_init(&ctx, dpy, 0, &atoms);
+
+    XWindowAttributes attr = {
+        .class = InputOutput,
+    };
+    setWindowAttr(1, &attr);
+    vector_putBack(&eventQ, &(XCreateWindowEvent){
+        .type = CreateNotify,
+        .window = 1,
+        .parent = 0,
+    });
+    vector_putBack(&eventQ, &(XMapEvent){
+        .type = MapNotify,
+        .window = 1,
+    });
+    readAllEvents(&ctx);
+
+    XRectangle damaged[] = {{1, 2, 3, 4}, {10, 20, 30, 40}};
+    setRegion(damaged, 2);
+    xcb_xfixes_fetch_region_cookie_t cookie;
+    bool requested = xorg_requestDamage(&ctx, 1, &cookie);
+    Vector rects;
+    vector_init(&rects, sizeof(XRectangle), 2);
+    bool collected = xorg_collectDamage(&ctx, cookie, &rects);
+    setRegion(NULL, 0);
+
+    if(!requested || !collected)
+        assertNo();
+    assertEqArray(rects.data, damaged, sizeof(damaged));
+}
+
 struct TestResult xorg__emit_nothing__bypassed_window_is_damaged() {
     struct X11Context ctx;
     struct Atoms atoms;
@@ -3298,6 +4639,82 @@ struct TestResult blursystem__damage_blur__window_below_is_fading() {
 
 // I don't really know if I want a test for this. If this behaviour breaks it
 // doesn't actually cause any problems.
+struct TestResult blursystem__not_damage_blur__window_below_is_damaged_outside_window_above() {
+    Swiss em;
+    swiss_clearComponentSizes(&em);
+    swiss_setComponentSize(&em, COMPONENT_PHYSICAL, sizeof(struct PhysicalComponent));
+    swiss_setComponentSize(&em, COMPONENT_DAMAGED_REGION, sizeof(struct DamagedRegionComponent));
+    swiss_init(&em, 2);
+
+    win_id below = swiss_allocate(&em);
+    {
+        struct PhysicalComponent* p = swiss_addComponent(&em, COMPONENT_PHYSICAL, below);
+        p->position = (Vector2){{0, 0}};
+        p->size = (Vector2){{100, 100}};
+        swiss_addComponent(&em, COMPONENT_CONTENTS_DAMAGED, below);
+        struct DamagedRegionComponent* region = swiss_addComponent(&em, COMPONENT_DAMAGED_REGION, below);
+        vector_init(&region->rects, sizeof(struct Rect), 1);
+        vector_putBack(&region->rects, &(struct Rect){
+            .pos = {{0, 0}},
+            .size = {{10, 10}},
+        });
+    }
+    win_id above = swiss_allocate(&em);
+    {
+        swiss_addComponent(&em, COMPONENT_BLUR, above);
+        struct PhysicalComponent* p = swiss_addComponent(&em, COMPONENT_PHYSICAL, above);
+        p->position = (Vector2){{50, 50}};
+        p->size = (Vector2){{100, 100}};
+    }
+
+    Vector order;
+    vector_init(&order, sizeof(uint64_t), 2);
+    vector_putBack(&order, &below);
+    vector_putBack(&order, &above);
+
+    blursystem_tick(&em, &order);
+
+    assertEq(swiss_hasComponent(&em, COMPONENT_BLUR_DAMAGED, above), false);
+}
+
+struct TestResult blursystem__damage_blur__window_below_is_damaged_under_window_above() {
+    Swiss em;
+    swiss_clearComponentSizes(&em);
+    swiss_setComponentSize(&em, COMPONENT_PHYSICAL, sizeof(struct PhysicalComponent));
+    swiss_setComponentSize(&em, COMPONENT_DAMAGED_REGION, sizeof(struct DamagedRegionComponent));
+    swiss_init(&em, 2);
+
+    win_id below = swiss_allocate(&em);
+    {
+        struct PhysicalComponent* p = swiss_addComponent(&em, COMPONENT_PHYSICAL, below);
+        p->position = (Vector2){{0, 0}};
+        p->size = (Vector2){{100, 100}};
+        swiss_addComponent(&em, COMPONENT_CONTENTS_DAMAGED, below);
+        struct DamagedRegionComponent* region = swiss_addComponent(&em, COMPONENT_DAMAGED_REGION, below);
+        vector_init(&region->rects, sizeof(struct Rect), 1);
+        vector_putBack(&region->rects, &(struct Rect){
+            .pos = {{60, 60}},
+            .size = {{10, 10}},
+        });
+    }
+    win_id above = swiss_allocate(&em);
+    {
+        swiss_addComponent(&em, COMPONENT_BLUR, above);
+        struct PhysicalComponent* p = swiss_addComponent(&em, COMPONENT_PHYSICAL, above);
+        p->position = (Vector2){{50, 50}};
+        p->size = (Vector2){{100, 100}};
+    }
+
+    Vector order;
+    vector_init(&order, sizeof(uint64_t), 2);
+    vector_putBack(&order, &below);
+    vector_putBack(&order, &above);
+
+    blursystem_tick(&em, &order);
+
+    assertEq(swiss_hasComponent(&em, COMPONENT_BLUR_DAMAGED, above), true);
+}
+
 struct TestResult blursystem__not_damage_blur__window_below_is_not_ovelapping() {
     Swiss em;
     swiss_clearComponentSizes(&em);
@@ -3408,6 +4825,60 @@ int main(int argc, char** argv) {
     TEST(swiss__iterate_elements__there_are_100_elements);
     TEST(swiss__count_components__there_are_2);
 
+    TEST(winindex__find_the_window__window_is_tracked);
+    TEST(winindex__not_find_the_window__window_is_removed);
+    TEST(winindex__find_the_new_window__xid_is_reused);
+    TEST(winindex__find_every_window__2000_windows_are_tracked);
+
+    TEST(framesched__start_immediately__nothing_was_painted_yet);
+    TEST(framesched__wait_for_next_vblank__painting_continuously);
+    TEST(framesched__wait_for_estimated_vblank__painting_after_idle);
+    TEST(framesched__wait_for_next_vblank__frames_are_not_submitted);
+    TEST(framesched__start_immediately__refresh_rate_is_unknown);
+    TEST(framesched__leave_out_the_wait__frame_was_throttled);
+    TEST(xorg__mode_period__mode_is_1080p60);
+
+    TEST(xorgsystem__unredirect__opaque_window_covers_screen);
+    TEST(xorgsystem__keep_redirected__window_above_is_visible);
+    TEST(xorgsystem__redirect_again__fullscreen_window_turns_transparent);
+    TEST(xorgsystem__keep_redirected__fullscreen_window_has_alpha);
+    TEST(xorgsystem__keep_redirected__fullscreen_window_is_shaped);
+
+    TEST(occlusionsystem__cull__window_is_behind_opaque_window);
+    TEST(occlusionsystem__keep__window_sticks_out);
+    TEST(occlusionsystem__keep_shadow__shadow_sticks_out);
+    TEST(occlusionsystem__keep__window_above_has_alpha);
+    TEST(occlusionsystem__cull__window_is_off_screen);
+
+    TEST(damagesystem__damage_old_and_new_position__window_moves);
+    TEST(damagesystem__damage_region__contents_are_partially_damaged);
+    TEST(damagesystem__damage_old_position__window_stops_being_painted);
+    TEST(damagesystem__paint_everything__buffer_is_older_than_the_damage);
+    TEST(damagesystem__paint_nothing__nothing_changed);
+
+    TEST(shadercache__read_binary__driver_is_the_same);
+    TEST(shadercache__reject_binary__driver_changed);
+    TEST(shadercache__change_key__source_changes);
+
+    TEST(ringbuffer__wrap_around__oldest_frame_finished);
+    TEST(ringbuffer__refuse__frames_in_flight_fill_it);
+    TEST(ringbuffer__align_offset__previous_write_is_unaligned);
+
+    TEST(glstate__select_unit__texture_is_already_bound_there);
+
+    TEST(framegraph__cull_pass__nothing_reads_its_output);
+    TEST(framegraph__keep_pass__a_kept_pass_reads_its_output);
+    TEST(framegraph__alias_transients__lifetimes_dont_overlap);
+    TEST(framegraph__separate_transients__lifetimes_overlap);
+
+    TEST(shapesystem__merge_into_one_rect__shape_is_split_into_pixels);
+    TEST(shapesystem__keep_rows_apart__spans_differ);
+    TEST(shapesystem__draw_two_triangles_per_rect__shape_is_indexed);
+
+    TEST(windowlist__combine_all_passes__window_is_blurred_and_tinted);
+    TEST(windowlist__skip_background__window_is_not_textured);
+    TEST(windowlist__draw_nothing__window_has_no_background_opacity);
+
     TEST(bezier__not_crash__initializing_bezier_curve);
     TEST(bezier__get_identical_y_for_x__querying_on_linear_curve);
     TEST(bezier__get_0_for_0__querying_on_nonlinear_curve);
@@ -3460,14 +4931,18 @@ int main(int argc, char** argv) {
     TEST(xorg__emit_no_event__closed_window_was_not_created_as_active);
 
     TEST(xorg__emit_add_win_event__inactive_window_gets_reparented_to_root);
+    TEST(xorg__emit_add_win_with_geometry__window_gets_created_and_reparented_to_root_together);
+    TEST(xorg__emit_nothing__unknown_window_gets_reparented_to_root);
     TEST(xorg__emit_destroy_win_event__active_window_gets_reparented_to_other_window);
     TEST(xorg__not_emit_get_client__frame_window_gets_client_atom);
     TEST(xorg__emit_get_client__child_window_gets_client_atom);
+    TEST(xorg__emit_get_client__destroyed_client_id_is_reused);
     TEST(xorg__emit_get_client__client_window_becomes_child_of_frame);
 
     TEST(xorg__emit_nothing__subwindow_gets_reparented_to_other_window);
     TEST(xorg__emit_get_client__client_reparents_to_subwindow);
     TEST(xorg__emit_get_client__subsubwindow_becomes_client);
+    TEST(xorg__emit_get_client__closer_client_appears_after_distant_client);
     TEST(xorg__emit_get_client__parent_of_client_gets_reparented_to_frame);
     TEST(xorg__not_emit_get_client__window_becomes_client_under_frame_with_closer_client);
     TEST(xorg__not_emit_get_client__client_reparents_under_frame_with_closer_client);
@@ -3483,6 +4958,9 @@ int main(int argc, char** argv) {
     TEST(xorg__emit_canvas_change__root_is_resized);
     TEST(xorg__emit_mandr_and_restack__window_is_configured);
     TEST(xorg__adjust_window_for_border__window_is_configured_with_border);
+    TEST(xorg__coalesce_mandr__window_is_configured_twice);
+    TEST(xorg__coalesce_damage__mapped_window_is_damaged_twice);
+    TEST(xorg__not_coalesce_damage__window_is_remapped_between_damage);
 
     TEST(xorg__emit_map__frame_is_mapped);
     TEST(xorg__emit_unmap__frame_is_unmapped);
@@ -3508,8 +4986,13 @@ int main(int argc, char** argv) {
     TEST(xorg__emit_wintype_for_parent__name_atom_changes_on_client);
     TEST(xorg__not_emit_wintype__name_atom_changes_on_filler);
     TEST(xorg__emit_damage__mapped_window_is_damaged);
+    TEST(xorg__emit_nothing__mapped_window_is_damaged_by_move);
+    TEST(xorg__emit_damage__moved_window_is_partially_damaged);
+    TEST(xorg__emit_damage__window_is_fully_damaged_without_configure);
+    TEST(xorg__emit_damage__window_is_remapped_somewhere_else);
     TEST(xorg__emit_nothing__unmapped_window_is_damaged);
     TEST(xorg__emit_nothing__bypassed_window_is_damaged);
+    TEST(xorg__collect_damage__damage_was_requested);
 
     TEST(xorg__set_event_mask__window_is_created);
     TEST(xorg__set_event_mask__subwindow_is_created);
@@ -3524,6 +5007,8 @@ int main(int argc, char** argv) {
     TEST(blursystem__damage_blur__window_moved);
     TEST(blursystem__damage_blur__window_below_is_fading);
     TEST(blursystem__not_damage_blur__window_below_is_not_ovelapping);
+    TEST(blursystem__not_damage_blur__window_below_is_damaged_outside_window_above);
+    TEST(blursystem__damage_blur__window_below_is_damaged_under_window_above);
 
     return test_end();
 }
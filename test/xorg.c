@@ -14,6 +14,8 @@
 size_t qCursor = 0;
 Vector eventQ;
 void* windowAttrs;
+XRectangle* regionRects;
+int regionCount;
 
 Window RootWindowH(Display* dpy, int scr) {
     return 0;
@@ -69,7 +71,14 @@ Status XCompositeQueryVersionH(Display* dpy, int* major, int* minor) {
 void XFixesIntersectRegionH(Display* dpy, XserverRegion dst, XserverRegion src1, XserverRegion src2) {
 }
 XRectangle* XFixesFetchRegionH(Display* dpy, XserverRegion region, int* count_ret) {
-	return NULL;
+    *count_ret = regionCount;
+    if(regionCount == 0)
+        return NULL;
+
+    // The caller frees this with XFree
+    XRectangle* rects = malloc(sizeof(XRectangle) * regionCount);
+    memcpy(rects, regionRects, sizeof(XRectangle) * regionCount);
+    return rects;
 }
 Status XFixesQueryVersionH(Display* dpy, int* major, int* minor) {
     return 1;
@@ -86,6 +95,12 @@ Status XShapeQueryVersionH(Display* dpy, int* major, int* minor) {
 Status XRRQueryVersionH(Display* dpy, int* major, int* minor) {
     return 1;
 }
+XRRScreenResources* XRRGetScreenResourcesCurrentH(Display* dpy, Window window) {
+    return NULL;
+}
+XRRCrtcInfo* XRRGetCrtcInfoH(Display* dpy, XRRScreenResources* resources, RRCrtc crtc) {
+    return NULL;
+}
 Status glXQueryVersionH(Display* dpy, int* major, int* minor) {
     return 1;
 }
@@ -99,6 +114,28 @@ Status XSyncInitializeH(Display* dpy, int* major, int* minor) {
     return 1;
 }
 
+size_t fenceRequests = 0;
+XSyncFence XSyncCreateFenceH(Display* dpy, Drawable d, Bool initially_triggered) {
+    fenceRequests++;
+    return 1;
+}
+Bool XSyncTriggerFenceH(Display* dpy, XSyncFence fence) {
+    fenceRequests++;
+    return True;
+}
+Bool XSyncResetFenceH(Display* dpy, XSyncFence fence) {
+    fenceRequests++;
+    return True;
+}
+Bool XSyncDestroyFenceH(Display* dpy, XSyncFence fence) {
+    fenceRequests++;
+    return True;
+}
+Bool XSyncAwaitFenceH(Display* dpy, const XSyncFence* fence_list, int n_fences) {
+    fenceRequests++;
+    return True;
+}
+
 int XmbTextListToTextPropertyH(Display* display,  char** list,  int count,  XICCEncodingStyle style,  XTextProperty* text_prop_return) {
     return 0;
 }
@@ -108,6 +145,9 @@ void XSetTextPropertyH(Display* display,  Window w,  XTextProperty* text_prop,
 Window XCreateSimpleWindowH(Display* display,  Window parent,  int x,  int y,  unsigned int width,  unsigned int height,  unsigned int border_width,  unsigned long border,  unsigned long background) {
     return 0;
 }
+void XCompositeRedirectWindowH(Display* dpy,  Window window,  int update) {
+    return;
+}
 void XCompositeUnredirectWindowH(Display* dpy,  Window window,  int update) {
     return;
 }
@@ -144,6 +184,13 @@ Atom XInternAtomH(Display* dpy, const char* name, Bool query) {
     return *value;
 }
 
+Status XInternAtomsH(Display* dpy, char** names, int count, Bool query, Atom* atoms_return) {
+    for(int i = 0; i < count; i++) {
+        atoms_return[i] = XInternAtomH(dpy, names[i], query);
+    }
+    return 1;
+}
+
 Damage XDamageCreateH(Display* dpy, Window win, int level) {
     return 0;
 }
@@ -159,7 +206,8 @@ void XShapeSelectInputH(Display* dpy, Window win, unsigned long mask) {
 
 
 XserverRegion XFixesCreateRegionH(Display* dpy, XRectangle* rectangles, int nrectangles) {
-    return 0;
+    // Only has to look like a region, the contents come from setRegion
+    return 1;
 }
 
 XserverRegion XFixesCreateRegionFromWindowH(Display* dpy, Window window, int kind) {
@@ -175,6 +223,9 @@ void XFixesUnionRegionH(Display* dpy, XserverRegion dst, XserverRegion src1, Xse
 void XFixesInvertRegionH(Display* dpy, XserverRegion dst, XRectangle* rect, XserverRegion src) {
 }
 
+void XFixesSetRegionH(Display* dpy, XserverRegion region, XRectangle* rectangles, int nrectangles) {
+}
+
 void XFixesDestroyRegionH(Display* dpy, XserverRegion region) {
 }
 
@@ -250,6 +301,150 @@ int xcb_get_property_value_lengthH(const xcb_get_property_reply_t* reply) {
     return reply->value_len;
 }
 
+void* windowReqs;
+xcb_get_geometry_cookie_t xcb_get_geometryH(xcb_connection_t* conn, xcb_drawable_t drawable) {
+    Window* requestPtr;
+    JLI(requestPtr, windowReqs, nextSeq);
+    assert(requestPtr != NULL);
+    *requestPtr = drawable;
+
+    return (xcb_get_geometry_cookie_t) {
+        .sequence = nextSeq++
+    };
+}
+
+xcb_get_geometry_reply_t* xcb_get_geometry_replyH(xcb_connection_t* conn, xcb_get_geometry_cookie_t cookie, xcb_generic_error_t **e) {
+    Window* window;
+    JLG(window, windowReqs, cookie.sequence);
+    assert(window != NULL);
+
+    XWindowAttributes** attrs;
+    JLG(attrs, windowAttrs, *window);
+    if(attrs == NULL) {
+        *e = calloc(1, sizeof(xcb_generic_error_t));
+        (*e)->error_code = BadDrawable;
+        return NULL;
+    }
+    *e = NULL;
+
+    xcb_get_geometry_reply_t* reply = calloc(1, sizeof(xcb_get_geometry_reply_t));
+    reply->x = (*attrs)->x;
+    reply->y = (*attrs)->y;
+    reply->width = (*attrs)->width;
+    reply->height = (*attrs)->height;
+    reply->border_width = (*attrs)->border_width;
+    return reply;
+}
+
+xcb_get_window_attributes_cookie_t xcb_get_window_attributesH(xcb_connection_t* conn, xcb_window_t window) {
+    Window* requestPtr;
+    JLI(requestPtr, windowReqs, nextSeq);
+    assert(requestPtr != NULL);
+    *requestPtr = window;
+
+    return (xcb_get_window_attributes_cookie_t) {
+        .sequence = nextSeq++
+    };
+}
+
+xcb_get_window_attributes_reply_t* xcb_get_window_attributes_replyH(xcb_connection_t* conn, xcb_get_window_attributes_cookie_t cookie, xcb_generic_error_t **e) {
+    Window* window;
+    JLG(window, windowReqs, cookie.sequence);
+    assert(window != NULL);
+
+    XWindowAttributes** attrs;
+    JLG(attrs, windowAttrs, *window);
+    if(attrs == NULL) {
+        *e = calloc(1, sizeof(xcb_generic_error_t));
+        (*e)->error_code = BadWindow;
+        return NULL;
+    }
+    *e = NULL;
+
+    xcb_get_window_attributes_reply_t* reply = calloc(1, sizeof(xcb_get_window_attributes_reply_t));
+    reply->_class = (*attrs)->class;
+    reply->map_state = (*attrs)->map_state;
+    return reply;
+}
+
+void* windowChildren;
+xcb_query_tree_cookie_t xcb_query_treeH(xcb_connection_t* conn, xcb_window_t window) {
+    Window* requestPtr;
+    JLI(requestPtr, windowReqs, nextSeq);
+    assert(requestPtr != NULL);
+    *requestPtr = window;
+
+    return (xcb_query_tree_cookie_t) {
+        .sequence = nextSeq++
+    };
+}
+
+xcb_query_tree_reply_t* xcb_query_tree_replyH(xcb_connection_t* conn, xcb_query_tree_cookie_t cookie, xcb_generic_error_t **e) {
+    Window* window;
+    JLG(window, windowReqs, cookie.sequence);
+    assert(window != NULL);
+    *e = NULL;
+
+    Vector** children;
+    JLG(children, windowChildren, *window);
+    size_t numChildren = children != NULL ? vector_size(*children) : 0;
+
+    // Like the real thing, the children follow right after the reply
+    xcb_query_tree_reply_t* reply = calloc(1, sizeof(xcb_query_tree_reply_t) + numChildren * sizeof(xcb_window_t));
+    reply->children_len = numChildren;
+    for(size_t i = 0; i < numChildren; i++) {
+        ((xcb_window_t*)(reply + 1))[i] = *(Window*)vector_get(*children, i);
+    }
+    return reply;
+}
+
+xcb_window_t* xcb_query_tree_childrenH(const xcb_query_tree_reply_t* reply) {
+    return (xcb_window_t*)(reply + 1);
+}
+
+int xcb_query_tree_children_lengthH(const xcb_query_tree_reply_t* reply) {
+    return reply->children_len;
+}
+
+xcb_xfixes_fetch_region_cookie_t xcb_xfixes_fetch_regionH(xcb_connection_t* conn, xcb_xfixes_region_t region) {
+    return (xcb_xfixes_fetch_region_cookie_t) {
+        .sequence = nextSeq++
+    };
+}
+
+// The rectangles follow the reply, like they do on the wire. The length is in
+// 4 byte units.
+xcb_xfixes_fetch_region_reply_t* xcb_xfixes_fetch_region_replyH(xcb_connection_t* conn, xcb_xfixes_fetch_region_cookie_t cookie, xcb_generic_error_t** e) {
+    *e = NULL;
+
+    xcb_xfixes_fetch_region_reply_t* reply = calloc(1, sizeof(xcb_xfixes_fetch_region_reply_t) + regionCount * sizeof(xcb_rectangle_t));
+    reply->length = regionCount * 2;
+    xcb_rectangle_t* rects = (xcb_rectangle_t*)(reply + 1);
+    for(int i = 0; i < regionCount; i++) {
+        rects[i] = (xcb_rectangle_t){regionRects[i].x, regionRects[i].y, regionRects[i].width, regionRects[i].height};
+    }
+    return reply;
+}
+
+xcb_rectangle_t* xcb_xfixes_fetch_region_rectanglesH(const xcb_xfixes_fetch_region_reply_t* reply) {
+    return (xcb_rectangle_t*)(reply + 1);
+}
+
+int xcb_xfixes_fetch_region_rectangles_lengthH(const xcb_xfixes_fetch_region_reply_t* reply) {
+    return reply->length / 2;
+}
+
+void addChild(Window parent, Window child) {
+    Vector** children;
+    JLI(children, windowChildren, parent);
+    assert(children != NULL);
+    if(*children == NULL) {
+        *children = malloc(sizeof(Vector));
+        vector_init(*children, sizeof(Window), 4);
+    }
+    vector_putBack(*children, &child);
+}
+
 void setProperty(Window win, Atom atom, uint32_t value) {
     uint32_t value_len = 4;
     uint32_t total_len = sizeof(struct windowProperty) + value_len;
@@ -297,6 +492,11 @@ long inputMask(Window win) {
     return *value;
 }
 
+void setRegion(XRectangle* rects, int count) {
+    regionRects = rects;
+    regionCount = count;
+}
+
 void setWindowAttr(Window window, XWindowAttributes* attrs) {
     XWindowAttributes** value;
     JLI(value, windowAttrs, window);
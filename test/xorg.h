@@ -10,3 +10,6 @@ extern Vector eventQ;
 void setProperty(Window win, Atom atom, uint32_t value);
 long inputMask(Window win);
 void setWindowAttr(Window window, XWindowAttributes* attrs);
+// Every region fetched from now on has these rectangles
+void setRegion(XRectangle* rects, int count);
+void addChild(Window parent, Window child);